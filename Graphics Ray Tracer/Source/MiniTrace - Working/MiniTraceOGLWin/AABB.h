@@ -0,0 +1,120 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include "Vector3.h"
+
+#define AABB_EMPTY_EXTENT	1.0e30		//the bounds of an empty box, inside out so any Expand fixes them
+
+//An axis aligned bounding box
+struct AABB
+{
+	Vector3 min;
+	Vector3 max;
+
+	AABB()
+	{
+		SetEmpty();
+	}
+
+	AABB(const Vector3& lo, const Vector3& hi)
+	{
+		min = lo;
+		max = hi;
+	}
+
+	inline void SetEmpty()
+	{
+		min.SetVector(AABB_EMPTY_EXTENT, AABB_EMPTY_EXTENT, AABB_EMPTY_EXTENT);
+		max.SetVector(-AABB_EMPTY_EXTENT, -AABB_EMPTY_EXTENT, -AABB_EMPTY_EXTENT);
+	}
+
+	inline bool IsEmpty() const
+	{
+		return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+	}
+
+	inline void Expand(const Vector3& p)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (p[i] < min[i]) min[i] = p[i];
+			if (p[i] > max[i]) max[i] = p[i];
+		}
+	}
+
+	inline void Expand(const AABB& box)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			if (box.min[i] < min[i]) min[i] = box.min[i];
+			if (box.max[i] > max[i]) max[i] = box.max[i];
+		}
+	}
+
+	inline bool Contains(const Vector3& p) const
+	{
+		return p[0] >= min[0] && p[0] <= max[0]
+			&& p[1] >= min[1] && p[1] <= max[1]
+			&& p[2] >= min[2] && p[2] <= max[2];
+	}
+
+	inline Vector3 GetCentre() const
+	{
+		return (min + max) * 0.5;
+	}
+
+	inline double GetSurfaceArea() const
+	{
+		if (IsEmpty())
+			return 0.0;
+
+		Vector3 size = max - min;
+		return 2.0 * (size[0] * size[1] + size[1] * size[2] + size[2] * size[0]);
+	}
+
+	inline int GetLongestAxis() const
+	{
+		Vector3 size = max - min;
+
+		if (size[0] > size[1] && size[0] > size[2])
+			return 0;
+		return size[1] > size[2] ? 1 : 2;
+	}
+
+	//Slab test against a ray given by its start and the reciprocal of its direction.
+	//On a hit tNear is where the ray enters the box, clamped to 0 if it starts inside.
+	inline bool IntersectByRay(const Vector3& start, const Vector3& invDir, double maxT, double& tNear) const
+	{
+		double t0 = 0.0;
+		double t1 = maxT;
+
+		for (int i = 0; i < 3; i++)
+		{
+			double tA = (min[i] - start[i]) * invDir[i];
+			double tB = (max[i] - start[i]) * invDir[i];
+
+			if (tA > tB)
+			{
+				double swap = tA; tA = tB; tB = swap;
+			}
+
+			//written so a NaN from 0 * infinity leaves the interval alone
+			t0 = tA > t0 ? tA : t0;
+			t1 = tB < t1 ? tB : t1;
+
+			if (t0 > t1)
+				return false;
+		}
+
+		tNear = t0;
+		return true;
+	}
+};
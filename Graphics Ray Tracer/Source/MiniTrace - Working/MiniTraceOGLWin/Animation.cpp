@@ -0,0 +1,279 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Animation.h"
+#include "Light.h"
+
+Animation::Animation()
+{
+	m_frameCount = 1;
+}
+
+void Animation::Clear()
+{
+	m_frameCount = 1;
+	m_cameraKeys.clear();
+	m_lightTracks.clear();
+	m_objectTracks.clear();
+	m_error.clear();
+}
+
+void Animation::AddKey(std::vector<Key>& keys, double frame, const Vector3& value0, const Vector3& value1)
+{
+	Key key;
+	key.frame = frame;
+	key.values[0] = value0;
+	key.values[1] = value1;
+
+	//kept in frame order, a key on the frame of another replaces it
+	std::vector<Key>::iterator key_iter = keys.begin();
+	while (key_iter != keys.end() && key_iter->frame < frame)
+	{
+		key_iter++;
+	}
+
+	if (key_iter != keys.end() && key_iter->frame == frame)
+		*key_iter = key;
+	else
+		keys.insert(key_iter, key);
+}
+
+Animation::Track& Animation::FindTrack(std::vector<Track>& tracks, int target)
+{
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		if (tracks[i].target == target)
+			return tracks[i];
+	}
+
+	Track track;
+	track.target = target;
+	tracks.push_back(track);
+	return tracks.back();
+}
+
+void Animation::Sample(const std::vector<Key>& keys, double frame, Vector3 values[2])
+{
+	size_t next = 0;
+	while (next < keys.size() && keys[next].frame <= frame)
+	{
+		next++;
+	}
+
+	if (next == 0 || next == keys.size())
+	{
+		const Key& key = keys[next == 0 ? 0 : next - 1];
+		values[0] = key.values[0];
+		values[1] = key.values[1];
+		return;
+	}
+
+	const Key& a = keys[next - 1];
+	const Key& b = keys[next];
+	double s = (frame - a.frame) / (b.frame - a.frame);
+
+	for (int i = 0; i < 2; i++)
+	{
+		values[i] = a.values[i] + (b.values[i] - a.values[i]) * s;
+	}
+}
+
+void Animation::AddCameraKey(double frame, const Vector3& position, const Vector3& lookAt)
+{
+	AddKey(m_cameraKeys, frame, position, lookAt);
+}
+
+void Animation::AddLightKey(int light, double frame, const Vector3& position)
+{
+	AddKey(FindTrack(m_lightTracks, light).keys, frame, position, Vector3());
+}
+
+void Animation::AddObjectKey(int object, double frame, const Vector3& offset)
+{
+	AddKey(FindTrack(m_objectTracks, object).keys, frame, offset, Vector3());
+}
+
+bool Animation::Apply(Scene& scene, int frame)
+{
+	Vector3 values[2];
+
+	if (!m_cameraKeys.empty())
+	{
+		Sample(m_cameraKeys, frame, values);
+		scene.GetSceneCamera()->SetPositionAndLookAt(values[0], values[1]);
+	}
+
+	std::vector<Light*>* lights = scene.GetLightList();
+
+	for (size_t i = 0; i < m_lightTracks.size(); i++)
+	{
+		const Track& track = m_lightTracks[i];
+
+		if (track.target < 0 || track.target >= (int)lights->size())
+		{
+			m_error = "the scene has no light " + std::to_string(track.target);
+			return false;
+		}
+
+		Sample(track.keys, frame, values);
+		(*lights)[track.target]->SetLightPosition(values[0][0], values[0][1], values[0][2]);
+	}
+
+	if (!m_lightTracks.empty())
+		scene.CommitLights();
+
+	bool moved = false;
+
+	for (size_t i = 0; i < m_objectTracks.size(); i++)
+	{
+		Track& track = m_objectTracks[i];
+
+		if (track.target < 0 || track.target >= (int)scene.GetObjectCount())
+		{
+			m_error = "the scene has no object " + std::to_string(track.target);
+			return false;
+		}
+
+		Sample(track.keys, frame, values);
+
+		Vector3 delta = values[0] - track.applied;
+		if (delta[0] == 0.0 && delta[1] == 0.0 && delta[2] == 0.0)
+			continue;
+
+		if (!scene.GetObject(track.target)->Translate(delta))
+		{
+			m_error = "object " + std::to_string(track.target) + " cannot be moved";
+			return false;
+		}
+
+		track.applied = values[0];
+		moved = true;
+	}
+
+	if (moved)
+		scene.Refit();
+	return true;
+}
+
+void Animation::Reset(Scene& scene)
+{
+	bool moved = false;
+
+	for (size_t i = 0; i < m_objectTracks.size(); i++)
+	{
+		Track& track = m_objectTracks[i];
+
+		if (track.target < 0 || track.target >= (int)scene.GetObjectCount())
+			continue;
+
+		if (scene.GetObject(track.target)->Translate(track.applied * -1.0))
+			moved = true;
+		track.applied = Vector3();
+	}
+
+	if (moved)
+		scene.Refit();
+}
+
+//Reads count numbers from the tokens starting at first, false if one is not a number
+static bool ReadNumbers(const std::vector<char*>& tokens, size_t first, int count, double* numbers)
+{
+	if (first + count > tokens.size())
+		return false;
+
+	for (int i = 0; i < count; i++)
+	{
+		char* end;
+		numbers[i] = strtod(tokens[first + i], &end);
+
+		if (end == tokens[first + i] || *end != '\0')
+			return false;
+	}
+	return true;
+}
+
+bool Animation::Load(const char* filename)
+{
+	FILE* file = fopen(filename, "r");
+	if (!file)
+	{
+		m_error = std::string("Cannot open ") + filename;
+		return false;
+	}
+
+	Clear();
+
+	std::vector<char*> tokens;
+	char line[1024];
+	int lineNumber = 0;
+
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+
+		tokens.clear();
+		for (char* token = strtok(line, " \t\r\n"); token; token = strtok(nullptr, " \t\r\n"))
+		{
+			tokens.push_back(token);
+		}
+
+		if (tokens.empty())
+			continue;
+
+		std::string keyword = tokens[0];
+		std::string error;
+		double numbers[7];
+
+		if (keyword == "frames")
+		{
+			if (tokens.size() != 2 || !ReadNumbers(tokens, 1, 1, numbers) || numbers[0] < 1.0)
+				error = "expected a frame count";
+			else
+				SetFrameCount((int)numbers[0]);
+		}
+		else if (keyword == "camera")
+		{
+			if (tokens.size() != 8 || !ReadNumbers(tokens, 1, 7, numbers))
+				error = "expected a frame, position and look at point";
+			else
+				AddCameraKey(numbers[0], Vector3(numbers[1], numbers[2], numbers[3]), Vector3(numbers[4], numbers[5], numbers[6]));
+		}
+		else if (keyword == "light" || keyword == "move")
+		{
+			if (tokens.size() != 6 || !ReadNumbers(tokens, 1, 5, numbers) || numbers[0] < 0.0)
+				error = "expected an index, a frame and x y z";
+			else if (keyword == "light")
+				AddLightKey((int)numbers[0], numbers[1], Vector3(numbers[2], numbers[3], numbers[4]));
+			else
+				AddObjectKey((int)numbers[0], numbers[1], Vector3(numbers[2], numbers[3], numbers[4]));
+		}
+		else
+		{
+			error = "unknown keyword " + keyword;
+		}
+
+		if (!error.empty())
+		{
+			fclose(file);
+			m_error = std::string(filename) + ":" + std::to_string(lineNumber) + ": " + error;
+			return false;
+		}
+	}
+
+	fclose(file);
+	return true;
+}
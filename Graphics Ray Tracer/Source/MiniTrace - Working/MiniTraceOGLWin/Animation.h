@@ -0,0 +1,96 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Scene.h"
+#include "Vector3.h"
+
+//Keyframed changes to a scene over a sequence of frames: the camera, the positions of lights
+//and objects moved by an offset. Between keys the values are interpolated linearly, before the
+//first key and after the last they hold. Keys may fall on any frame, fractions included.
+//
+//Apply poses the scene for a frame and refits its BVH (Scene::Refit) rather than building it
+//again, so one Scene renders the whole sequence. The objects are moved by the change in their
+//offset since the last Apply, so an Animation should drive a single scene.
+//
+//Load reads an animation from a text file, one item per line:
+//
+//	frames N								number of frames
+//	camera FRAME px py pz lx ly lz			camera position and look at point
+//	light INDEX FRAME x y z					position of the scene's light INDEX, from 0
+//	move INDEX FRAME dx dy dz				offset of the scene's object INDEX from where it was added
+//
+//Anything after a # is a comment.
+class Animation
+{
+	private:
+		struct Key
+		{
+			double		frame;
+			Vector3		values[2];
+		};
+
+		//the keys of one light or object, in frame order
+		struct Track
+		{
+			int					target;
+			std::vector<Key>	keys;
+			Vector3				applied;		//object tracks: the offset the object has been moved by
+		};
+
+		int					m_frameCount;
+		std::vector<Key>	m_cameraKeys;		//position then look at point
+		std::vector<Track>	m_lightTracks;
+		std::vector<Track>	m_objectTracks;
+		std::string			m_error;
+
+		static void		AddKey(std::vector<Key>& keys, double frame, const Vector3& value0, const Vector3& value1);
+		static Track&	FindTrack(std::vector<Track>& tracks, int target);
+		//the interpolated values of the keys at frame
+		static void		Sample(const std::vector<Key>& keys, double frame, Vector3 values[2]);
+
+	public:
+		Animation();
+
+		//Replaces the animation with the file's. Returns false if the file
+		//could not be read or has an error, GetError says what went wrong.
+		bool	Load(const char* filename);
+
+		void	Clear();
+
+		inline void SetFrameCount(int count)
+		{
+			m_frameCount = count > 0 ? count : 1;
+		}
+
+		inline int GetFrameCount() const
+		{
+			return m_frameCount;
+		}
+
+		void	AddCameraKey(double frame, const Vector3& position, const Vector3& lookAt);
+		void	AddLightKey(int light, double frame, const Vector3& position);
+		void	AddObjectKey(int object, double frame, const Vector3& offset);
+
+		//Poses the scene for the frame, refits it and rebuilds its light tree if lights move. Returns false, with GetError saying why,
+		//if a key is for a light or object the scene does not have or an object cannot move.
+		bool	Apply(Scene& scene, int frame);
+
+		//Moves the animated objects back to where they were added, and refits the scene
+		void	Reset(Scene& scene);
+
+		inline const std::string& GetError() const
+		{
+			return m_error;
+		}
+};
@@ -0,0 +1,97 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <algorithm>
+
+#include "Arena.h"
+
+Arena::Arena()
+{
+	m_next = m_end = nullptr;
+	m_usedBytes = 0;
+	m_objectCount = 0;
+}
+
+Arena::~Arena()
+{
+	Release();
+}
+
+void* Arena::Allocate(size_t size, size_t align)
+{
+	char* aligned = (char*)(((size_t)m_next + align - 1) & ~(align - 1));
+
+	if (!m_next || aligned + size > m_end)
+	{
+		size_t blockSize = m_blocks.empty() ? ARENA_FIRST_BLOCK_SIZE : std::min(m_blocks.back().size * 2, (size_t)ARENA_MAX_BLOCK_SIZE);
+		blockSize = std::max(blockSize, size + align);
+
+		Block block;
+		block.memory = (char*)malloc(blockSize);
+		block.size = blockSize;
+
+		if (!block.memory)
+			throw std::bad_alloc();
+
+		m_blocks.push_back(block);
+		m_next = block.memory;
+		m_end = block.memory + blockSize;
+		aligned = (char*)(((size_t)m_next + align - 1) & ~(align - 1));
+	}
+
+	m_next = aligned + size;
+	m_usedBytes += size;
+	return aligned;
+}
+
+bool Arena::Owns(const void* p) const
+{
+	const char* c = (const char*)p;
+
+	//the newest block first, objects are usually asked about just after they are made
+	for (size_t i = m_blocks.size(); i > 0; i--)
+	{
+		const Block& block = m_blocks[i - 1];
+
+		if (c >= block.memory && c < block.memory + block.size)
+			return true;
+	}
+	return false;
+}
+
+void Arena::Release()
+{
+	for (size_t i = m_finalizers.size(); i > 0; i--)
+	{
+		m_finalizers[i - 1].destroy(m_finalizers[i - 1].object);
+	}
+
+	for (size_t i = 0; i < m_blocks.size(); i++)
+	{
+		free(m_blocks[i].memory);
+	}
+
+	m_finalizers.clear();
+	m_blocks.clear();
+	m_next = m_end = nullptr;
+	m_usedBytes = 0;
+	m_objectCount = 0;
+}
+
+size_t Arena::GetReservedBytes() const
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < m_blocks.size(); i++)
+	{
+		total += m_blocks[i].size;
+	}
+	return total;
+}
@@ -0,0 +1,107 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define ARENA_FIRST_BLOCK_SIZE	65536		//bytes of the first block, each later one doubles up to ARENA_MAX_BLOCK_SIZE
+#define ARENA_MAX_BLOCK_SIZE	4194304
+
+//Hands out memory from a few large blocks, in the order it is asked for, so objects made one
+//after the other sit next to each other. Nothing is freed on its own: Release destroys all the
+//objects made with New, the newest first, and frees the blocks together. Objects whose type
+//needs no destructor are not even visited.
+//
+//Not thread safe; objects are made while a scene is set up, not while it is traced.
+class Arena
+{
+	private:
+		struct Block
+		{
+			char*		memory;
+			size_t		size;
+		};
+
+		//an object whose destructor has to run on Release
+		struct Finalizer
+		{
+			void*		object;
+			void		(*destroy)(void* object);
+		};
+
+		std::vector<Block>		m_blocks;
+		std::vector<Finalizer>	m_finalizers;
+		char*					m_next;				//free space of the newest block
+		char*					m_end;
+		size_t					m_usedBytes;		//asked for, not counting alignment padding
+		size_t					m_objectCount;
+
+		template <class T>
+		static void Destroy(void* object)
+		{
+			static_cast<T*>(object)->~T();
+		}
+
+		//not copyable, the objects belong to the one arena
+		Arena(const Arena&);
+		Arena& operator=(const Arena&);
+
+	public:
+		Arena();
+		~Arena();
+
+		//size bytes aligned to align, a power of two
+		void*	Allocate(size_t size, size_t align);
+
+		//Constructs a T from args in the arena
+		template <class T, class... Args>
+		T* New(Args&&... args)
+		{
+			void* memory = Allocate(sizeof(T), std::alignment_of<T>::value);
+			T* object = new (memory) T(std::forward<Args>(args)...);
+
+			if (!std::is_trivially_destructible<T>::value)
+			{
+				Finalizer finalizer = { object, &Destroy<T> };
+				m_finalizers.push_back(finalizer);
+			}
+
+			m_objectCount++;
+			return object;
+		}
+
+		//True if p points into one of the blocks
+		bool	Owns(const void* p) const;
+
+		//Destroys every object and frees every block
+		void	Release();
+
+		inline size_t GetObjectCount() const
+		{
+			return m_objectCount;
+		}
+
+		inline size_t GetUsedBytes() const
+		{
+			return m_usedBytes;
+		}
+
+		//Bytes of all the blocks, used or not
+		size_t	GetReservedBytes() const;
+
+		inline size_t GetBlockCount() const
+		{
+			return m_blocks.size();
+		}
+};
@@ -0,0 +1,359 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <algorithm>
+#include <chrono>
+
+#include "BVH.h"
+
+#define BVH_SAH_BINS			16
+#define BVH_TRAVERSAL_COST		1.0		//cost of visiting a node relative to testing one item
+
+BVH::BVH()
+{
+	m_method = BUILD_SAH;
+	m_maxLeafSize = 4;
+	Clear();
+}
+
+BVH::~BVH()
+{
+}
+
+void BVH::Clear()
+{
+	m_nodes.clear();
+	m_items.clear();
+
+	m_stats.numItems = 0;
+	m_stats.numNodes = 0;
+	m_stats.numLeaves = 0;
+	m_stats.maxDepth = 0;
+	m_stats.maxLeafSize = 0;
+	m_stats.avgLeafSize = 0.0;
+	m_stats.sahCost = 0.0;
+	m_stats.buildTimeMs = 0.0;
+}
+
+void BVH::Build(const std::vector<AABB>& bounds, BuildMethod method, int maxLeafSize)
+{
+	std::chrono::high_resolution_clock::time_point buildStart = std::chrono::high_resolution_clock::now();
+
+	Clear();
+
+	m_method = method;
+	m_maxLeafSize = maxLeafSize > 0 ? maxLeafSize : 1;
+
+	int numItems = (int)bounds.size();
+	if (numItems == 0)
+		return;
+
+	std::vector<Vector3> centroids(numItems);
+	m_items.resize(numItems);
+
+	for (int i = 0; i < numItems; i++)
+	{
+		m_items[i] = i;
+		centroids[i] = bounds[i].GetCentre();
+	}
+
+	//a binary tree with leaves of at least one item never has more than 2n - 1 nodes
+	m_nodes.reserve(2 * numItems - 1);
+	m_nodes.push_back(Node());
+
+	BuildNode(0, 0, numItems, bounds, centroids, 1);
+
+	m_stats.numItems = numItems;
+	m_stats.numNodes = (int)m_nodes.size();
+	GatherStats(0, m_nodes[0].bounds.GetSurfaceArea(), 1);
+	m_stats.avgLeafSize = m_stats.numLeaves > 0 ? (double)numItems / m_stats.numLeaves : 0.0;
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - buildStart;
+	m_stats.buildTimeMs = buildTime.count();
+}
+
+bool BVH::Assign(std::vector<Node>& nodes, std::vector<int>& items, int numItems, BuildMethod method)
+{
+	std::chrono::high_resolution_clock::time_point buildStart = std::chrono::high_resolution_clock::now();
+
+	Clear();
+
+	int numNodes = (int)nodes.size();
+	bool valid = (int)items.size() == numItems && (numItems == 0) == (numNodes == 0);
+
+	//Build puts children after their parent, checking that keeps traversal from looping;
+	//the sums are checked as differences so that damaged indices cannot overflow them
+	for (int i = 0; i < numNodes && valid; i++)
+	{
+		const Node& node = nodes[i];
+
+		if (node.count > 0)
+			valid = node.first >= 0 && node.count <= numItems - node.first;
+		else
+			valid = node.count == 0 && node.first > i && node.first < numNodes - 1;
+	}
+
+	for (int i = 0; i < numItems && valid; i++)
+	{
+		valid = items[i] >= 0 && items[i] < numItems;
+	}
+
+	//the traversal stacks are fixed size, so the tree may be no deeper than Build makes it,
+	//and a node reached twice would be a child shared by two parents
+	std::vector<int> depths(valid ? numNodes : 0, 0);
+	std::vector<int> pending;
+
+	if (valid && numNodes > 0)
+	{
+		depths[0] = 1;
+		pending.push_back(0);
+	}
+
+	while (!pending.empty() && valid)
+	{
+		const Node& node = nodes[pending.back()];
+		int depth = depths[pending.back()];
+
+		pending.pop_back();
+
+		if (node.count > 0)
+			continue;
+
+		for (int child = node.first; child <= node.first + 1 && valid; child++)
+		{
+			valid = depths[child] == 0 && depth < BVH_STACK_SIZE - 2;
+			depths[child] = depth + 1;
+			pending.push_back(child);
+		}
+	}
+
+	if (!valid)
+	{
+		nodes.clear();
+		items.clear();
+		return false;
+	}
+
+	m_nodes.swap(nodes);
+	m_items.swap(items);
+	nodes.clear();
+	items.clear();
+	m_method = method;
+
+	if (m_nodes.empty())
+		return true;
+
+	m_stats.numItems = numItems;
+	m_stats.numNodes = numNodes;
+	GatherStats(0, m_nodes[0].bounds.GetSurfaceArea(), 1);
+	m_stats.avgLeafSize = m_stats.numLeaves > 0 ? (double)numItems / m_stats.numLeaves : 0.0;
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - buildStart;
+	m_stats.buildTimeMs = buildTime.count();
+	return true;
+}
+
+void BVH::BuildNode(int nodeIndex, int first, int count, const std::vector<AABB>& bounds,
+	std::vector<Vector3>& centroids, int depth)
+{
+	AABB nodeBounds;
+	AABB centroidBounds;
+
+	for (int i = first; i < first + count; i++)
+	{
+		nodeBounds.Expand(bounds[m_items[i]]);
+		centroidBounds.Expand(centroids[m_items[i]]);
+	}
+
+	m_nodes[nodeIndex].bounds = nodeBounds;
+	m_nodes[nodeIndex].first = first;
+	m_nodes[nodeIndex].count = count;
+
+	if (depth > m_stats.maxDepth)
+		m_stats.maxDepth = depth;
+
+	//the traversal stacks are fixed size, so very deep trees just get bigger leaves
+	if (count <= m_maxLeafSize || depth >= BVH_STACK_SIZE - 2)
+		return;
+
+	int axis = centroidBounds.GetLongestAxis();
+	int mid = first + count / 2;
+
+	if (centroidBounds.max[axis] - centroidBounds.min[axis] <= 0.0)
+	{
+		//all centroids coincide, nothing to split on
+		return;
+	}
+
+	if (m_method == BUILD_SAH)
+	{
+		double splitPos;
+
+		if (!FindSAHSplit(first, count, centroidBounds, bounds, centroids, axis, splitPos, nodeBounds.GetSurfaceArea()))
+		{
+			//a leaf is cheaper than any split
+			return;
+		}
+
+		int* split = std::partition(&m_items[first], &m_items[first] + count,
+			[&](int item) { return centroids[item][axis] < splitPos; });
+		mid = (int)(split - &m_items[0]);
+
+		if (mid == first || mid == first + count)
+			mid = first + count / 2;
+	}
+	else
+	{
+		std::nth_element(&m_items[first], &m_items[mid], &m_items[first] + count,
+			[&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+	}
+
+	int left = (int)m_nodes.size();
+	m_nodes.push_back(Node());
+	m_nodes.push_back(Node());
+
+	m_nodes[nodeIndex].first = left;
+	m_nodes[nodeIndex].count = 0;
+
+	BuildNode(left, first, mid - first, bounds, centroids, depth + 1);
+	BuildNode(left + 1, mid, first + count - mid, bounds, centroids, depth + 1);
+}
+
+bool BVH::FindSAHSplit(int first, int count, const AABB& centroidBounds, const std::vector<AABB>& bounds,
+	const std::vector<Vector3>& centroids, int& axis, double& splitPos, double parentArea)
+{
+	double bestCost = (double)count;		//cost of leaving this node as a leaf
+	bool found = false;
+
+	if (parentArea <= 0.0)
+		return false;
+
+	for (int a = 0; a < 3; a++)
+	{
+		double lo = centroidBounds.min[a];
+		double extent = centroidBounds.max[a] - lo;
+
+		if (extent <= 0.0)
+			continue;
+
+		AABB binBounds[BVH_SAH_BINS];
+		int binCount[BVH_SAH_BINS] = { 0 };
+		double scale = BVH_SAH_BINS / extent;
+
+		for (int i = first; i < first + count; i++)
+		{
+			int item = m_items[i];
+			int bin = (int)((centroids[item][a] - lo) * scale);
+			bin = std::min(std::max(bin, 0), BVH_SAH_BINS - 1);
+			binCount[bin]++;
+			binBounds[bin].Expand(bounds[item]);
+		}
+
+		//sweep from the right to get the cost of every right hand side
+		double rightArea[BVH_SAH_BINS];
+		int rightCount[BVH_SAH_BINS];
+		AABB accum;
+		int accumCount = 0;
+
+		for (int b = BVH_SAH_BINS - 1; b > 0; b--)
+		{
+			accum.Expand(binBounds[b]);
+			accumCount += binCount[b];
+			rightArea[b] = accum.GetSurfaceArea();
+			rightCount[b] = accumCount;
+		}
+
+		accum.SetEmpty();
+		accumCount = 0;
+
+		for (int b = 1; b < BVH_SAH_BINS; b++)
+		{
+			accum.Expand(binBounds[b - 1]);
+			accumCount += binCount[b - 1];
+
+			if (accumCount == 0 || rightCount[b] == 0)
+				continue;
+
+			double cost = BVH_TRAVERSAL_COST
+				+ (accum.GetSurfaceArea() * accumCount + rightArea[b] * rightCount[b]) / parentArea;
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				axis = a;
+				splitPos = lo + b / scale;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+bool BVH::Refit(const std::vector<AABB>& bounds)
+{
+	std::chrono::high_resolution_clock::time_point refitStart = std::chrono::high_resolution_clock::now();
+
+	if (bounds.size() != m_items.size())
+		return false;
+
+	//children come after their parent, so going backwards every node's children are done first
+	for (int i = (int)m_nodes.size() - 1; i >= 0; i--)
+	{
+		Node& node = m_nodes[i];
+		node.bounds.SetEmpty();
+
+		if (node.count > 0)
+		{
+			for (int j = node.first; j < node.first + node.count; j++)
+			{
+				node.bounds.Expand(bounds[m_items[j]]);
+			}
+		}
+		else
+		{
+			node.bounds.Expand(m_nodes[node.first].bounds);
+			node.bounds.Expand(m_nodes[node.first + 1].bounds);
+		}
+	}
+
+	if (!m_nodes.empty())
+	{
+		m_stats.numLeaves = 0;
+		m_stats.maxDepth = 0;
+		m_stats.maxLeafSize = 0;
+		m_stats.sahCost = 0.0;
+		GatherStats(0, m_nodes[0].bounds.GetSurfaceArea(), 1);
+	}
+
+	std::chrono::duration<double, std::milli> refitTime = std::chrono::high_resolution_clock::now() - refitStart;
+	m_stats.buildTimeMs = refitTime.count();
+	return true;
+}
+
+void BVH::GatherStats(int nodeIndex, double rootArea, int depth)
+{
+	const Node& node = m_nodes[nodeIndex];
+	double areaRatio = rootArea > 0.0 ? node.bounds.GetSurfaceArea() / rootArea : 1.0;
+
+	m_stats.maxDepth = std::max(m_stats.maxDepth, depth);
+
+	if (node.count > 0)
+	{
+		m_stats.numLeaves++;
+		m_stats.maxLeafSize = std::max(m_stats.maxLeafSize, node.count);
+		m_stats.sahCost += areaRatio * node.count;
+	}
+	else
+	{
+		m_stats.sahCost += areaRatio * BVH_TRAVERSAL_COST;
+		GatherStats(node.first, rootArea, depth + 1);
+		GatherStats(node.first + 1, rootArea, depth + 1);
+	}
+}
@@ -0,0 +1,447 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <vector>
+
+#include "AABB.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+#define BVH_STACK_SIZE		64
+
+//A bounding volume hierarchy over a list of items, each known only by its bounding box.
+//The tree stores item indices; what an item is and how a ray hits it is up to the caller,
+//which passes an intersector to the traversal functions.
+class BVH
+{
+	public:
+		enum BuildMethod
+		{
+			BUILD_SAH = 0,		//binned surface area heuristic, best trees
+			BUILD_MEDIAN		//split at the median centroid of the longest axis, fastest build
+		};
+
+		struct Node
+		{
+			AABB		bounds;
+			int			first;		//leaf: first entry in the item list, inner node: index of the left child (right is first + 1)
+			int			count;		//number of items in a leaf, 0 for an inner node
+		};
+
+		struct BuildStats
+		{
+			int			numItems;
+			int			numNodes;
+			int			numLeaves;
+			int			maxDepth;
+			int			maxLeafSize;
+			double		avgLeafSize;
+			double		sahCost;		//expected cost of a random ray, in node visits plus item tests
+			double		buildTimeMs;
+		};
+
+	private:
+		std::vector<Node>		m_nodes;
+		std::vector<int>		m_items;		//item indices, grouped so each leaf owns a contiguous range
+		BuildMethod				m_method;
+		int						m_maxLeafSize;
+		BuildStats				m_stats;
+
+		void	BuildNode(int nodeIndex, int first, int count, const std::vector<AABB>& bounds,
+					std::vector<Vector3>& centroids, int depth);
+		bool	FindSAHSplit(int first, int count, const AABB& centroidBounds, const std::vector<AABB>& bounds,
+					const std::vector<Vector3>& centroids, int& axis, double& splitPos, double parentArea);
+		void	GatherStats(int nodeIndex, double rootArea, int depth);
+
+		//ClosestHit below a node whose box the ray is known to hit
+		template <class Intersector>
+		bool ClosestHitBelow(int nodeIndex, const Vector3& start, const Vector3& invDir, double& tMax, Intersector& intersect) const;
+
+	public:
+		BVH();
+		~BVH();
+
+		void	Build(const std::vector<AABB>& bounds, BuildMethod method = BUILD_SAH, int maxLeafSize = 4);
+
+		//Takes over a tree made by an earlier Build, as saved from GetNodes and GetItems, instead
+		//of building one. The vectors are emptied. Returns false, leaving the BVH empty, if the
+		//tree is not a valid one over numItems items.
+		bool	Assign(std::vector<Node>& nodes, std::vector<int>& items, int numItems, BuildMethod method);
+
+		//Updates the node bounds for items that have moved, keeping the tree as it is.
+		//Much faster than Build, but the tree gets worse the further the items move from
+		//where it was built; the build stats' sahCost shows by how much.
+		//Returns false, changing nothing, if bounds does not have one box per item.
+		bool	Refit(const std::vector<AABB>& bounds);
+		void	Clear();
+
+		inline bool IsEmpty() const
+		{
+			return m_nodes.empty();
+		}
+
+		inline BuildMethod GetBuildMethod() const
+		{
+			return m_method;
+		}
+
+		inline const BuildStats& GetBuildStats() const
+		{
+			return m_stats;
+		}
+
+		inline const std::vector<Node>& GetNodes() const
+		{
+			return m_nodes;
+		}
+
+		inline const std::vector<int>& GetItems() const
+		{
+			return m_items;
+		}
+
+		//Finds the closest hit along the ray.
+		//intersect(item, tMax) tests one item and, if it is hit closer than tMax,
+		//records the hit, lowers tMax to its t and returns true.
+		template <class Intersector>
+		bool ClosestHit(Ray& ray, double& tMax, Intersector& intersect) const;
+
+		//Finds the subtrees a bundle of rays may reach, for ClosestHitFrom. Nodes that
+		//outside(nodeIndex) rejects are left out; the others are split into their children,
+		//breadth first, while the subtrees kept fit in maxRoots. Returns how many were kept in
+		//roots, 0 if the bundle misses the whole tree.
+		template <class NodeFilter>
+		int Cut(NodeFilter& outside, int* roots, int maxRoots) const;
+
+		//ClosestHit looking only in the subtrees of a Cut, nearest first. The ray must be one of
+		//the bundle the cut was made for. Items are found in another order than ClosestHit's, so
+		//the answer is only the same if intersect breaks ties between items at the same t by
+		//something other than the order, as Scene does by primitive number.
+		template <class Intersector>
+		bool ClosestHitFrom(Ray& ray, double& tMax, Intersector& intersect, const int* roots, int rootCount) const;
+
+		//Stops at the first item hit before maxT.
+		//occluded(item, maxT) returns true if the item blocks the ray.
+		template <class Occluder>
+		bool AnyHit(Ray& ray, double maxT, Occluder& occluded) const;
+
+		//Walks the tree from the root into every node that enter(nodeIndex) accepts and calls
+		//visit(item) for the items of the leaves it reaches, e.g. to find the boxes holding a point
+		template <class NodeFilter, class Visitor>
+		void Query(NodeFilter& enter, Visitor& visit) const;
+
+		//Closest hit of every ray in a packet. A node is visited if any ray
+		//of the packet hits its box closer than that ray's current t.
+		//intersect(item) tests one item against the whole packet and updates the lanes it hits.
+		//Works on float and double packets.
+		template <class Real, class PacketIntersector>
+		void ClosestHitPacket(RayPacketT<Real>& packet, PacketIntersector& intersect) const;
+};
+
+inline Vector3 ReciprocalDirection(const Vector3& dir)
+{
+	//a zero component becomes a huge value rather than a division by zero
+	return Vector3(
+		dir[0] != 0.0 ? 1.0 / dir[0] : FARFAR_AWAY * FARFAR_AWAY,
+		dir[1] != 0.0 ? 1.0 / dir[1] : FARFAR_AWAY * FARFAR_AWAY,
+		dir[2] != 0.0 ? 1.0 / dir[2] : FARFAR_AWAY * FARFAR_AWAY);
+}
+
+template <class Intersector>
+bool BVH::ClosestHit(Ray& ray, double& tMax, Intersector& intersect) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	Vector3 start = ray.GetRayStart();
+	Vector3 invDir = ReciprocalDirection(ray.GetRay());
+	double tNear;
+
+	if (!m_nodes[0].bounds.IntersectByRay(start, invDir, tMax, tNear))
+		return false;
+
+	return ClosestHitBelow(0, start, invDir, tMax, intersect);
+}
+
+template <class Intersector>
+bool BVH::ClosestHitBelow(int nodeIndex, const Vector3& start, const Vector3& invDir, double& tMax, Intersector& intersect) const
+{
+	bool hit = false;
+	double tNear;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+
+	while (true)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				if (intersect(m_items[i], tMax))
+					hit = true;
+			}
+		}
+		else
+		{
+			//visit the nearer child first, it is more likely to shorten tMax for the other one
+			double tLeft = 0.0, tRight = 0.0;
+			bool hitLeft = m_nodes[node.first].bounds.IntersectByRay(start, invDir, tMax, tLeft);
+			bool hitRight = m_nodes[node.first + 1].bounds.IntersectByRay(start, invDir, tMax, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				int nearChild = tLeft <= tRight ? node.first : node.first + 1;
+				stack[stackSize++] = tLeft <= tRight ? node.first + 1 : node.first;
+				nodeIndex = nearChild;
+				continue;
+			}
+			if (hitLeft || hitRight)
+			{
+				nodeIndex = hitLeft ? node.first : node.first + 1;
+				continue;
+			}
+		}
+
+		//pop, skipping nodes that are now further away than the closest hit
+		bool found = false;
+		while (stackSize > 0 && !found)
+		{
+			nodeIndex = stack[--stackSize];
+			found = m_nodes[nodeIndex].bounds.IntersectByRay(start, invDir, tMax, tNear);
+		}
+
+		if (!found)
+			break;
+	}
+
+	return hit;
+}
+
+template <class NodeFilter>
+int BVH::Cut(NodeFilter& outside, int* roots, int maxRoots) const
+{
+	if (m_nodes.empty() || maxRoots < 1 || outside(0))
+		return 0;
+
+	roots[0] = 0;
+	int count = 1;
+
+	//roots before first are leaves, the rest wait to be split in the order they were found
+	int first = 0;
+
+	while (first < count)
+	{
+		const Node& node = m_nodes[roots[first]];
+
+		if (node.count > 0)
+		{
+			first++;
+			continue;
+		}
+
+		bool keepLeft = !outside(node.first);
+		bool keepRight = !outside(node.first + 1);
+		int children = (keepLeft ? 1 : 0) + (keepRight ? 1 : 0);
+
+		if (count - 1 + children > maxRoots)
+			break;
+
+		for (int i = first; i < count - 1; i++)
+		{
+			roots[i] = roots[i + 1];
+		}
+		count--;
+
+		if (keepLeft)
+			roots[count++] = node.first;
+		if (keepRight)
+			roots[count++] = node.first + 1;
+	}
+
+	return count;
+}
+
+template <class Intersector>
+bool BVH::ClosestHitFrom(Ray& ray, double& tMax, Intersector& intersect, const int* roots, int rootCount) const
+{
+	Vector3 start = ray.GetRayStart();
+	Vector3 invDir = ReciprocalDirection(ray.GetRay());
+	bool hit = false;
+
+	//the subtrees the ray reaches, sorted by where it enters them
+	int order[BVH_STACK_SIZE];
+	double entry[BVH_STACK_SIZE];
+	int count = 0;
+
+	for (int i = 0; i < rootCount && i < BVH_STACK_SIZE; i++)
+	{
+		double tNear;
+
+		if (!m_nodes[roots[i]].bounds.IntersectByRay(start, invDir, tMax, tNear))
+			continue;
+
+		int j = count++;
+		while (j > 0 && entry[j - 1] > tNear)
+		{
+			order[j] = order[j - 1];
+			entry[j] = entry[j - 1];
+			j--;
+		}
+		order[j] = roots[i];
+		entry[j] = tNear;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		//a closer hit found in an earlier subtree may put this one out of reach
+		if (entry[i] > tMax)
+			break;
+
+		if (ClosestHitBelow(order[i], start, invDir, tMax, intersect))
+			hit = true;
+	}
+
+	return hit;
+}
+
+template <class Occluder>
+bool BVH::AnyHit(Ray& ray, double maxT, Occluder& occluded) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	Vector3 start = ray.GetRayStart();
+	Vector3 invDir = ReciprocalDirection(ray.GetRay());
+	double tNear;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+
+		if (!node.bounds.IntersectByRay(start, invDir, maxT, tNear))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				if (occluded(m_items[i], maxT))
+					return true;
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.first + 1;
+			stack[stackSize++] = node.first;
+		}
+	}
+
+	return false;
+}
+
+template <class NodeFilter, class Visitor>
+void BVH::Query(NodeFilter& enter, Visitor& visit) const
+{
+	if (m_nodes.empty())
+		return;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0)
+	{
+		int nodeIndex = stack[--stackSize];
+		const Node& node = m_nodes[nodeIndex];
+
+		if (!enter(nodeIndex))
+			continue;
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				visit(m_items[i]);
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.first + 1;
+			stack[stackSize++] = node.first;
+		}
+	}
+}
+
+template <class Real, class PacketIntersector>
+void BVH::ClosestHitPacket(RayPacketT<Real>& packet, PacketIntersector& intersect) const
+{
+	if (m_nodes.empty())
+		return;
+
+	Real tNear;
+
+	if (!IntersectPacketBounds(m_nodes[0].bounds, packet, tNear))
+		return;
+
+	int stack[BVH_STACK_SIZE];
+	int stackSize = 0;
+	int nodeIndex = 0;
+
+	while (true)
+	{
+		const Node& node = m_nodes[nodeIndex];
+
+		if (node.count > 0)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				intersect(m_items[i]);
+			}
+		}
+		else
+		{
+			//as for a single ray, the child the packet reaches first goes first
+			Real tLeft = 0, tRight = 0;
+			bool hitLeft = IntersectPacketBounds(m_nodes[node.first].bounds, packet, tLeft);
+			bool hitRight = IntersectPacketBounds(m_nodes[node.first + 1].bounds, packet, tRight);
+
+			if (hitLeft && hitRight)
+			{
+				int nearChild = tLeft <= tRight ? node.first : node.first + 1;
+				stack[stackSize++] = tLeft <= tRight ? node.first + 1 : node.first;
+				nodeIndex = nearChild;
+				continue;
+			}
+			if (hitLeft || hitRight)
+			{
+				nodeIndex = hitLeft ? node.first : node.first + 1;
+				continue;
+			}
+		}
+
+		bool found = false;
+		while (stackSize > 0 && !found)
+		{
+			nodeIndex = stack[--stackSize];
+			found = IntersectPacketBounds(m_nodes[nodeIndex].bounds, packet, tNear);
+		}
+
+		if (!found)
+			break;
+	}
+}
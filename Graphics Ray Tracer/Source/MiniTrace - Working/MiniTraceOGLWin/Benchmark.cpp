@@ -0,0 +1,1263 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+// Headless benchmark: renders scenes without a window and reports
+// the timings and ray counts of every run as JSON.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//Visual Studio 2013 has only _snprintf, which returns -1 instead of the full length when it truncates
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+#include "Animation.h"
+#include "Box.h"
+#include "CameraNavigator.h"
+#include "ImageWriter.h"
+#include "Plane.h"
+#include "RayTracer.h"
+#include "RenderCluster.h"
+#include "Scene.h"
+#include "SceneLoader.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+
+struct FlagName
+{
+	const char*				name;
+	RayTracer::TraceFlag	flag;
+};
+
+static const FlagName s_flagNames[] =
+{
+	{ "ambient", RayTracer::TRACE_AMBIENT },
+	{ "diffuse", RayTracer::TRACE_DIFFUSE_AND_SPEC },
+	{ "shadow", RayTracer::TRACE_SHADOW },
+	{ "reflection", RayTracer::TRACE_REFLECTION },
+	{ "refraction", RayTracer::TRACE_REFRACTION },
+	{ "ortho", RayTracer::TRACE_ORTHO },
+};
+
+static const int s_numFlagNames = sizeof(s_flagNames) / sizeof(s_flagNames[0]);
+
+static void PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: minitrace_bench [options]\n"
+		"Every combination of the scenes, resolutions, trace levels and flags given is rendered.\n"
+		"  --scene NAME     default, spheres:N or mixed:N (N generated objects)\n"
+		"                   or file:PATH to load a scene file, or obj:PATH to put\n"
+		"                   an OBJ mesh in front of the camera, repeatable\n"
+		"  --res WxH        resolution, repeatable (default 640x480)\n"
+		"  --level N        trace level, repeatable (default 5)\n"
+		"  --flags LIST     trace flags joined by '+' from ambient, diffuse, shadow, reflection,\n"
+		"                   refraction and ortho, or 'all' (default), repeatable\n"
+		"  --threads N      render threads, 0 for one per core (default 0)\n"
+		"  --packet N       trace primary rays in packets of 4, 8 or 16, 0 for single rays,\n"
+		"                   repeatable (default 0)\n"
+		"  --progressive N  1 renders in coarse to fine passes and reports the time to the\n"
+		"                   first pass as well (default 0)\n"
+		"  --wavefront N    1 traces each tile one bounce level at a time, 0 recursively,\n"
+		"                   repeatable (default 0)\n"
+		"  --precision NAME double or float packet intersection tests, repeatable (default\n"
+		"                   both). Float runs are skipped without packets, where they are the\n"
+		"                   same as double, and report the pixels that differ from double\n"
+		"  --aa N           adaptive anti-aliasing with up to N samples per pixel, a square\n"
+		"                   from 4 to 64 or 1 for none, repeatable (default 1)\n"
+		"  --aa-threshold T colour difference that gets a pixel more samples (default 0.1)\n"
+		"  --aa-reference N 1 also renders uniform supersampling with the largest --aa and\n"
+		"                   reports the RMS error of every run against it (default 0)\n"
+		"  --workers N      also renders every combination across N worker processes started\n"
+		"                   on this machine, and reports the pixels that differ from the\n"
+		"                   local image (default 0)\n"
+		"  --fail-after N   the first worker drops out after N tiles, to test redispatch\n"
+		"  --worker H:P     run as a worker of the coordinator at host H, port P, and exit;\n"
+		"                   uses --threads and --fail-after\n"
+		"  --animation FILE render the frames of an animation file, see Animation.h, instead of\n"
+		"                   the combinations, using the first value of every option. The BVH\n"
+		"                   is refitted between frames and compared with a rebuild at the end\n"
+		"  --orbit N:STEPS  drag the camera round the scene STEPS times, N pixels to the right\n"
+		"                   each, with RayTracer::Reproject instead of the combinations, using\n"
+		"                   the first value of every option. Reports the pixels traced again and\n"
+		"                   the RMS error of each step against a full render of its view\n"
+		"  --lights N:R     add N point lights reaching R units, 0 for everywhere, scattered\n"
+		"                   over the objects of every scene\n"
+		"  --light-budget N most lights shading a hit, 0 for every light that reaches it\n"
+		"                   (default 0)\n"
+		"  --shadow-cache N 0 searches the whole scene for every shadow ray instead of\n"
+		"                   testing the light's last blocker first (default 1)\n"
+		"  --tile-culling N 0 sends every primary ray through the whole scene instead of\n"
+		"                   what its tile's frustum holds (default 1)\n"
+		"  --repeat N       renders per combination, the fastest is reported (default 3)\n"
+		"  --image FILE     save the last image (.ppm, .pfm or .png); with --animation a\n"
+		"                   printf pattern such as frame%%04d.png that numbers every frame\n"
+		"  --output FILE    write the JSON report to FILE instead of stdout\n");
+}
+
+static bool ParseFlags(const char* text, RayTracer::TraceFlag& flags)
+{
+	int result = 0;
+	std::string list = text;
+	size_t start = 0;
+
+	while (start <= list.size())
+	{
+		size_t end = list.find('+', start);
+		if (end == std::string::npos)
+			end = list.size();
+
+		std::string name = list.substr(start, end - start);
+		bool found = false;
+
+		if (name == "all")
+		{
+			result |= RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC | RayTracer::TRACE_SHADOW
+				| RayTracer::TRACE_REFLECTION | RayTracer::TRACE_REFRACTION;
+			found = true;
+		}
+
+		for (int i = 0; i < s_numFlagNames && !found; i++)
+		{
+			if (name == s_flagNames[i].name)
+			{
+				result |= s_flagNames[i].flag;
+				found = true;
+			}
+		}
+
+		if (!found)
+			return false;
+
+		start = end + 1;
+	}
+
+	flags = (RayTracer::TraceFlag)result;
+	return true;
+}
+
+static std::string FlagsToString(RayTracer::TraceFlag flags)
+{
+	std::string text;
+
+	for (int i = 0; i < s_numFlagNames; i++)
+	{
+		if (flags & s_flagNames[i].flag)
+		{
+			if (!text.empty())
+				text += "+";
+			text += s_flagNames[i].name;
+		}
+	}
+	return text;
+}
+
+//A small deterministic generator so every run builds the same scene
+static unsigned int s_seed;
+
+static double Random(double lo, double hi)
+{
+	s_seed = s_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * ((s_seed >> 8) / 16777216.0);
+}
+
+//Fills the scene with count objects scattered in front of the default camera, over a floor.
+//"spheres" makes only spheres, "mixed" cycles through spheres, boxes and triangles.
+static void GenerateScene(Scene& scene, bool mixed, int count)
+{
+	scene.CleanupScene();
+	s_seed = 12345u;
+
+	std::vector<Material*> palette;
+	for (int i = 0; i < 8; i++)
+	{
+		Material* mat = scene.Create<Material>();
+		mat->SetDiffuseColour((float)Random(0.1, 1.0), (float)Random(0.1, 1.0), (float)Random(0.1, 1.0));
+		mat->SetSpecularColour(1.0, 1.0, 1.0);
+		mat->SetSpecPower(Random(2.0, 40.0));
+		scene.AddMaterial(mat);
+		palette.push_back(mat);
+	}
+
+	//objects shrink as there are more of them so the scene stays about as full
+	double size = 6.0 / pow((double)count, 1.0 / 3.0);
+	if (size > 2.0)
+		size = 2.0;
+
+	for (int i = 0; i < count; i++)
+	{
+		Vector3 centre(Random(-12.0, 12.0), Random(1.0, 18.0), Random(-30.0, 2.0));
+		double scale = size * Random(0.3, 1.0);
+		Primitive* obj;
+
+		switch (mixed ? i % 3 : 0)
+		{
+		case 0:
+			obj = scene.Create<Sphere>(centre[0], centre[1], centre[2], scale);
+			break;
+		case 1:
+			obj = scene.Create<Box>(centre, scale * 1.5, scale * 1.5, scale * 1.5);
+			break;
+		default:
+			obj = scene.Create<Triangle>(centre + Vector3(-scale, -scale, 0.0),
+				centre + Vector3(scale, -scale, 0.0),
+				centre + Vector3(0.0, scale, Random(-scale, scale)));
+			break;
+		}
+
+		obj->SetMaterial(palette[i % palette.size()]);
+		scene.AddObject(obj);
+	}
+
+	Plane* floor = scene.Create<Plane>();
+	floor->SetPlane(Vector3(0.0, 1.0, 0.0), 0.0);
+	Material* floorMat = scene.Create<Material>();
+	floorMat->SetDiffuseColour(1.0, 0.0, 0.0);
+	floorMat->SetSpecularColour(0.0, 0.0, 0.0);
+	floorMat->SetCastShadow(false);
+	floor->SetMaterial(floorMat);
+	scene.AddMaterial(floorMat);
+	scene.AddObject(floor);
+
+	Light* light = scene.Create<Light>();
+	light->SetLightPosition(-3.0, 25.0, 10.0);
+	scene.AddLight(light);
+
+	scene.Commit();
+}
+
+//Scatters count lights through the box round the scene's bounded objects, each reaching
+//radius. They are dimmed by the number expected to reach a point so the image stays lit
+//about as brightly whatever the count.
+static void AddLights(Scene& scene, int count, double radius)
+{
+	s_seed = 54321u;
+
+	AABB bounds(Vector3(-20.0, 0.0, -30.0), Vector3(20.0, 20.0, 10.0));
+	if (!scene.GetBVH().IsEmpty())
+		bounds = scene.GetBVH().GetNodes()[0].bounds;
+
+	Vector3 size = bounds.max - bounds.min;
+	double volume = std::max(size[0], 1.0) * std::max(size[1], 1.0) * std::max(size[2], 1.0);
+	double reaching = radius > 0.0 ? count * (4.0 / 3.0 * 3.14159265358979 * radius * radius * radius) / volume : count;
+	double brightness = 1.0 / std::max(reaching, 1.0);
+
+	for (int i = 0; i < count; i++)
+	{
+		Light* light = scene.Create<Light>();
+		light->SetLightPosition(Random(bounds.min[0], bounds.max[0]), Random(bounds.min[1], bounds.max[1]),
+			Random(bounds.min[2], bounds.max[2]));
+		light->SetLightColour(brightness * Random(0.5, 1.0), brightness * Random(0.5, 1.0), brightness * Random(0.5, 1.0));
+		light->SetRadius(radius);
+		scene.AddLight(light);
+	}
+
+	scene.CommitLights();
+}
+
+//Puts the mesh in an OBJ file over the floor in front of the default camera
+static bool MeshScene(Scene& scene, const char* filename)
+{
+	scene.CleanupScene();
+
+	TriangleMesh* mesh = scene.Create<TriangleMesh>();
+	std::string error;
+
+	if (!mesh->LoadOBJ(filename, error))
+	{
+		fprintf(stderr, "%s\n", error.c_str());
+		return false;
+	}
+
+	mesh->Fit(Vector3(0.0, 6.0, 0.0), 10.0);
+
+	Material* meshMat = scene.Create<Material>();
+	meshMat->SetDiffuseColour(0.8f, 0.8f, 0.8f);
+	meshMat->SetSpecularColour(1.0, 1.0, 1.0);
+	meshMat->SetSpecPower(20.0);
+	mesh->SetMaterial(meshMat);
+	scene.AddMaterial(meshMat);
+	scene.AddObject(mesh);
+
+	Plane* floor = scene.Create<Plane>();
+	floor->SetPlane(Vector3(0.0, 1.0, 0.0), 0.0);
+	Material* floorMat = scene.Create<Material>();
+	floorMat->SetDiffuseColour(1.0, 0.0, 0.0);
+	floorMat->SetSpecularColour(0.0, 0.0, 0.0);
+	floorMat->SetCastShadow(false);
+	floor->SetMaterial(floorMat);
+	scene.AddMaterial(floorMat);
+	scene.AddObject(floor);
+
+	Light* light = scene.Create<Light>();
+	light->SetLightPosition(-3.0, 25.0, 10.0);
+	scene.AddLight(light);
+
+	scene.Commit();
+	return true;
+}
+
+static bool SetupScene(Scene& scene, const std::string& name)
+{
+	if (name == "default")
+	{
+		scene.CleanupScene();
+		scene.InitDefaultScene();
+		return true;
+	}
+
+	size_t colon = name.find(':');
+	if (colon == std::string::npos)
+		return false;
+
+	std::string kind = name.substr(0, colon);
+
+	if (kind == "file")
+	{
+		SceneLoader loader;
+
+		if (!loader.Load(name.c_str() + colon + 1, scene))
+		{
+			fprintf(stderr, "%s\n", loader.GetError().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	if (kind == "obj")
+		return MeshScene(scene, name.c_str() + colon + 1);
+
+	int count = atoi(name.c_str() + colon + 1);
+
+	if (count <= 0 || (kind != "spheres" && kind != "mixed"))
+		return false;
+
+	GenerateScene(scene, kind == "mixed", count);
+	return true;
+}
+
+static double PerSecond(unsigned long long count, double ms)
+{
+	return ms > 0.0 ? count * 1000.0 / ms : 0.0;
+}
+
+//Root mean square difference of the channels of two images of the same size
+static double RMSError(const FrameBuffer& image, const FrameBuffer& reference)
+{
+	int count = image.GetWidth() * image.GetHeight() * 3;
+	double sum = 0.0;
+
+	for (int i = 0; i < count; i++)
+	{
+		double diff = image.GetData()[i] - reference.GetData()[i];
+		sum += diff * diff;
+	}
+	return count > 0 ? sqrt(sum / count) : 0.0;
+}
+
+//True if the pattern has exactly one integer conversion, such as %d or %04d, and no other
+static bool IsFramePattern(const char* pattern)
+{
+	int conversions = 0;
+
+	for (const char* c = strchr(pattern, '%'); c; c = strchr(c, '%'))
+	{
+		c++;
+		if (*c == '%')
+		{
+			c++;
+			continue;
+		}
+
+		while (*c >= '0' && *c <= '9')
+		{
+			c++;
+		}
+
+		if (*c != 'd')
+			return false;
+		conversions++;
+	}
+	return conversions == 1;
+}
+
+//Renders every frame of the animation with the tracer and writes one run to the report.
+//The frames are saved to imagePattern if it is set.
+static bool RenderAnimation(Scene& scene, RayTracer& tracer, Animation& animation, const std::string& sceneName,
+	const char* imagePattern, FILE* out)
+{
+	double totalMs = 0.0;
+	double totalRefitMs = 0.0;
+	double maxRefitMs = 0.0;
+	unsigned long long primaryRays = 0;
+	unsigned long long totalRays = 0;
+
+	for (int frame = 0; frame < animation.GetFrameCount(); frame++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		if (!animation.Apply(scene, frame))
+		{
+			fprintf(stderr, "%s\n", animation.GetError().c_str());
+			return false;
+		}
+
+		std::chrono::duration<double, std::milli> refit = std::chrono::high_resolution_clock::now() - start;
+
+		tracer.ResetRenderCount();
+		do
+		{
+			tracer.DoRayTrace(&scene);
+		} while (!tracer.IsRenderComplete());
+
+		std::chrono::duration<double, std::milli> wall = std::chrono::high_resolution_clock::now() - start;
+
+		totalMs += wall.count();
+		totalRefitMs += refit.count();
+		maxRefitMs = std::max(maxRefitMs, refit.count());
+		primaryRays += tracer.GetRenderStats().primaryRays;
+		totalRays += tracer.GetRenderStats().GetTotalRays();
+
+		if (imagePattern)
+		{
+			char filename[1024];
+			int length = snprintf(filename, sizeof(filename), imagePattern, frame);
+
+			if (length < 0 || length >= (int)sizeof(filename))
+			{
+				fprintf(stderr, "The image name for frame %d is too long\n", frame);
+				return false;
+			}
+
+			ImageWriter* writer = ImageWriter::CreateForFile(filename);
+			if (!writer || !writer->Write(filename, tracer.GetFrameBuffer()))
+			{
+				fprintf(stderr, "Cannot save %s\n", filename);
+				delete writer;
+				return false;
+			}
+			delete writer;
+		}
+	}
+
+	//how much the refitted tree has worsened against one built for the last frame
+	double refitSahCost = scene.GetBVHStats().sahCost;
+	scene.Commit();
+	double rebuildSahCost = scene.GetBVHStats().sahCost;
+	double rebuildMs = scene.GetBVHStats().buildTimeMs;
+
+	animation.Reset(scene);
+
+	int frames = animation.GetFrameCount();
+
+	fprintf(out, "\n    {\n");
+	fprintf(out, "      \"scene\": \"%s\",\n", sceneName.c_str());
+	fprintf(out, "      \"objects\": %d,\n", (int)scene.GetObjectCount());
+	fprintf(out, "      \"width\": %d,\n", tracer.GetWidth());
+	fprintf(out, "      \"height\": %d,\n", tracer.GetHeight());
+	fprintf(out, "      \"traceLevel\": %d,\n", tracer.GetTraceLevel());
+	fprintf(out, "      \"flags\": \"%s\",\n", FlagsToString(tracer.m_traceflag).c_str());
+	fprintf(out, "      \"threads\": %d,\n", tracer.GetThreadCount());
+	fprintf(out, "      \"frames\": %d,\n", frames);
+	fprintf(out, "      \"wallTimeMs\": %.3f,\n", totalMs);
+	fprintf(out, "      \"meanFrameMs\": %.3f,\n", totalMs / frames);
+	fprintf(out, "      \"meanRefitMs\": %.3f,\n", totalRefitMs / frames);
+	fprintf(out, "      \"maxRefitMs\": %.3f,\n", maxRefitMs);
+	fprintf(out, "      \"rebuildMs\": %.3f,\n", rebuildMs);
+	fprintf(out, "      \"refitSahCost\": %.3f,\n", refitSahCost);
+	fprintf(out, "      \"rebuildSahCost\": %.3f,\n", rebuildSahCost);
+	fprintf(out, "      \"primaryRays\": %llu,\n", primaryRays);
+	fprintf(out, "      \"raysPerSec\": %.1f\n", PerSecond(totalRays, totalMs));
+	fprintf(out, "    }");
+	return true;
+}
+
+//Drags the camera round the scene, reprojecting the image at each step as the viewers do,
+//and writes one run to the report. The reference tracer renders every view in full to
+//compare with. The last reprojected image is saved to imageFile if it is set.
+static bool RenderOrbit(Scene& scene, RayTracer& tracer, RayTracer& reference, int dragPixels, int steps,
+	const std::string& sceneName, const char* imageFile, FILE* out)
+{
+	Camera* cam = scene.GetSceneCamera();
+	Vector3 position = cam->GetPosition();
+	Vector3 view = cam->GetViewVector();
+	Vector3 up = cam->GetUpVector();
+	Vector3 right = cam->GetRightVector();
+	double focalLength = cam->GetFocalLength();
+
+	tracer.SetReprojection(true);
+	tracer.ResetRenderCount();
+	do
+	{
+		tracer.DoRayTrace(&scene);
+	} while (!tracer.IsRenderComplete());
+
+	double firstMs = tracer.GetRenderStats().renderTimeMs;
+	double totalMs = 0.0;
+	double totalFullMs = 0.0;
+	double totalError = 0.0;
+	double maxError = 0.0;
+	unsigned long long tracedPixels = 0;
+
+	CameraNavigator navigator;
+	navigator.Begin(&scene, tracer, 0, 0, CameraNavigator::NAVIGATE_ORBIT);
+
+	for (int step = 1; step <= steps; step++)
+	{
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+		navigator.Drag(&scene, step * dragPixels, 0);
+		tracer.Reproject(&scene);
+		do
+		{
+			tracer.DoRayTrace(&scene);
+		} while (!tracer.IsRenderComplete());
+
+		std::chrono::duration<double, std::milli> wall = std::chrono::high_resolution_clock::now() - start;
+
+		reference.ResetRenderCount();
+		do
+		{
+			reference.DoRayTrace(&scene);
+		} while (!reference.IsRenderComplete());
+
+		double error = RMSError(tracer.GetFrameBuffer(), reference.GetFrameBuffer());
+
+		totalMs += wall.count();
+		totalFullMs += reference.GetRenderStats().renderTimeMs;
+		totalError += error;
+		maxError = std::max(maxError, error);
+		tracedPixels += tracer.GetRenderStats().primaryRays;
+	}
+
+	navigator.End();
+	cam->SetFrame(position, view, up, right, focalLength);
+	tracer.SetReprojection(false);
+
+	if (imageFile)
+	{
+		ImageWriter* writer = ImageWriter::CreateForFile(imageFile);
+		if (!writer || !writer->Write(imageFile, tracer.GetFrameBuffer()))
+		{
+			fprintf(stderr, "Cannot save %s\n", imageFile);
+			delete writer;
+			return false;
+		}
+		delete writer;
+	}
+
+	double pixels = (double)tracer.GetWidth() * tracer.GetHeight() * std::max(steps, 1);
+	int count = std::max(steps, 1);
+
+	fprintf(out, "\n    {\n");
+	fprintf(out, "      \"scene\": \"%s\",\n", sceneName.c_str());
+	fprintf(out, "      \"objects\": %d,\n", (int)scene.GetObjectCount());
+	fprintf(out, "      \"width\": %d,\n", tracer.GetWidth());
+	fprintf(out, "      \"height\": %d,\n", tracer.GetHeight());
+	fprintf(out, "      \"traceLevel\": %d,\n", tracer.GetTraceLevel());
+	fprintf(out, "      \"flags\": \"%s\",\n", FlagsToString(tracer.m_traceflag).c_str());
+	fprintf(out, "      \"threads\": %d,\n", tracer.GetThreadCount());
+	fprintf(out, "      \"orbitSteps\": %d,\n", steps);
+	fprintf(out, "      \"orbitStepPixels\": %d,\n", dragPixels);
+	fprintf(out, "      \"firstRenderMs\": %.3f,\n", firstMs);
+	fprintf(out, "      \"meanReprojectedStepMs\": %.3f,\n", totalMs / count);
+	fprintf(out, "      \"meanFullRenderMs\": %.3f,\n", totalFullMs / count);
+	fprintf(out, "      \"tracedFraction\": %.4f,\n", tracedPixels / pixels);
+	fprintf(out, "      \"meanRmseFromFull\": %.6f,\n", totalError / count);
+	fprintf(out, "      \"maxRmseFromFull\": %.6f\n", maxError);
+	fprintf(out, "    }");
+	return true;
+}
+
+//A worker process started by the benchmark
+struct WorkerProcess
+{
+#ifdef _WIN32
+	HANDLE		process;
+#else
+	pid_t		pid;
+#endif
+};
+
+//Starts this program again as a worker of the coordinator on the local port
+static bool StartWorker(const char* program, int port, int threads, int failAfter, WorkerProcess& worker)
+{
+	std::string address = "127.0.0.1:" + std::to_string(port);
+	std::string threadCount = std::to_string(threads);
+	std::string failCount = std::to_string(failAfter);
+
+#ifdef _WIN32
+	std::string command = "\"" + std::string(program) + "\" --worker " + address + " --threads " + threadCount
+		+ " --fail-after " + failCount;
+
+	STARTUPINFOA startup;
+	PROCESS_INFORMATION info;
+	memset(&startup, 0, sizeof(startup));
+	startup.cb = sizeof(startup);
+
+	if (!CreateProcessA(NULL, &command[0], NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info))
+		return false;
+
+	CloseHandle(info.hThread);
+	worker.process = info.hProcess;
+	return true;
+#else
+	worker.pid = fork();
+	if (worker.pid < 0)
+		return false;
+
+	if (worker.pid == 0)
+	{
+		const char* args[] = { program, "--worker", address.c_str(), "--threads", threadCount.c_str(),
+			"--fail-after", failCount.c_str(), nullptr };
+		execvp(program, (char* const*)args);
+		_exit(1);
+	}
+	return true;
+#endif
+}
+
+static void WaitForWorker(WorkerProcess& worker)
+{
+#ifdef _WIN32
+	WaitForSingleObject(worker.process, INFINITE);
+	CloseHandle(worker.process);
+#else
+	int status;
+	waitpid(worker.pid, &status, 0);
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> scenes;
+	std::vector<int> widths, heights, levels, packetSizes, wavefronts, aaSamples;
+	std::vector<RayPrecision> precisions;
+	std::vector<RayTracer::TraceFlag> flagSets;
+	int threads = 0;
+	int repeat = 3;
+	bool progressive = false;
+	double aaThreshold = AA_DEFAULT_THRESHOLD;
+	bool aaReference = false;
+	const char* imageFile = nullptr;
+	const char* outputFile = nullptr;
+	int workers = 0;
+	int failAfter = -1;
+	const char* workerAddress = nullptr;
+	const char* animationFile = nullptr;
+	int orbitPixels = 0;
+	int orbitSteps = 0;
+	int extraLights = 0;
+	double lightRadius = 0.0;
+	int lightBudget = 0;
+	bool shadowCache = true;
+	bool tileCulling = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!strcmp(arg, "--help") || !strcmp(arg, "-h"))
+		{
+			PrintUsage();
+			return 0;
+		}
+
+		if (!value)
+		{
+			fprintf(stderr, "Missing value for %s\n", arg);
+			PrintUsage();
+			return 1;
+		}
+		i++;
+
+		if (!strcmp(arg, "--scene"))
+		{
+			scenes.push_back(value);
+		}
+		else if (!strcmp(arg, "--res"))
+		{
+			int w, h;
+			if (sscanf(value, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+			{
+				fprintf(stderr, "Bad resolution %s\n", value);
+				return 1;
+			}
+			widths.push_back(w);
+			heights.push_back(h);
+		}
+		else if (!strcmp(arg, "--level"))
+		{
+			levels.push_back(atoi(value));
+		}
+		else if (!strcmp(arg, "--flags"))
+		{
+			RayTracer::TraceFlag flags;
+			if (!ParseFlags(value, flags))
+			{
+				fprintf(stderr, "Bad trace flags %s\n", value);
+				return 1;
+			}
+			flagSets.push_back(flags);
+		}
+		else if (!strcmp(arg, "--threads"))
+		{
+			threads = atoi(value);
+		}
+		else if (!strcmp(arg, "--packet"))
+		{
+			int size = atoi(value);
+			if (size != 0 && size != 4 && size != 8 && size != 16)
+			{
+				fprintf(stderr, "Bad packet size %s\n", value);
+				return 1;
+			}
+			packetSizes.push_back(size);
+		}
+		else if (!strcmp(arg, "--progressive"))
+		{
+			progressive = atoi(value) != 0;
+		}
+		else if (!strcmp(arg, "--wavefront"))
+		{
+			wavefronts.push_back(atoi(value) != 0);
+		}
+		else if (!strcmp(arg, "--precision"))
+		{
+			if (strcmp(value, "double") && strcmp(value, "float"))
+			{
+				fprintf(stderr, "Precision must be double or float\n");
+				return 1;
+			}
+			precisions.push_back(strcmp(value, "float") ? PRECISION_DOUBLE : PRECISION_FLOAT);
+		}
+		else if (!strcmp(arg, "--aa"))
+		{
+			RayTracer check;
+			if (!check.SetAntiAliasing(atoi(value)))
+			{
+				fprintf(stderr, "Bad anti-aliasing sample count %s\n", value);
+				return 1;
+			}
+			aaSamples.push_back(atoi(value));
+		}
+		else if (!strcmp(arg, "--aa-threshold"))
+		{
+			aaThreshold = atof(value);
+			if (aaThreshold < 0.0)
+			{
+				fprintf(stderr, "Bad anti-aliasing threshold %s\n", value);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--aa-reference"))
+		{
+			aaReference = atoi(value) != 0;
+		}
+		else if (!strcmp(arg, "--workers"))
+		{
+			workers = atoi(value) > 0 ? atoi(value) : 0;
+		}
+		else if (!strcmp(arg, "--fail-after"))
+		{
+			failAfter = atoi(value);
+		}
+		else if (!strcmp(arg, "--worker"))
+		{
+			workerAddress = value;
+		}
+		else if (!strcmp(arg, "--animation"))
+		{
+			animationFile = value;
+		}
+		else if (!strcmp(arg, "--orbit"))
+		{
+			if (sscanf(value, "%d:%d", &orbitPixels, &orbitSteps) != 2 || orbitSteps <= 0)
+			{
+				fprintf(stderr, "Bad orbit %s\n", value);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--lights"))
+		{
+			if (sscanf(value, "%d:%lf", &extraLights, &lightRadius) != 2 || extraLights < 0 || lightRadius < 0.0)
+			{
+				fprintf(stderr, "Bad lights %s\n", value);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--light-budget"))
+		{
+			lightBudget = atoi(value);
+			if (lightBudget < 0)
+			{
+				fprintf(stderr, "Bad light budget %s\n", value);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "--shadow-cache"))
+		{
+			shadowCache = atoi(value) != 0;
+		}
+		else if (!strcmp(arg, "--tile-culling"))
+		{
+			tileCulling = atoi(value) != 0;
+		}
+		else if (!strcmp(arg, "--repeat"))
+		{
+			repeat = atoi(value) > 0 ? atoi(value) : 1;
+		}
+		else if (!strcmp(arg, "--image"))
+		{
+			imageFile = value;
+		}
+		else if (!strcmp(arg, "--output"))
+		{
+			outputFile = value;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", arg);
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (workerAddress)
+	{
+		const char* colon = strrchr(workerAddress, ':');
+		if (!colon || atoi(colon + 1) <= 0)
+		{
+			fprintf(stderr, "Bad worker address %s\n", workerAddress);
+			return 1;
+		}
+
+		RenderWorker worker;
+		std::string host(workerAddress, colon);
+		std::string error;
+
+		worker.SetThreadCount(threads);
+		worker.SetFailAfter(failAfter);
+		if (!worker.Run(host.c_str(), atoi(colon + 1), error))
+		{
+			fprintf(stderr, "Worker: %s\n", error.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	if (scenes.empty())
+		scenes.push_back("default");
+	if (widths.empty())
+	{
+		widths.push_back(640);
+		heights.push_back(480);
+	}
+	if (levels.empty())
+		levels.push_back(5);
+	if (packetSizes.empty())
+		packetSizes.push_back(0);
+	if (wavefronts.empty())
+		wavefronts.push_back(0);
+	if (aaSamples.empty())
+		aaSamples.push_back(1);
+	if (precisions.empty())
+	{
+		precisions.push_back(PRECISION_DOUBLE);
+		precisions.push_back(PRECISION_FLOAT);
+	}
+	if (flagSets.empty())
+	{
+		RayTracer::TraceFlag flags;
+		ParseFlags("all", flags);
+		flagSets.push_back(flags);
+	}
+
+	Animation animation;
+	if (animationFile)
+	{
+		if (!animation.Load(animationFile))
+		{
+			fprintf(stderr, "%s\n", animation.GetError().c_str());
+			return 1;
+		}
+
+		if (imageFile && !IsFramePattern(imageFile))
+		{
+			fprintf(stderr, "--image needs a frame number pattern such as frame%%04d.png with --animation\n");
+			return 1;
+		}
+
+		if (orbitSteps > 0)
+		{
+			fprintf(stderr, "--animation and --orbit cannot be used together\n");
+			return 1;
+		}
+	}
+
+	FILE* out = stdout;
+	if (outputFile && !(out = fopen(outputFile, "w")))
+	{
+		fprintf(stderr, "Cannot open %s\n", outputFile);
+		return 1;
+	}
+
+	RenderCoordinator coordinator;
+	std::vector<WorkerProcess> workerProcesses;
+
+	if (workers > 0)
+	{
+		if (!coordinator.Listen("127.0.0.1", 0))
+		{
+			fprintf(stderr, "Cannot listen for workers\n");
+			return 1;
+		}
+
+		for (int i = 0; i < workers; i++)
+		{
+			WorkerProcess worker;
+			if (!StartWorker(argv[0], coordinator.GetPort(), threads, i == 0 ? failAfter : -1, worker))
+			{
+				fprintf(stderr, "Cannot start worker %d\n", i);
+				break;
+			}
+			workerProcesses.push_back(worker);
+		}
+
+		if (coordinator.AcceptWorkers((int)workerProcesses.size(), 10000) < workers)
+			fprintf(stderr, "Only %d of %d workers connected\n", coordinator.GetWorkerCount(), workers);
+	}
+
+	fprintf(out, "{\n  \"benchmark\": \"minitrace\",\n  \"runs\": [");
+
+	Scene scene;
+	bool firstRun = true;
+	RayTracer* lastTracer = nullptr;
+
+	for (size_t s = 0; s < scenes.size(); s++)
+	{
+		std::chrono::high_resolution_clock::time_point setupStart = std::chrono::high_resolution_clock::now();
+
+		if (!SetupScene(scene, scenes[s]))
+		{
+			fprintf(stderr, "Unknown scene %s\n", scenes[s].c_str());
+			return 1;
+		}
+
+		if (extraLights > 0)
+			AddLights(scene, extraLights, lightRadius);
+
+		std::chrono::duration<double, std::milli> setupTime = std::chrono::high_resolution_clock::now() - setupStart;
+
+		//animations and orbits use the first value of every option
+		auto setupFirst = [&](RayTracer& tracer)
+		{
+			tracer.SetVerbose(false);
+			tracer.SetThreadCount(threads);
+			tracer.SetTraceLevel(levels[0]);
+			tracer.SetPacketSize(packetSizes[0]);
+			tracer.SetProgressive(progressive);
+			tracer.SetWavefront(wavefronts[0] != 0);
+			tracer.SetPrecision(precisions[0]);
+			tracer.SetAntiAliasing(aaSamples[0], aaThreshold);
+			tracer.SetLightBudget(lightBudget);
+			tracer.SetShadowCache(shadowCache);
+			tracer.SetTileCulling(tileCulling);
+			tracer.m_traceflag = flagSets[0];
+		};
+
+		if (animationFile)
+		{
+			RayTracer tracer(widths[0], heights[0]);
+			setupFirst(tracer);
+			scene.SetSceneWidth((double)widths[0] / heights[0]);
+
+			if (!firstRun)
+				fprintf(out, ",");
+			if (!RenderAnimation(scene, tracer, animation, scenes[s], imageFile, out))
+				return 1;
+
+			firstRun = false;
+			continue;
+		}
+
+		if (orbitSteps > 0)
+		{
+			RayTracer tracer(widths[0], heights[0]);
+			RayTracer reference(widths[0], heights[0]);
+			setupFirst(tracer);
+			setupFirst(reference);
+			scene.SetSceneWidth((double)widths[0] / heights[0]);
+
+			if (!firstRun)
+				fprintf(out, ",");
+			if (!RenderOrbit(scene, tracer, reference, orbitPixels, orbitSteps, scenes[s], imageFile, out))
+				return 1;
+
+			firstRun = false;
+			continue;
+		}
+
+		for (size_t r = 0; r < widths.size(); r++)
+		{
+			for (size_t l = 0; l < levels.size(); l++)
+			{
+				for (size_t f = 0; f < flagSets.size(); f++)
+				{
+					//uniform supersampling with the most samples asked for, the runs are compared with it
+					FrameBuffer uniform;
+					unsigned long long uniformRays = 0;
+					int uniformSamples = *std::max_element(aaSamples.begin(), aaSamples.end());
+
+					if (aaReference && uniformSamples > 1)
+					{
+						RayTracer tracer(widths[r], heights[r]);
+						tracer.SetVerbose(false);
+						tracer.SetThreadCount(threads);
+						tracer.SetTraceLevel(levels[l]);
+						tracer.SetAntiAliasing(uniformSamples, 0.0);
+						tracer.SetLightBudget(lightBudget);
+						tracer.SetShadowCache(shadowCache);
+						tracer.SetTileCulling(tileCulling);
+						tracer.m_traceflag = flagSets[f];
+						scene.SetSceneWidth((double)widths[r] / heights[r]);
+
+						tracer.DoRayTrace(&scene);
+						uniform = tracer.GetFrameBuffer();
+						uniformRays = tracer.GetRenderStats().primaryRays;
+					}
+
+					for (size_t p = 0; p < packetSizes.size(); p++)
+					{
+						for (size_t w = 0; w < wavefronts.size(); w++)
+						{
+							for (size_t a = 0; a < aaSamples.size(); a++)
+							{
+								//the last double image of this combination, float runs are compared with it
+								FrameBuffer reference;
+								bool haveReference = false;
+
+								for (size_t q = 0; q < precisions.size(); q++)
+								{
+									if (precisions[q] == PRECISION_FLOAT && packetSizes[p] == 0)
+										continue;
+
+									delete lastTracer;
+									RayTracer* tracer = lastTracer = new RayTracer(widths[r], heights[r]);
+									tracer->SetVerbose(false);
+									tracer->SetThreadCount(threads);
+									tracer->SetTraceLevel(levels[l]);
+									tracer->SetPacketSize(packetSizes[p]);
+									tracer->SetProgressive(progressive);
+									tracer->SetWavefront(wavefronts[w] != 0);
+									tracer->SetPrecision(precisions[q]);
+									tracer->SetAntiAliasing(aaSamples[a], aaThreshold);
+									tracer->SetLightBudget(lightBudget);
+									tracer->SetShadowCache(shadowCache);
+									tracer->SetTileCulling(tileCulling);
+									tracer->m_traceflag = flagSets[f];
+									scene.SetSceneWidth((double)widths[r] / heights[r]);
+
+									double bestMs = 0.0;
+									double totalMs = 0.0;
+									double bestFirstPassMs = 0.0;
+									int passes = 0;
+
+									for (int n = 0; n < repeat; n++)
+									{
+										tracer->ResetRenderCount();
+
+										std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+										std::chrono::duration<double, std::milli> firstPass(0.0);
+										passes = 0;
+
+										//a progressive render takes one call per pass
+										do
+										{
+											tracer->DoRayTrace(&scene);
+											if (passes++ == 0)
+												firstPass = std::chrono::high_resolution_clock::now() - start;
+										} while (!tracer->IsRenderComplete());
+
+										std::chrono::duration<double, std::milli> wall = std::chrono::high_resolution_clock::now() - start;
+
+										totalMs += wall.count();
+										if (n == 0 || firstPass.count() < bestFirstPassMs)
+											bestFirstPassMs = firstPass.count();
+										if (n == 0 || wall.count() < bestMs)
+											bestMs = wall.count();
+									}
+
+									//the same render across the workers, the losses are summed over the repeats
+									FrameBuffer distributed;
+									double bestDistributedMs = 0.0;
+									int workersAtStart = coordinator.GetWorkerCount();
+									int workersLost = 0;
+									int tilesRedispatched = 0;
+									int localTiles = 0;
+
+									for (int n = 0; n < repeat && workers > 0; n++)
+									{
+										coordinator.Render(*tracer, scene, distributed);
+
+										double wall = coordinator.GetRenderStats().renderTimeMs;
+										if (n == 0 || wall < bestDistributedMs)
+											bestDistributedMs = wall;
+										workersLost += coordinator.GetWorkersLost();
+										tilesRedispatched += coordinator.GetTilesRedispatched();
+										localTiles += coordinator.GetLocalTiles();
+									}
+
+									//the counts are the same every repeat, only the time changes
+									const RenderStats& stats = tracer->GetRenderStats();
+									unsigned long long totalRays = stats.GetTotalRays();
+									const FrameBuffer& image = tracer->GetFrameBuffer();
+									int differentPixels = -1;
+
+									if (precisions[q] == PRECISION_DOUBLE)
+									{
+										reference = image;
+										haveReference = true;
+									}
+									else if (haveReference)
+									{
+										differentPixels = 0;
+										for (int i = 0; i < image.GetWidth() * image.GetHeight() * 3; i += 3)
+										{
+											if (memcmp(image.GetData() + i, reference.GetData() + i, 3 * sizeof(float)))
+												differentPixels++;
+										}
+									}
+
+									fprintf(out, "%s\n    {\n", firstRun ? "" : ",");
+									fprintf(out, "      \"scene\": \"%s\",\n", scenes[s].c_str());
+									fprintf(out, "      \"objects\": %d,\n", (int)scene.GetObjectCount());
+									fprintf(out, "      \"lights\": %d,\n", (int)scene.GetLightList()->size());
+									fprintf(out, "      \"lightBudget\": %d,\n", lightBudget);
+									fprintf(out, "      \"shadowCache\": %s,\n", shadowCache ? "true" : "false");
+									fprintf(out, "      \"tileCulling\": %s,\n", tileCulling ? "true" : "false");
+									fprintf(out, "      \"sceneSetupMs\": %.3f,\n", setupTime.count());
+									fprintf(out, "      \"sceneArena\": { \"objects\": %llu, \"usedBytes\": %llu, \"reservedBytes\": %llu, \"blocks\": %llu },\n",
+										(unsigned long long)scene.GetArena().GetObjectCount(), (unsigned long long)scene.GetArena().GetUsedBytes(),
+										(unsigned long long)scene.GetArena().GetReservedBytes(), (unsigned long long)scene.GetArena().GetBlockCount());
+									fprintf(out, "      \"bvhBuildMs\": %.3f,\n", scene.GetBVHStats().buildTimeMs);
+									fprintf(out, "      \"width\": %d,\n", widths[r]);
+									fprintf(out, "      \"height\": %d,\n", heights[r]);
+									fprintf(out, "      \"traceLevel\": %d,\n", levels[l]);
+									fprintf(out, "      \"flags\": \"%s\",\n", FlagsToString(flagSets[f]).c_str());
+									fprintf(out, "      \"threads\": %d,\n", tracer->GetThreadCount());
+									fprintf(out, "      \"packetSize\": %d,\n", packetSizes[p]);
+									fprintf(out, "      \"wavefront\": %s,\n", wavefronts[w] ? "true" : "false");
+									fprintf(out, "      \"precision\": \"%s\",\n", precisions[q] == PRECISION_FLOAT ? "float" : "double");
+									if (differentPixels >= 0)
+										fprintf(out, "      \"pixelsDifferentFromDouble\": %d,\n", differentPixels);
+									fprintf(out, "      \"antiAliasing\": %d,\n", aaSamples[a]);
+									if (aaSamples[a] > 1)
+									{
+										fprintf(out, "      \"aaThreshold\": %g,\n", aaThreshold);
+										fprintf(out, "      \"antiAliasedPixels\": %llu,\n", stats.antiAliasedPixels);
+									}
+									if (uniformRays > 0)
+									{
+										fprintf(out, "      \"uniformSamples\": %d,\n", uniformSamples);
+										fprintf(out, "      \"uniformPrimaryRays\": %llu,\n", uniformRays);
+										fprintf(out, "      \"rmseFromUniform\": %.6f,\n", RMSError(image, uniform));
+									}
+									if (workers > 0)
+									{
+										int distributedDifferent = 0;
+										for (int i = 0; i < image.GetWidth() * image.GetHeight() * 3; i += 3)
+										{
+											if (memcmp(image.GetData() + i, distributed.GetData() + i, 3 * sizeof(float)))
+												distributedDifferent++;
+										}
+
+										fprintf(out, "      \"workers\": %d,\n", workersAtStart);
+										fprintf(out, "      \"distributedWallTimeMs\": %.3f,\n", bestDistributedMs);
+										fprintf(out, "      \"workersLost\": %d,\n", workersLost);
+										fprintf(out, "      \"tilesRedispatched\": %d,\n", tilesRedispatched);
+										fprintf(out, "      \"tilesTracedLocally\": %d,\n", localTiles);
+										fprintf(out, "      \"pixelsDifferentFromLocal\": %d,\n", distributedDifferent);
+									}
+									fprintf(out, "      \"progressive\": %s,\n", progressive ? "true" : "false");
+									fprintf(out, "      \"passes\": %d,\n", passes);
+									fprintf(out, "      \"repeat\": %d,\n", repeat);
+									fprintf(out, "      \"wallTimeMs\": %.3f,\n", bestMs);
+									fprintf(out, "      \"meanWallTimeMs\": %.3f,\n", totalMs / repeat);
+									fprintf(out, "      \"firstPassMs\": %.3f,\n", bestFirstPassMs);
+									fprintf(out, "      \"primaryRays\": %llu,\n", stats.primaryRays);
+									fprintf(out, "      \"shadowRays\": %llu,\n", stats.shadowRays);
+									fprintf(out, "      \"secondaryRays\": %llu,\n", stats.GetSecondaryRays());
+									fprintf(out, "      \"primaryRaysPerSec\": %.1f,\n", PerSecond(stats.primaryRays, bestMs));
+									fprintf(out, "      \"shadowRaysPerSec\": %.1f,\n", PerSecond(stats.shadowRays, bestMs));
+									fprintf(out, "      \"secondaryRaysPerSec\": %.1f,\n", PerSecond(stats.GetSecondaryRays(), bestMs));
+									fprintf(out, "      \"raysPerSec\": %.1f,\n", PerSecond(totalRays, bestMs));
+									fprintf(out, "      \"intersectionTests\": %llu,\n", stats.GetIntersectionTests());
+									fprintf(out, "      \"intersectionTestsPerRay\": %.3f,\n", totalRays > 0 ? (double)stats.GetIntersectionTests() / totalRays : 0.0);
+									fprintf(out, "      \"stats\": ");
+									stats.WriteJSON(out, "      ");
+									fprintf(out, "\n");
+									fprintf(out, "    }");
+
+									firstRun = false;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	fprintf(out, "\n  ]\n}\n");
+
+	coordinator.Shutdown();
+	for (size_t i = 0; i < workerProcesses.size(); i++)
+	{
+		WaitForWorker(workerProcesses[i]);
+	}
+
+	if (out != stdout)
+		fclose(out);
+
+	if (imageFile && lastTracer)
+	{
+		ImageWriter* writer = ImageWriter::CreateForFile(imageFile);
+
+		if (!writer || !writer->Write(imageFile, lastTracer->GetFrameBuffer()))
+		{
+			fprintf(stderr, "Cannot save %s\n", imageFile);
+			delete writer;
+			delete lastTracer;
+			return 1;
+		}
+		delete writer;
+	}
+
+	delete lastTracer;
+	return 0;
+}
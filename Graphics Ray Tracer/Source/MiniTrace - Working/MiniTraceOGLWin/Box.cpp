@@ -7,12 +7,14 @@
 * to use and extend the functionality. The code provided here is functional
 * however the author does not guarantee its performance.
 ---------------------------------------------------------------------*/
+#include <math.h>
 #include "Box.h"
 
 Box::Box()
 {
 	SetBox(Vector3(0.0, 0.0, 0.0), 1, 1, 1);
 	m_primtype = Primitive::PRIMTYPE_Box;
+	Commit();
 }
 
 
@@ -24,68 +26,147 @@ Box::Box(Vector3 position, double width, double height, double depth)
 {
 	SetBox(position, width, height, depth);
 	m_primtype = Primitive::PRIMTYPE_Box;
+	Commit();
 }
 
 void Box::SetBox(Vector3 position, double width, double height, double depth)
 {
-	double halfwidth = width*0.5;
-	double halfheight = height*0.5;
-	double halfdepth = depth*0.5;
-	
-	Vector3 tempVerts[8];
-
-	tempVerts[0].SetVector(-halfwidth + position[0], -halfheight + position[1], halfdepth + position[2]);
-	tempVerts[1].SetVector(halfwidth + position[0], -halfheight + position[1], halfdepth + position[2]);
-	tempVerts[2].SetVector(halfwidth + position[0], halfheight + position[1], halfdepth + position[2]);
-	tempVerts[3].SetVector(-halfwidth + position[0], halfheight + position[1], halfdepth + position[2]);
-	
-	tempVerts[4].SetVector(-halfwidth + position[0], -halfheight + position[1], -halfdepth + position[2]);
-	tempVerts[5].SetVector(halfwidth + position[0], -halfheight + position[1], -halfdepth + position[2]);
-	tempVerts[6].SetVector(halfwidth + position[0], halfheight + position[1], -halfdepth + position[2]);
-	tempVerts[7].SetVector(-halfwidth + position[0], halfheight + position[1], -halfdepth + position[2]);
-
-	m_triangles[0].SetTriangle(tempVerts[0], tempVerts[1], tempVerts[2]);
-	
-	m_triangles[1].SetTriangle(tempVerts[0], tempVerts[2], tempVerts[3]);
-	
-	m_triangles[2].SetTriangle(tempVerts[1], tempVerts[6], tempVerts[2]);
-	
-	m_triangles[3].SetTriangle(tempVerts[1], tempVerts[5], tempVerts[6]);
-	
-	m_triangles[4].SetTriangle(tempVerts[0], tempVerts[3], tempVerts[7]);
-	
-	m_triangles[5].SetTriangle(tempVerts[0], tempVerts[7], tempVerts[4]);
-	
-	m_triangles[6].SetTriangle(tempVerts[4], tempVerts[7], tempVerts[6]);
-	
-	m_triangles[7].SetTriangle(tempVerts[4], tempVerts[6], tempVerts[5]);
-	
-	m_triangles[8].SetTriangle(tempVerts[3], tempVerts[6], tempVerts[7]);
-	
-	m_triangles[9].SetTriangle(tempVerts[3], tempVerts[2], tempVerts[6]);
-	
-	m_triangles[10].SetTriangle(tempVerts[0], tempVerts[4], tempVerts[5]);
-	
-	m_triangles[11].SetTriangle(tempVerts[0], tempVerts[5], tempVerts[1]);
-	
+	m_centre = position;
+	m_halfSize.SetVector(width*0.5, height*0.5, depth*0.5);
+
+	m_axes[0].SetVector(1.0, 0.0, 0.0);
+	m_axes[1].SetVector(0.0, 1.0, 0.0);
+	m_axes[2].SetVector(0.0, 0.0, 1.0);
+	m_axisAligned = true;
+}
+
+void Box::SetOrientation(const Vector3& xAxis, const Vector3& yAxis)
+{
+	Vector3 x = xAxis;
+	x.Normalise();
+
+	Vector3 z = x.CrossProduct(yAxis);
+	z.Normalise();
+
+	m_axes[0] = x;
+	m_axes[1] = z.CrossProduct(x);
+	m_axes[2] = z;
+
+	m_axisAligned = m_axes[0][0] == 1.0 && m_axes[1][1] == 1.0 && m_axes[2][2] == 1.0;
+}
+
+void Box::SetAxes(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis)
+{
+	m_axes[0] = xAxis;
+	m_axes[1] = yAxis;
+	m_axes[2] = zAxis;
+
+	m_axisAligned = m_axes[0][0] == 1.0 && m_axes[1][1] == 1.0 && m_axes[2][2] == 1.0;
+}
+
+void Box::Commit()
+{
+	Vector3 extent;
+
+	for (int j = 0; j < 3; j++)
+	{
+		extent[j] = fabs(m_axes[0][j]) * m_halfSize[0]
+			+ fabs(m_axes[1][j]) * m_halfSize[1]
+			+ fabs(m_axes[2][j]) * m_halfSize[2];
+	}
+
+	m_bounds.min = m_centre - extent;
+	m_bounds.max = m_centre + extent;
+}
+
+bool Box::Translate(const Vector3& offset)
+{
+	m_centre = m_centre + offset;
+	Commit();
+	return true;
+}
+
+bool Box::GetBounds(AABB& bounds)
+{
+	bounds = m_bounds;
+	return true;
 }
 
 RayHitResult Box::IntersectByRay(Ray& ray)
 {
 	RayHitResult result = Ray::s_defaultHitResult;
 
-	for (int i = 0; i < 12; i++)
+	// Slab test: the box is the overlap of three pairs of parallel planes, one pair per axis.
+	// The ray is inside a slab between the two t values where it crosses its planes,
+	// so it is inside the box between the largest entry t and the smallest exit t.
+	// Work in the box's own frame, where every slab is axis aligned.
+	Vector3 offset = ray.GetRayStart() - m_centre;
+	Vector3 dir = ray.GetRay();
+	Vector3 localStart;
+	Vector3 localDir;
+
+	if (m_axisAligned)
+	{
+		localStart = offset;
+		localDir = dir;
+	}
+	else
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			localStart[i] = offset.DotProduct(m_axes[i]);
+			localDir[i] = dir.DotProduct(m_axes[i]);
+		}
+	}
+
+	double tNear = -FARFAR_AWAY;
+	double tFar = FARFAR_AWAY;
+	int nearAxis = -1;
+
+	for (int i = 0; i < 3; i++)
 	{
-		Primitive* prim = static_cast<Primitive*>(&m_triangles[i]);
+		if (localDir[i] == 0.0)
+		{
+			// parallel to this slab, either always inside it or never
+			if (localStart[i] < -m_halfSize[i] || localStart[i] > m_halfSize[i])
+				return result;
+			continue;
+		}
+
+		double invDir = 1.0 / localDir[i];
+		double tA = (-m_halfSize[i] - localStart[i]) * invDir;
+		double tB = (m_halfSize[i] - localStart[i]) * invDir;
+
+		if (tA > tB)
+		{
+			double swap = tA; tA = tB; tB = swap;
+		}
 
-		RayHitResult tempresult = prim->IntersectByRay(ray);
-		
-		if (tempresult.t < result.t)
+		if (tA > tNear)
 		{
-			tempresult.data = this;
-			result = tempresult;
+			tNear = tA;
+			nearAxis = i;
 		}
+
+		if (tB < tFar)
+			tFar = tB;
+
+		if (tNear > tFar)
+			return result;
 	}
 
+	// Like the triangles the box used to be built from, only faces facing the ray count,
+	// so a ray starting inside the box (e.g. a refracted ray) passes out of it without a hit.
+	if (nearAxis < 0 || tNear <= 0.0 || tNear >= FARFAR_AWAY)
+		return result;
+
+	// The face hit is on the slab the ray entered last, facing back along the ray
+	Vector3 normal = localDir[nearAxis] < 0.0 ? m_axes[nearAxis] : m_axes[nearAxis] * -1.0;
+
+	result.t = tNear;
+	result.normal = normal;
+	result.point = ray.GetRayStart() + ray.GetRay()*tNear;
+	result.data = this;
+
 	return result;
 }
@@ -10,21 +10,56 @@
 #pragma	once
 #include "Primitive.h"
 #include "Vector3.h"
-#include "Triangle.h"
 
+//A box given by its centre, half size along each of its axes and an orientation.
+//Boxes are axis aligned unless SetOrientation is called.
 class Box : public Primitive
 {
 	private:
-		Triangle m_triangles[12];
+		Vector3 m_centre;
+		Vector3 m_halfSize;		//half the width, height and depth
+		Vector3 m_axes[3];		//the box's local x, y and z axes in world space, orthonormal
+		bool m_axisAligned;
+		AABB m_bounds;			//set by Commit
 
 	public:
 		Box();
 		Box(Vector3 position, double width, double height, double depth);
 		~Box();
 
+		//Call Commit, or Scene::Commit, after changing the box
 		void SetBox(Vector3 position, double width, double height, double depth);
 
+		//Rotates the box so its width runs along xAxis and its height along (roughly) yAxis.
+		//yAxis is made perpendicular to xAxis, the depth axis is their cross product.
+		void SetOrientation(const Vector3& xAxis, const Vector3& yAxis);
+
+		//Sets the three axes as is, e.g. to copy another box exactly. They must be orthonormal.
+		void SetAxes(const Vector3& xAxis, const Vector3& yAxis, const Vector3& zAxis);
+
+		inline Vector3 GetCentre()
+		{
+			return m_centre;
+		}
+
+		inline Vector3 GetHalfSize()
+		{
+			return m_halfSize;
+		}
+
+		inline Vector3 GetAxis(int i)
+		{
+			return m_axes[i];
+		}
+
+		inline bool IsAxisAligned()
+		{
+			return m_axisAligned;
+		}
+
+		void Commit();
+		bool Translate(const Vector3& offset);
 		RayHitResult IntersectByRay(Ray& ray);
+		bool GetBounds(AABB& bounds);
 
 };
-
@@ -33,6 +33,17 @@ void Camera::InitDefaultCamera()
 	m_viewCentre = m_position + m_viewVector*m_focalLength;
 }
 
+void Camera::SetFrame(const Vector3& pos, const Vector3& view, const Vector3& up, const Vector3& right, double focalLength)
+{
+	m_position = pos;
+	m_viewVector = view;
+	m_upVector = up;
+	m_rightVector = right;
+	m_focalLength = focalLength;
+
+	m_viewCentre = m_position + m_viewVector*m_focalLength;
+}
+
 void Camera::SetPositionAndLookAt( const Vector3& pos, const Vector3& lookat)
 {
 	m_position = pos;
@@ -29,33 +29,37 @@ class Camera
 		void InitDefaultCamera();
 
 		void SetPositionAndLookAt( const Vector3& pos, const Vector3& lookat);
+
+		//Sets every vector as is, e.g. to copy another camera exactly.
+		//view, up and right must be orthonormal.
+		void SetFrame(const Vector3& pos, const Vector3& view, const Vector3& up, const Vector3& right, double focalLength);
 		
-		inline Vector3		GetPosition() 
+		inline Vector3		GetPosition() const
 		{
 			return m_position;
 		}
 
-		inline Vector3		GetUpVector() 
+		inline Vector3		GetUpVector() const
 		{
 			return m_upVector;
 		}
 
-		inline Vector3		GetRightVector() 
+		inline Vector3		GetRightVector() const
 		{
 			return m_rightVector;
 		}
 
-		inline Vector3		GetViewVector() 
+		inline Vector3		GetViewVector() const
 		{
 			return m_viewVector;
 		}
 
-		inline Vector3		GetViewCentre() 
+		inline Vector3		GetViewCentre() const
 		{
 			return m_viewCentre;
 		}
 
-		inline double		GetFocalLength() 
+		inline double		GetFocalLength() const
 		{
 			return m_focalLength;
 		}
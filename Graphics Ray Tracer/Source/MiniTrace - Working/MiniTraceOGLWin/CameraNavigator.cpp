@@ -0,0 +1,95 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <math.h>
+#include <algorithm>
+
+#include "CameraNavigator.h"
+
+CameraNavigator::CameraNavigator()
+{
+	m_mode = NAVIGATE_ORBIT;
+	m_dragging = false;
+	m_startX = m_startY = 0;
+	m_radius = NAVIGATOR_PIVOT_DISTANCE;
+	m_startYaw = m_startPitch = 0.0;
+	m_panScale = 0.0;
+}
+
+void CameraNavigator::Begin(Scene* pScene, const RayTracer& tracer, int x, int y, Mode mode)
+{
+	Camera* cam = pScene->GetSceneCamera();
+
+	m_mode = mode;
+	m_dragging = true;
+	m_startX = x;
+	m_startY = y;
+	m_startPosition = cam->GetPosition();
+	m_startView = cam->GetViewVector();
+
+	Vector3 view = m_startView;
+	view.Normalise();
+
+	//pivot on whatever is in the middle of the image
+	Vector3 point;
+	double distance = NAVIGATOR_PIVOT_DISTANCE;
+
+	if (tracer.GetPixelPoint(tracer.GetWidth() / 2, tracer.GetHeight() / 2, point))
+	{
+		double depth = (point - m_startPosition).DotProduct(view);
+		if (depth > 0.0 && depth < NAVIGATOR_MAX_DISTANCE)
+			distance = depth;
+	}
+
+	m_pivot = m_startPosition + view * distance;
+
+	Vector3 offset = m_startPosition - m_pivot;
+	m_radius = offset.Norm();
+	m_startYaw = atan2(offset[0], offset[2]);
+	m_startPitch = asin(std::min(std::max(offset[1] / m_radius, -1.0), 1.0));
+	m_startPitch = std::min(std::max(m_startPitch, -NAVIGATOR_MAX_PITCH), NAVIGATOR_MAX_PITCH);
+
+	m_panRight = cam->GetRightVector();
+	m_panRight.Normalise();
+	m_panUp = cam->GetUpVector();
+	m_panUp.Normalise();
+	m_panScale = tracer.GetPixelSize(pScene, distance);
+}
+
+bool CameraNavigator::Drag(Scene* pScene, int x, int y)
+{
+	if (!m_dragging)
+		return false;
+
+	int dx = x - m_startX;
+	int dy = y - m_startY;
+	Camera* cam = pScene->GetSceneCamera();
+
+	if (m_mode == NAVIGATE_PAN)
+	{
+		//the scene follows the mouse, so the camera goes the other way; window y is down
+		Vector3 move = m_panRight * (-dx * m_panScale) + m_panUp * (dy * m_panScale);
+		Vector3 position = m_startPosition + move;
+		cam->SetPositionAndLookAt(position, position + m_startView);
+		return true;
+	}
+
+	double yaw = m_startYaw - dx * NAVIGATOR_ORBIT_SPEED;
+	double pitch = m_startPitch + dy * NAVIGATOR_ORBIT_SPEED;
+	pitch = std::min(std::max(pitch, -NAVIGATOR_MAX_PITCH), NAVIGATOR_MAX_PITCH);
+
+	Orbit(*cam, m_pivot, m_radius, yaw, pitch);
+	return true;
+}
+
+void CameraNavigator::Orbit(Camera& camera, const Vector3& pivot, double radius, double yaw, double pitch)
+{
+	Vector3 offset(cos(pitch) * sin(yaw), sin(pitch), cos(pitch) * cos(yaw));
+	camera.SetPositionAndLookAt(pivot + offset * radius, pivot);
+}
@@ -0,0 +1,77 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include "Camera.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "Vector3.h"
+
+#define NAVIGATOR_ORBIT_SPEED		0.01	//radians the camera turns per pixel dragged
+#define NAVIGATOR_MAX_PITCH			1.5		//radians above or below the pivot, short of straight up or down
+#define NAVIGATOR_PIVOT_DISTANCE	10.0	//of the pivot in front of the camera when nothing is under the centre
+#define NAVIGATOR_MAX_DISTANCE		1000.0	//a pivot further than this is taken as nothing under the centre
+
+//Turns mouse drags in a viewer into camera moves. An orbit drag turns the camera round a
+//pivot, left and right about the vertical and up and down short of the poles, keeping it
+//looking at the pivot. A pan drag slides the camera across its view so the point under the
+//mouse follows it. The pivot is what the ray through the centre of the image hit, if the
+//tracer recorded it (RayTracer::SetReprojection), otherwise a point ahead of the camera.
+//
+//Positions are window pixels, y down. Each Drag sets the camera from where it was at Begin,
+//so a drag does not drift however many moves it takes.
+class CameraNavigator
+{
+	public:
+		enum Mode
+		{
+			NAVIGATE_ORBIT = 0,
+			NAVIGATE_PAN,
+		};
+
+	private:
+		Mode		m_mode;
+		bool		m_dragging;
+		int			m_startX;
+		int			m_startY;
+
+		Vector3		m_startPosition;
+		Vector3		m_startView;
+		Vector3		m_pivot;
+		double		m_radius;			//of the orbit
+		double		m_startYaw;
+		double		m_startPitch;
+		Vector3		m_panRight;			//unit vectors of the view at Begin
+		Vector3		m_panUp;
+		double		m_panScale;			//world units per pixel at the pivot
+
+	public:
+		CameraNavigator();
+
+		//Starts a drag at (x, y) with the camera of scene as it is
+		void	Begin(Scene* pScene, const RayTracer& tracer, int x, int y, Mode mode);
+
+		//Moves the camera for the mouse at (x, y), returns true if it moved
+		bool	Drag(Scene* pScene, int x, int y);
+
+		inline void End()
+		{
+			m_dragging = false;
+		}
+
+		inline bool IsDragging() const
+		{
+			return m_dragging;
+		}
+
+		//Places the camera at yaw and pitch, in radians, and radius from pivot, looking at it.
+		//A yaw of 0 is on the +z side of the pivot, a positive pitch is above it.
+		static void Orbit(Camera& camera, const Vector3& pivot, double radius, double yaw, double pitch);
+};
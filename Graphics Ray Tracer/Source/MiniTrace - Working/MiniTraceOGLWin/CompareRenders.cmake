@@ -0,0 +1,73 @@
+#
+# Test script for ctest: renders with minitrace_bench and fails if any pixel differs
+#
+# Run with cmake -P and these variables:
+#   BENCH     the minitrace_bench executable
+#   WORK_DIR  where the images and the scene copy go
+#   NAME      name of the test, the images are saved as NAME_first.pfm and NAME_second.pfm
+#   FIRST     options of the first render, separated by spaces
+#   SECOND    options of the second render; without it only the report of the first is checked
+#   SCENE     optional text scene, copied to WORK_DIR without its cache and rendered by both,
+#             so the first render loads the text and writes the cache and the second loads that
+#
+# Every render also fails the test if it reports pixels that differ from the local image.
+#
+
+IF(NOT BENCH OR NOT WORK_DIR OR NOT NAME)
+	MESSAGE(FATAL_ERROR "BENCH, WORK_DIR and NAME must be set")
+ENDIF()
+
+FILE(MAKE_DIRECTORY ${WORK_DIR})
+
+SET(SCENE_OPTION)
+
+IF(SCENE)
+	GET_FILENAME_COMPONENT(SCENE_FILE ${SCENE} NAME)
+	SET(SCENE_COPY ${WORK_DIR}/${NAME}_${SCENE_FILE})
+
+	FILE(REMOVE ${SCENE_COPY} ${SCENE_COPY}.cache)
+	CONFIGURE_FILE(${SCENE} ${SCENE_COPY} COPYONLY)
+	SET(SCENE_OPTION --scene file:${SCENE_COPY})
+ENDIF()
+
+FUNCTION(RENDER OPTIONS IMAGE)
+	SEPARATE_ARGUMENTS(OPTION_LIST UNIX_COMMAND "${OPTIONS}")
+	FILE(REMOVE ${IMAGE})
+
+	EXECUTE_PROCESS(
+		COMMAND ${BENCH} --repeat 1 --precision double ${SCENE_OPTION} ${OPTION_LIST} --image ${IMAGE}
+		RESULT_VARIABLE RESULT
+		OUTPUT_VARIABLE REPORT
+		ERROR_VARIABLE ERRORS
+		)
+
+	IF(NOT RESULT EQUAL 0)
+		MESSAGE(FATAL_ERROR "minitrace_bench ${OPTIONS} failed (${RESULT}):\n${ERRORS}")
+	ENDIF()
+
+	IF(REPORT MATCHES "\"pixelsDifferentFromLocal\": [1-9]")
+		MESSAGE(FATAL_ERROR "minitrace_bench ${OPTIONS} differs from the local image:\n${REPORT}")
+	ENDIF()
+ENDFUNCTION()
+
+SET(FIRST_IMAGE ${WORK_DIR}/${NAME}_first.pfm)
+SET(SECOND_IMAGE ${WORK_DIR}/${NAME}_second.pfm)
+
+RENDER("${FIRST}" ${FIRST_IMAGE})
+
+IF(SCENE AND NOT EXISTS ${SCENE_COPY}.cache)
+	MESSAGE(FATAL_ERROR "loading ${SCENE_COPY} did not write its cache")
+ENDIF()
+
+IF(DEFINED SECOND)
+	RENDER("${SECOND}" ${SECOND_IMAGE})
+
+	EXECUTE_PROCESS(
+		COMMAND ${CMAKE_COMMAND} -E compare_files ${FIRST_IMAGE} ${SECOND_IMAGE}
+		RESULT_VARIABLE DIFFERENT
+		)
+
+	IF(DIFFERENT)
+		MESSAGE(FATAL_ERROR "the images of \"${FIRST}\" and \"${SECOND}\" differ: ${FIRST_IMAGE} ${SECOND_IMAGE}")
+	ENDIF()
+ENDIF()
@@ -0,0 +1,64 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stddef.h>
+
+#include "FrameBuffer.h"
+
+FrameBuffer::FrameBuffer()
+{
+	m_width = m_height = 0;
+}
+
+FrameBuffer::FrameBuffer(int width, int height)
+{
+	m_width = m_height = 0;
+	Resize(width, height);
+}
+
+FrameBuffer::~FrameBuffer()
+{
+}
+
+void FrameBuffer::Resize(int width, int height)
+{
+	m_width = width > 0 ? width : 0;
+	m_height = height > 0 ? height : 0;
+	m_pixels.resize(m_width*m_height * 3);
+}
+
+void FrameBuffer::Clear(const Colour& colour)
+{
+	for (size_t i = 0; i < m_pixels.size(); i += 3)
+	{
+		m_pixels[i] = colour.red;
+		m_pixels[i + 1] = colour.green;
+		m_pixels[i + 2] = colour.blue;
+	}
+}
+
+void FrameBuffer::FillBlocks(int step)
+{
+	for (int y = 0; y < m_height; y++)
+	{
+		const float* source = &m_pixels[(y - y % step) * m_width * 3];
+		float* row = &m_pixels[y * m_width * 3];
+
+		for (int x = 0; x < m_width; x++)
+		{
+			if (x % step == 0 && y % step == 0)
+				continue;
+
+			const float* pixel = source + (x - x % step) * 3;
+			row[x * 3] = pixel[0];
+			row[x * 3 + 1] = pixel[1];
+			row[x * 3 + 2] = pixel[2];
+		}
+	}
+}
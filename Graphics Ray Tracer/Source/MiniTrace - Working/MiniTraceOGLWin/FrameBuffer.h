@@ -0,0 +1,68 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <vector>
+
+#include "Material.h"
+
+//An in-memory float RGB image the ray tracer renders into.
+//Rows are stored bottom row first, the same layout glDrawPixels expects.
+class FrameBuffer
+{
+	private:
+		int					m_width;
+		int					m_height;
+		std::vector<float>	m_pixels;		//3 floats per pixel, interleaved r g b
+
+	public:
+		FrameBuffer();
+		FrameBuffer(int width, int height);
+		~FrameBuffer();
+
+		void Resize(int width, int height);
+		void Clear(const Colour& colour);
+		//Copies the bottom left pixel of every step x step block over the rest of the block
+		void FillBlocks(int step);
+
+		inline int GetWidth() const
+		{
+			return m_width;
+		}
+
+		inline int GetHeight() const
+		{
+			return m_height;
+		}
+
+		//x counts from the left, y from the bottom row
+		inline void SetPixel(int x, int y, const Colour& colour)
+		{
+			float* pixel = &m_pixels[(y*m_width + x) * 3];
+			pixel[0] = colour.red;
+			pixel[1] = colour.green;
+			pixel[2] = colour.blue;
+		}
+
+		inline Colour GetPixel(int x, int y) const
+		{
+			const float* pixel = &m_pixels[(y*m_width + x) * 3];
+			Colour colour;
+			colour.red = pixel[0];
+			colour.green = pixel[1];
+			colour.blue = pixel[2];
+			return colour;
+		}
+
+		inline const float* GetData() const
+		{
+			return m_pixels.empty() ? nullptr : &m_pixels[0];
+		}
+};
@@ -0,0 +1,116 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include "AABB.h"
+#include "Vector3.h"
+
+//The space a bundle of rays can reach: the rays from one start through a quad (a perspective
+//frustum), or along one direction from the points of a quad (a parallel one, a box open at
+//both ends). It is bounded by the four planes through the sides of the quad. What is outside
+//any of them cannot be hit by a ray of the bundle. The quad is taken as given, so it should
+//be made a little larger than the rays it is for to leave room for rounding.
+struct Frustum
+{
+	bool		parallel;
+	Vector3		start;			//of every ray, perspective only
+	Vector3		direction;		//of every ray, parallel only
+	Vector3		corners[4];		//of the quad, in order round it
+	Vector3		normals[4];		//of the side planes, pointing in
+	double		offsets[4];		//the d of the plane equations
+
+	//Perspective frustum of the rays from start through the quad
+	inline void SetPerspective(const Vector3& rayStart, const Vector3 quad[4])
+	{
+		parallel = false;
+		start = rayStart;
+		SetSides(quad);
+	}
+
+	//Parallel frustum of the rays along dir from the points of the quad
+	inline void SetParallel(const Vector3& dir, const Vector3 quad[4])
+	{
+		parallel = true;
+		direction = dir;
+		SetSides(quad);
+	}
+
+	//True if no point of the box is inside, false may still be a box that is not
+	inline bool Outside(const AABB& box) const
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			//the corner of the box furthest along the normal
+			Vector3 furthest(
+				normals[i][0] >= 0.0 ? box.max[0] : box.min[0],
+				normals[i][1] >= 0.0 ? box.max[1] : box.min[1],
+				normals[i][2] >= 0.0 ? box.max[2] : box.min[2]);
+
+			if (normals[i].DotProduct(furthest) + offsets[i] < 0.0)
+				return true;
+		}
+		return false;
+	}
+
+	//True if no ray can hit the front of the plane n.p + d = 0, as Plane is hit
+	inline bool MissesPlane(const Vector3& n, double d) const
+	{
+		if (parallel)
+		{
+			//the rays go away from the plane or every one starts behind it
+			if (!(direction.DotProduct(n) < 0.0))
+				return true;
+
+			for (int i = 0; i < 4; i++)
+			{
+				if (corners[i].DotProduct(n) + d > 0.0)
+					return false;
+			}
+			return true;
+		}
+
+		if (!(start.DotProduct(n) + d > 0.0))
+			return true;
+
+		//every direction is a blend of the corner ones, if none comes towards the plane neither do they
+		for (int i = 0; i < 4; i++)
+		{
+			if ((corners[i] - start).DotProduct(n) < 0.0)
+				return false;
+		}
+		return true;
+	}
+
+	private:
+		inline void SetSides(const Vector3 quad[4])
+		{
+			Vector3 centre = (quad[0] + quad[1] + quad[2] + quad[3]) * 0.25;
+
+			for (int i = 0; i < 4; i++)
+			{
+				corners[i] = quad[i];
+			}
+
+			for (int i = 0; i < 4; i++)
+			{
+				const Vector3& a = quad[i];
+				const Vector3& b = quad[(i + 1) % 4];
+				Vector3 n = parallel ? direction.CrossProduct(b - a) : (a - start).CrossProduct(b - start);
+
+				//the quad may go round either way, the centre is inside
+				Vector3 inside = parallel ? centre - a : centre - start;
+				if (n.DotProduct(inside) < 0.0)
+					n = n * -1.0;
+
+				normals[i] = n;
+				offsets[i] = -n.DotProduct(parallel ? a : start);
+			}
+		}
+};
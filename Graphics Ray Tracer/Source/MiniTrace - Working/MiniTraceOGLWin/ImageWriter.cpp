@@ -0,0 +1,244 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "ImageWriter.h"
+
+//Converts a colour channel to 8 bits, clamping it to [0, 1] first
+static unsigned char ToByte(float value)
+{
+	if (value <= 0.0f)
+		return 0;
+	if (value >= 1.0f)
+		return 255;
+	return (unsigned char)(value * 255.0f + 0.5f);
+}
+
+//Gathers the image as 8 bit RGB, top row first as most file formats want it
+static void GetRowsTopDown(const FrameBuffer& image, std::vector<unsigned char>& rgb)
+{
+	int width = image.GetWidth();
+	int height = image.GetHeight();
+	const float* data = image.GetData();
+
+	rgb.resize(width*height * 3);
+
+	for (int y = 0; y < height; y++)
+	{
+		const float* src = data + (height - 1 - y)*width * 3;
+		unsigned char* dst = &rgb[y*width * 3];
+
+		for (int i = 0; i < width * 3; i++)
+		{
+			dst[i] = ToByte(src[i]);
+		}
+	}
+}
+
+static bool HasExtension(const char* filename, const char* ext)
+{
+	size_t nameLen = strlen(filename);
+	size_t extLen = strlen(ext);
+
+	if (nameLen < extLen)
+		return false;
+
+	const char* tail = filename + nameLen - extLen;
+	for (size_t i = 0; i < extLen; i++)
+	{
+		char c = tail[i];
+		if (c >= 'A' && c <= 'Z')
+			c = c - 'A' + 'a';
+		if (c != ext[i])
+			return false;
+	}
+	return true;
+}
+
+ImageWriter* ImageWriter::CreateForFile(const char* filename)
+{
+	if (HasExtension(filename, ".ppm"))
+		return new PPMWriter();
+	if (HasExtension(filename, ".pfm"))
+		return new PFMWriter();
+	if (HasExtension(filename, ".png"))
+		return new PNGWriter();
+
+	return nullptr;
+}
+
+bool PPMWriter::Write(const char* filename, const FrameBuffer& image)
+{
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> rgb;
+	GetRowsTopDown(image, rgb);
+
+	fprintf(file, "P6\n%d %d\n255\n", image.GetWidth(), image.GetHeight());
+	bool ok = rgb.empty() || fwrite(&rgb[0], 1, rgb.size(), file) == rgb.size();
+
+	return fclose(file) == 0 && ok;
+}
+
+bool PFMWriter::Write(const char* filename, const FrameBuffer& image)
+{
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	//PFM stores the bottom row first, just like the framebuffer,
+	//and a negative scale marks the floats as little endian
+	size_t count = image.GetWidth()*image.GetHeight() * 3;
+	bool ok = true;
+
+	fprintf(file, "PF\n%d %d\n-1.0\n", image.GetWidth(), image.GetHeight());
+
+	const unsigned int probe = 1;
+	if (*(const unsigned char*)&probe == 1)
+	{
+		ok = count == 0 || fwrite(image.GetData(), sizeof(float), count, file) == count;
+	}
+	else
+	{
+		const unsigned char* bytes = (const unsigned char*)image.GetData();
+		for (size_t i = 0; i < count && ok; i++)
+		{
+			unsigned char swapped[4] = { bytes[i * 4 + 3], bytes[i * 4 + 2], bytes[i * 4 + 1], bytes[i * 4] };
+			ok = fwrite(swapped, 1, 4, file) == 4;
+		}
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+struct CrcTable
+{
+	unsigned int entries[256];
+
+	CrcTable()
+	{
+		for (unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static unsigned int Crc32(unsigned int crc, const unsigned char* data, size_t length)
+{
+	static const CrcTable table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void PutBigEndian(std::vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back((value >> 24) & 0xff);
+	out.push_back((value >> 16) & 0xff);
+	out.push_back((value >> 8) & 0xff);
+	out.push_back(value & 0xff);
+}
+
+static bool WriteChunk(FILE* file, const char* type, const std::vector<unsigned char>& payload)
+{
+	std::vector<unsigned char> chunk;
+
+	PutBigEndian(chunk, (unsigned int)payload.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), payload.begin(), payload.end());
+	PutBigEndian(chunk, Crc32(0, &chunk[4], chunk.size() - 4));
+
+	return fwrite(&chunk[0], 1, chunk.size(), file) == chunk.size();
+}
+
+bool PNGWriter::Write(const char* filename, const FrameBuffer& image)
+{
+	int width = image.GetWidth();
+	int height = image.GetHeight();
+
+	if (width == 0 || height == 0)
+		return false;
+
+	FILE* file = fopen(filename, "wb");
+	if (!file)
+		return false;
+
+	std::vector<unsigned char> rgb;
+	GetRowsTopDown(image, rgb);
+
+	//every scanline starts with filter type 0 (none)
+	std::vector<unsigned char> raw;
+	raw.reserve(height*(width * 3 + 1));
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgb.begin() + y*width * 3, rgb.begin() + (y + 1)*width * 3);
+	}
+
+	//zlib stream made of stored deflate blocks, each at most 65535 bytes
+	std::vector<unsigned char> idat;
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+
+	unsigned int adlerA = 1, adlerB = 0;
+	size_t offset = 0;
+	do
+	{
+		size_t blockLen = raw.size() - offset;
+		if (blockLen > 65535)
+			blockLen = 65535;
+		bool last = offset + blockLen == raw.size();
+
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(blockLen & 0xff);
+		idat.push_back((blockLen >> 8) & 0xff);
+		idat.push_back(~blockLen & 0xff);
+		idat.push_back((~blockLen >> 8) & 0xff);
+
+		for (size_t i = offset; i < offset + blockLen; i++)
+		{
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+
+		idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + blockLen);
+		offset += blockLen;
+	} while (offset < raw.size());
+
+	PutBigEndian(idat, (adlerB << 16) | adlerA);
+
+	std::vector<unsigned char> ihdr;
+	PutBigEndian(ihdr, width);
+	PutBigEndian(ihdr, height);
+	ihdr.push_back(8);		//bit depth
+	ihdr.push_back(2);		//colour type, RGB
+	ihdr.push_back(0);		//compression
+	ihdr.push_back(0);		//filter
+	ihdr.push_back(0);		//no interlace
+
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	bool ok = fwrite(signature, 1, 8, file) == 8
+		&& WriteChunk(file, "IHDR", ihdr)
+		&& WriteChunk(file, "IDAT", idat)
+		&& WriteChunk(file, "IEND", std::vector<unsigned char>());
+
+	return fclose(file) == 0 && ok;
+}
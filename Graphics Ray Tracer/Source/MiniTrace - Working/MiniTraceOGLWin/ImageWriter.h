@@ -0,0 +1,47 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include "FrameBuffer.h"
+
+//Saves a FrameBuffer to disk in some image format
+class ImageWriter
+{
+	public:
+		virtual				~ImageWriter(){ ; }
+
+		//returns false if the file could not be written
+		virtual bool		Write(const char* filename, const FrameBuffer& image) = 0;
+
+		//Picks a writer from the file extension (.ppm, .pfm or .png).
+		//Returns nullptr for an unknown extension, otherwise the caller deletes the writer.
+		static ImageWriter*	CreateForFile(const char* filename);
+};
+
+//binary 8 bit PPM (P6)
+class PPMWriter : public ImageWriter
+{
+	public:
+		bool				Write(const char* filename, const FrameBuffer& image);
+};
+
+//PFM, 32 bit float RGB with no clamping, useful for comparing renders exactly
+class PFMWriter : public ImageWriter
+{
+	public:
+		bool				Write(const char* filename, const FrameBuffer& image);
+};
+
+//8 bit RGB PNG, written with uncompressed deflate blocks so no zlib is needed
+class PNGWriter : public ImageWriter
+{
+	public:
+		bool				Write(const char* filename, const FrameBuffer& image);
+};
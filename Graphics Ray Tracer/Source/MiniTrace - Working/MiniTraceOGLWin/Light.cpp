@@ -25,6 +25,7 @@ void Light::InitDefaultLight()
 	//set default position and colour for a light
 	SetLightColour(1.0, 1.0, 1.0);
 	SetLightPosition(0.0, 20.0, 0.0);
+	m_radius = 0.0;
 }
 
 void Light::SetLightColour(double r, double g, double b)
@@ -17,6 +17,7 @@ class Light
 	private:
 		Vector3			m_position;
 		Colour			m_colour;
+		double			m_radius;			//of the sphere the light reaches, 0 for everywhere
 
 	public:
 		Light();
@@ -26,11 +27,34 @@ class Light
 		void SetLightPosition(double x, double y, double z);
 		void SetLightColour(double r, double g, double b);
 
-		inline Vector3 GetLightPosition()
+		//Limits the light to a sphere round it. Inside, its light fades smoothly to nothing at
+		//the edge, so shading can leave it out beyond (see LightTree). 0, the default, lets the
+		//light reach everywhere at full strength. Commit the scene's lights after changing it.
+		inline void SetRadius(double radius)
+		{
+			m_radius = radius > 0.0 ? radius : 0.0;
+		}
+
+		inline double GetRadius() const
+		{
+			return m_radius;
+		}
+
+		//How much of the light reaches the point, from 1 at the light to 0 at its radius
+		inline double GetInfluence(const Vector3& point) const
+		{
+			if (m_radius <= 0.0)
+				return 1.0;
+
+			double x = (point - m_position).Norm_Sqr() / (m_radius * m_radius);
+			return x < 1.0 ? (1.0 - x) * (1.0 - x) : 0.0;
+		}
+
+		inline Vector3 GetLightPosition() const
 		{
 			return m_position;
 		}
-		inline Colour GetLightColour()
+		inline Colour GetLightColour() const
 		{
 			return m_colour;
 		}
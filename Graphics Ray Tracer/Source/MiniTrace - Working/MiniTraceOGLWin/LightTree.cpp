@@ -0,0 +1,192 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <algorithm>
+
+#include "LightTree.h"
+
+//Orders lights most important first, ties go to the lower light index
+static inline bool MoreImportant(const SelectedLight& a, const SelectedLight& b)
+{
+	return a.weight > b.weight || (a.weight == b.weight && a.index < b.index);
+}
+
+LightTree::LightTree()
+{
+	m_lightCount = 0;
+}
+
+double LightTree::Brightness(const Light* light)
+{
+	Colour colour = light->GetLightColour();
+	return 0.2126 * colour.red + 0.7152 * colour.green + 0.0722 * colour.blue;
+}
+
+void LightTree::Build(const std::vector<Light*>& lights)
+{
+	Clear();
+
+	std::vector<AABB> bounds;
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		double radius = lights[i]->GetRadius();
+
+		if (radius <= 0.0)
+		{
+			m_unbounded.push_back((int)i);
+			continue;
+		}
+
+		Vector3 position = lights[i]->GetLightPosition();
+		Vector3 extent(radius, radius, radius);
+
+		m_bounded.push_back((int)i);
+		bounds.push_back(AABB(position - extent, position + extent));
+	}
+
+	//brightest first, so the search can stop at the first that cannot make the budget
+	std::stable_sort(m_unbounded.begin(), m_unbounded.end(), [&lights](int a, int b)
+	{
+		return Brightness(lights[a]) > Brightness(lights[b]);
+	});
+
+	if (!bounds.empty())
+	{
+		m_bvh.Build(bounds);
+
+		//children come after their parent, so going backwards they are done before it
+		const std::vector<BVH::Node>& nodes = m_bvh.GetNodes();
+		const std::vector<int>& items = m_bvh.GetItems();
+		m_nodeBrightness.assign(nodes.size(), 0.0);
+
+		for (int i = (int)nodes.size() - 1; i >= 0; i--)
+		{
+			const BVH::Node& node = nodes[i];
+
+			if (node.count > 0)
+			{
+				for (int j = node.first; j < node.first + node.count; j++)
+				{
+					m_nodeBrightness[i] = std::max(m_nodeBrightness[i], Brightness(lights[m_bounded[items[j]]]));
+				}
+			}
+			else
+			{
+				m_nodeBrightness[i] = std::max(m_nodeBrightness[node.first], m_nodeBrightness[node.first + 1]);
+			}
+		}
+	}
+
+	m_lightCount = lights.size();
+}
+
+void LightTree::Clear()
+{
+	m_bvh.Clear();
+	m_bounded.clear();
+	m_nodeBrightness.clear();
+	m_unbounded.clear();
+	m_lightCount = 0;
+}
+
+void LightTree::Select(const std::vector<Light*>& lights, const Vector3& point, int budget, LightSelection& selection) const
+{
+	//with a budget, a heap with the least important of the lights kept on top
+	std::vector<SelectedLight>& kept = selection.lights;
+	bool limited = budget > 0;
+
+	kept.clear();
+	selection.reaching = 0;
+
+	//true if a light of the given weight would be kept
+	auto wouldKeep = [&](double weight, int light) -> bool
+	{
+		SelectedLight candidate = { lights[light], light, 0.0, weight };
+		return !limited || (int)kept.size() < budget || MoreImportant(candidate, kept[0]);
+	};
+
+	auto consider = [&](int light, double brightness)
+	{
+		double influence = lights[light]->GetInfluence(point);
+		if (influence <= 0.0)
+			return;
+
+		selection.reaching++;
+
+		SelectedLight candidate = { lights[light], light, influence, brightness * influence };
+
+		if (!limited)
+		{
+			kept.push_back(candidate);
+		}
+		else if ((int)kept.size() < budget)
+		{
+			kept.push_back(candidate);
+			std::push_heap(kept.begin(), kept.end(), MoreImportant);
+		}
+		else if (MoreImportant(candidate, kept[0]))
+		{
+			std::pop_heap(kept.begin(), kept.end(), MoreImportant);
+			kept.back() = candidate;
+			std::push_heap(kept.begin(), kept.end(), MoreImportant);
+		}
+	};
+
+	//without a budget or lights with a radius, every light is looked at in order anyway
+	bool linear = lights.size() != m_lightCount || (!limited && m_bounded.empty());
+
+	if (linear)
+	{
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			consider((int)i, Brightness(lights[i]));
+		}
+	}
+	else
+	{
+		//they reach everywhere at full strength, once one is left out so are the dimmer ones after it
+		for (size_t i = 0; i < m_unbounded.size(); i++)
+		{
+			double brightness = Brightness(lights[m_unbounded[i]]);
+			if (!wouldKeep(brightness, m_unbounded[i]))
+				break;
+
+			consider(m_unbounded[i], brightness);
+		}
+
+		//a light's weight is never more than its brightness, so a node can be skipped if its
+		//brightest light could not be kept even at full strength; ties may still win on index
+		const std::vector<BVH::Node>& nodes = m_bvh.GetNodes();
+
+		auto enter = [&](int node) -> bool
+		{
+			return nodes[node].bounds.Contains(point)
+				&& (!limited || (int)kept.size() < budget || m_nodeBrightness[node] >= kept[0].weight);
+		};
+
+		auto visit = [&](int item)
+		{
+			int light = m_bounded[item];
+			consider(light, Brightness(lights[light]));
+		};
+
+		m_bvh.Query(enter, visit);
+	}
+
+	//shade in the order of the light list, as if every light had been looked at;
+	//lights looked at in order and all kept already are
+	if (limited || !linear)
+	{
+		std::sort(kept.begin(), kept.end(), [](const SelectedLight& a, const SelectedLight& b)
+		{
+			return a.index < b.index;
+		});
+	}
+}
@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <vector>
+
+#include "BVH.h"
+#include "Light.h"
+
+//A light chosen to shade a point
+struct SelectedLight
+{
+	Light*		light;
+	int			index;			//in the scene's light list
+	double		influence;		//Light::GetInfluence at the point
+	double		weight;			//how much it matters there, its brightness times the influence
+};
+
+//The lights chosen to shade a point, in the order of the scene's light list. Keep one for
+//many points where possible, Select reuses the memory of the list.
+struct LightSelection
+{
+	std::vector<SelectedLight>	lights;
+	int							reaching;		//lights found to reach the point, see LightTree
+};
+
+//Finds the lights that shade a point without looking at every light of the scene.
+//
+//Lights with a radius go in a BVH over the boxes round their spheres, so only the few
+//whose sphere holds the point are visited; lights without one reach everywhere. Without a
+//budget every light that reaches the point shades it. With one, if more lights reach the
+//point than the budget, the most important are kept: the brightest once faded by their
+//distance. Each point is then shaded by at most budget lights whatever their number in the
+//scene. Once the budget is full the search skips what cannot beat the lights kept: the rest
+//of the lights without a radius, which are sorted by brightness, and the nodes whose
+//brightest light is dimmer. The lights skipped are not counted as reaching.
+//
+//The choice depends only on the point, so the image does not depend on the thread count
+//or the order points are shaded in.
+class LightTree
+{
+	private:
+		BVH					m_bvh;				//over the lights with a radius
+		std::vector<int>	m_bounded;			//light index of each BVH item
+		std::vector<double>	m_nodeBrightness;	//of the brightest light under each BVH node
+		std::vector<int>	m_unbounded;		//indices of the lights that reach everywhere, brightest first
+		size_t				m_lightCount;		//lights in the list the tree was built over
+
+	public:
+		LightTree();
+
+		//What the importance of a light is based on, the luminance of its colour
+		static double Brightness(const Light* light);
+
+		//Builds the tree over the lights as they are now. Build it again after lights move, change
+		//colour or radius or are added.
+		void	Build(const std::vector<Light*>& lights);
+		void	Clear();
+
+		//Chooses up to budget lights for the point, every light that reaches it if budget is 0
+		//or less. lights must be the list the tree was built over; if it has changed size
+		//since, every light is treated as one that may reach the point, which is correct but slow.
+		void	Select(const std::vector<Light*>& lights, const Vector3& point, int budget, LightSelection& selection) const;
+
+		inline const BVH::BuildStats& GetBuildStats() const
+		{
+			return m_bvh.GetBuildStats();
+		}
+};
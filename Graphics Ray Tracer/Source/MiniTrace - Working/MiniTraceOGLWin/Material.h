@@ -41,27 +41,27 @@ class Material
 			m_castShadow = castShadow;
 		}
 
-		inline Colour GetAmbientColour()
+		inline Colour GetAmbientColour() const
 		{
 			return m_ambient;
 		}
 		
-		inline Colour GetDiffuseColour()
+		inline Colour GetDiffuseColour() const
 		{
 			return m_diffuse;
 		}
 
-		inline Colour GetSpecularColour()
+		inline Colour GetSpecularColour() const
 		{
 			return m_specular;
 		}
 
-		inline double GetSpecPower()
+		inline double GetSpecPower() const
 		{
 			return m_specpower;
 		}
 
-		inline bool CastShadow()
+		inline bool CastShadow() const
 		{
 			return m_castShadow;
 		}
@@ -34,6 +34,7 @@ void PrintUsage()
 	printf("F5: Full lighting  refraction\n");
 	printf("F6: Ray trace everything (default)\n");
 	printf("F7: Switch between perspective projection and orthographic projection\n");
+	printf("F8: Save the image to MiniTrace.png\n");
 }
 
 int APIENTRY WinMain(HINSTANCE hInstance,
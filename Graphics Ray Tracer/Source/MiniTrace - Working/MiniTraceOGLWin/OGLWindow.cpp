@@ -9,6 +9,7 @@
 ---------------------------------------------------------------------*/
 #include "OGLWindow.h"
 #include "Resource.h"
+#include "ImageWriter.h"
 #include <gl/GL.h>
 
 
@@ -129,6 +130,10 @@ BOOL OGLWindow::InitWindow(HINSTANCE hInstance, int width, int height)
 
 	//allocate the ray tracer and the scene
 	m_pRayTracer = new RayTracer(width, height);
+	//show a coarse image straight away and refine it over the next frames
+	m_pRayTracer->SetProgressive(true);
+	//keep what each pixel sees so a camera drag can reuse the image
+	m_pRayTracer->SetReprojection(true);
 	m_pScene = new Scene();
 	m_pScene->SetSceneWidth((float)width / (float)height);
 
@@ -144,6 +149,15 @@ void OGLWindow::Render()
 {
 	m_pRayTracer->DoRayTrace(m_pScene);
 
+	//the tracer renders off-screen, upload its framebuffer in one go
+	const FrameBuffer& image = m_pRayTracer->GetFrameBuffer();
+
+	if (image.GetData())
+	{
+		glRasterPos2i(0, 0);
+		glDrawPixels(image.GetWidth(), image.GetHeight(), GL_RGB, GL_FLOAT, image.GetData());
+	}
+
 	glFlush();
 
 	SwapBuffers(m_hdc);
@@ -177,17 +191,32 @@ void OGLWindow::InitOGLState()
 
 BOOL OGLWindow::MouseLBDown ( int x, int y )
 {
-	
+	CameraNavigator::Mode mode = (GetKeyState(VK_SHIFT) & 0x8000) ? CameraNavigator::NAVIGATE_PAN : CameraNavigator::NAVIGATE_ORBIT;
+
+	//keep the drag going when the mouse leaves the window
+	SetCapture(m_hwnd);
+	m_navigator.Begin(m_pScene, *m_pRayTracer, x, y, mode);
 	return TRUE;
 }
 
 BOOL OGLWindow::MouseLBUp ( int x, int y )
 {
+	if (!m_navigator.IsDragging())
+		return TRUE;
+
+	m_navigator.End();
+	ReleaseCapture();
+
+	//the reprojected images are approximate, trace the view properly now it has stopped
+	m_pRayTracer->ResetRenderCount();
 	return TRUE;
 }
 
 BOOL OGLWindow::MouseMove ( int x, int y )
 {
+	//the next Render traces only what the old image cannot show
+	if (m_navigator.Drag(m_pScene, x, y))
+		m_pRayTracer->Reproject(m_pScene);
 	return TRUE;
 }
 
@@ -220,6 +249,19 @@ BOOL OGLWindow::KeyUp(WPARAM key)
 	case VK_F7:
 		m_pRayTracer->m_traceflag = (RayTracer::TraceFlag)(m_pRayTracer->m_traceflag ^ RayTracer::TRACE_ORTHO);
 		break;
+	case VK_F8:
+		{
+			//save the current image, no need to trace again
+			PNGWriter writer;
+			writer.Write("MiniTrace.png", m_pRayTracer->GetFrameBuffer());
+		}
+		return TRUE;
+	case VK_F9:
+		m_pRayTracer->SetProgressive(!m_pRayTracer->IsProgressive());
+		break;
+	case VK_F10:
+		m_pRayTracer->SetAntiAliasing(m_pRayTracer->GetAntiAliasing() > 1 ? 1 : 16);
+		break;
 	}
 
 	m_pRayTracer->ResetRenderCount();
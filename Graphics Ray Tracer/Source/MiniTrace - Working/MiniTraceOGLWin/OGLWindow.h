@@ -11,6 +11,7 @@
 
 #include <Windows.h>
 
+#include "CameraNavigator.h"
 #include "Scene.h"
 #include "RayTracer.h"
 
@@ -26,6 +27,8 @@ class OGLWindow
 
 		RayTracer	*m_pRayTracer;
 		Scene		*m_pScene;
+
+		CameraNavigator	m_navigator;	//left drag orbits the camera, with shift held it pans
 		
 protected:
 
@@ -71,3 +71,10 @@ void Plane::SetPlane(const Vector3& normal, double offset)
 	m_normal = normal;
 	m_offset = -offset;
 }
+
+bool Plane::Translate(const Vector3& offset)
+{
+	//only the part of the move along the normal shifts the plane
+	m_offset -= m_normal.DotProduct(offset);
+	return true;
+}
@@ -25,5 +25,18 @@ class Plane : public Primitive
 		RayHitResult	IntersectByRay(Ray& ray);
 
 		void SetPlane(const Vector3& normal, double offset);
+
+		bool Translate(const Vector3& offset);
+
+		inline Vector3	GetNormal()
+		{
+			return m_normal;
+		}
+
+		//the d of the plane equation, i.e. minus the offset given to SetPlane
+		inline double	GetOffset()
+		{
+			return m_offset;
+		}
 };
 
@@ -9,6 +9,7 @@
 ---------------------------------------------------------------------*/
 #pragma once
 
+#include "AABB.h"
 #include "Ray.h"
 
 class Material;
@@ -24,7 +25,9 @@ class Primitive
 			PRIMTYPE_Plane = 0,
 			PRIMTYPE_Sphere,
 			PRIMTYPE_Triangle,
-			PRIMTYPE_Box
+			PRIMTYPE_Box,
+			PRIMTYPE_Mesh,
+			PRIMTYPE_Count		//number of primitive types
 		};
 
 		PRIMTYPE				m_primtype;
@@ -35,6 +38,26 @@ class Primitive
 
 		virtual RayHitResult			IntersectByRay(Ray& ray) = 0;
 
+		//Precomputes whatever the intersection test needs that does not depend on the ray.
+		//Scene::Commit calls it for every object, call it again after changing the shape.
+		virtual void				Commit()
+		{
+		}
+
+		//Fills in the bounding box of the primitive.
+		//Returns false for unbounded primitives such as planes.
+		virtual bool				GetBounds(AABB& bounds)
+		{
+			return false;
+		}
+
+		//Moves the primitive by offset and brings what Commit computed up to date, so the scene
+		//only has to refit its BVH, see Scene::Refit. Returns false if the type cannot be moved.
+		virtual bool				Translate(const Vector3& offset)
+		{
+			return false;
+		}
+
 		inline void				SetMaterial(Material* pMat)
 		{
 			m_pMaterial = pMat;
@@ -0,0 +1,144 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include "PrimitiveArrays.h"
+#include "Box.h"
+#include "Material.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+
+void PrimitiveArrays::Clear()
+{
+	m_spheres.clear();
+	m_planes.clear();
+	m_triangles.clear();
+	m_boxes.clear();
+	m_others.clear();
+
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		m_objects[i].clear();
+	}
+}
+
+PrimitiveArrays::Ref PrimitiveArrays::Add(Primitive* prim)
+{
+	Ref ref;
+	ref.type = prim->m_primtype;
+	ref.castShadow = prim->GetMaterial() ? prim->GetMaterial()->CastShadow() : true;
+
+	if (!HasArray(ref.type))
+	{
+		ref.index = (int)m_others.size();
+		m_others.push_back(prim);
+		return ref;
+	}
+
+	ref.index = (int)m_objects[ref.type].size();
+	m_objects[ref.type].push_back(prim);
+
+	switch (ref.type)
+	{
+		case Primitive::PRIMTYPE_Sphere:
+		{
+			Sphere* sphere = static_cast<Sphere*>(prim);
+			SphereData data;
+
+			data.centre = sphere->GetCentre();
+			data.radiusSqr = sphere->GetRadiusSqr();
+			m_spheres.push_back(data);
+			break;
+		}
+		case Primitive::PRIMTYPE_Plane:
+		{
+			Plane* plane = static_cast<Plane*>(prim);
+			PlaneData data;
+
+			data.normal = plane->GetNormal();
+			data.offset = plane->GetOffset();
+			m_planes.push_back(data);
+			break;
+		}
+		case Primitive::PRIMTYPE_Triangle:
+		{
+			Triangle* triangle = static_cast<Triangle*>(prim);
+			TriangleData data;
+
+			data.vertex0 = triangle->GetVertex(0);
+			data.normal = triangle->GetNormal();
+			data.edge0 = triangle->GetEdge(0);
+			data.edge1 = triangle->GetEdge(1);
+			data.offset = triangle->GetPlaneOffset();
+			triangle->GetBarycentricTerms(data.dot00, data.dot01, data.dot11, data.invDenom);
+			m_triangles.push_back(data);
+			break;
+		}
+		case Primitive::PRIMTYPE_Box:
+		{
+			Box* box = static_cast<Box*>(prim);
+			BoxData data;
+
+			data.centre = box->GetCentre();
+			data.halfSize = box->GetHalfSize();
+			for (int i = 0; i < 3; i++)
+			{
+				data.axes[i] = box->GetAxis(i);
+			}
+			data.axisAligned = box->IsAxisAligned();
+			m_boxes.push_back(data);
+			break;
+		}
+		default:
+			break;
+	}
+
+	return ref;
+}
+
+RayHitResult PrimitiveArrays::GetHit(const Ref& ref, Ray& ray, const Hit& hit) const
+{
+	if (ref.type == Primitive::PRIMTYPE_Mesh)
+		return static_cast<TriangleMesh*>(m_others[ref.index])->GetHit(ray, hit.t, hit.part, hit.u, hit.v);
+
+	if (!HasArray(ref.type))
+		return m_others[ref.index]->IntersectByRay(ray);
+
+	RayHitResult result = Ray::s_defaultHitResult;
+
+	result.t = hit.t;
+	result.point = ray.GetRayStart() + ray.GetRay()*hit.t;
+	result.data = m_objects[ref.type][ref.index];
+
+	switch (ref.type)
+	{
+		case Primitive::PRIMTYPE_Sphere:
+		{
+			Vector3 normal = result.point - m_spheres[ref.index].centre;
+			result.normal = normal.Normalise();
+			break;
+		}
+		case Primitive::PRIMTYPE_Plane:
+			result.normal = m_planes[ref.index].normal;
+			break;
+		case Primitive::PRIMTYPE_Triangle:
+			result.normal = m_triangles[ref.index].normal;
+			break;
+		case Primitive::PRIMTYPE_Box:
+		{
+			const Vector3& axis = m_boxes[ref.index].axes[hit.part / 2];
+			result.normal = (hit.part & 1) ? axis * -1.0 : axis;
+			break;
+		}
+		default:
+			break;
+	}
+
+	return result;
+}
@@ -0,0 +1,268 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <math.h>
+#include <vector>
+
+#include "Primitive.h"
+#include "Ray.h"
+#include "TriangleMesh.h"
+#include "Vector3.h"
+
+//The intersection data of the scene's primitives, copied into one contiguous array per type.
+//The tests are plain inline functions chosen by a switch on the type, so the scene's loops make
+//no virtual call per object and read each shape from memory next to the one tested before it.
+//Types without an array here, such as meshes, are tested through the object itself.
+//
+//A test only finds the t of a hit and the little GetHit needs to make its record, so the
+//point, normal and object are only worked out for the closest hit, once the search is over.
+//
+//Scene::Commit fills the arrays from its objects, which stay the owners of the shapes.
+//Each test follows the type's IntersectByRay operation for operation, so the t and the hit
+//record made by GetHit are exactly those of the object itself.
+class PrimitiveArrays
+{
+	public:
+		struct SphereData
+		{
+			Vector3		centre;
+			double		radiusSqr;
+		};
+
+		struct PlaneData
+		{
+			Vector3		normal;
+			double		offset;			//the d of the plane equation
+		};
+
+		struct TriangleData
+		{
+			Vector3		vertex0;
+			Vector3		normal;
+			Vector3		edge0;			//vertex 0 to vertex 2
+			Vector3		edge1;			//vertex 0 to vertex 1
+			double		offset;
+			double		dot00, dot01, dot11;
+			double		invDenom;
+		};
+
+		struct BoxData
+		{
+			Vector3		centre;
+			Vector3		halfSize;
+			Vector3		axes[3];
+			bool		axisAligned;
+		};
+
+		//Where a primitive's data is: the array of its type and the index in it
+		struct Ref
+		{
+			Primitive::PRIMTYPE		type;
+			int						index;
+			bool					castShadow;		//copied from the material
+		};
+
+		//A hit found by Intersect, before GetHit makes its record
+		struct Hit
+		{
+			double		t;
+			int			part;		//box: the slab entered and from which side; mesh: the triangle
+			double		u, v;		//mesh: the barycentric weights of the triangle's vertices 1 and 2
+		};
+
+	private:
+		std::vector<SphereData>		m_spheres;
+		std::vector<PlaneData>		m_planes;
+		std::vector<TriangleData>	m_triangles;
+		std::vector<BoxData>		m_boxes;
+		std::vector<Primitive*>		m_others;			//types without an array
+
+		//the objects the data came from, by type, for the hit records
+		std::vector<Primitive*>		m_objects[Primitive::PRIMTYPE_Count];
+
+	public:
+		void	Clear();
+
+		//Copies the primitive's intersection data to the end of its type's array
+		Ref		Add(Primitive* prim);
+
+		//True for the types with an array of their own
+		static inline bool HasArray(Primitive::PRIMTYPE type)
+		{
+			return type == Primitive::PRIMTYPE_Sphere || type == Primitive::PRIMTYPE_Plane
+				|| type == Primitive::PRIMTYPE_Triangle || type == Primitive::PRIMTYPE_Box;
+		}
+
+		inline Primitive* GetObject(const Ref& ref) const
+		{
+			return HasArray(ref.type) ? m_objects[ref.type][ref.index] : m_others[ref.index];
+		}
+
+		//True if the ray hits the primitive, hit.t is then the distance along it
+		inline bool Intersect(const Ref& ref, Ray& ray, Hit& hit) const
+		{
+			Vector3 start = ray.GetRayStart();
+			Vector3 dir = ray.GetRay();
+
+			switch (ref.type)
+			{
+				case Primitive::PRIMTYPE_Sphere:
+					return IntersectSphere(m_spheres[ref.index], start, dir, hit.t);
+				case Primitive::PRIMTYPE_Plane:
+					return IntersectPlane(m_planes[ref.index], start, dir, hit.t);
+				case Primitive::PRIMTYPE_Triangle:
+					return IntersectTriangle(m_triangles[ref.index], start, dir, hit.t);
+				case Primitive::PRIMTYPE_Box:
+					return IntersectBox(m_boxes[ref.index], start, dir, hit.t, hit.part);
+				case Primitive::PRIMTYPE_Mesh:
+					return static_cast<const TriangleMesh*>(m_others[ref.index])->FindHit(ray, hit.t, hit.part, hit.u, hit.v);
+				default:
+					break;
+			}
+
+			//a type with no test of its own here, GetHit asks it again for the closest hit
+			RayHitResult current = m_others[ref.index]->IntersectByRay(ray);
+			hit.t = current.t;
+			return current.t > 0.0 && current.t < FARFAR_AWAY;
+		}
+
+		//The hit record of a hit found by Intersect
+		RayHitResult GetHit(const Ref& ref, Ray& ray, const Hit& hit) const;
+
+		//Same as Sphere::IntersectByRay
+		static inline bool IntersectSphere(const SphereData& sphere, const Vector3& start, const Vector3& dir, double& t)
+		{
+			Vector3 sMinusC = start - sphere.centre;
+			double rayDirDot = dir.DotProduct(dir);
+			double b = dir.DotProduct(sMinusC);
+			double discriminant = b * b - (rayDirDot * (sMinusC.DotProduct(sMinusC) - sphere.radiusSqr));
+
+			t = FARFAR_AWAY;
+
+			if (discriminant > 0)
+			{
+				double tPlus = (-b + sqrt(discriminant)) / rayDirDot;
+				double tMinus = (-b - sqrt(discriminant)) / rayDirDot;
+
+				if (tPlus < tMinus)
+					t = tPlus;
+				else if (tMinus < tPlus)
+					t = tMinus;
+			}
+			else if (discriminant == 0)
+			{
+				t = (-b + sqrt(discriminant)) / rayDirDot;
+			}
+
+			return t > 0.0 && t < FARFAR_AWAY;
+		}
+
+		//Same as Plane::IntersectByRay, front faces only
+		static inline bool IntersectPlane(const PlaneData& plane, const Vector3& start, const Vector3& dir, double& t)
+		{
+			double bottom = dir.DotProduct(plane.normal);
+
+			if (!(bottom < 0))
+				return false;
+
+			double top = start.DotProduct(plane.normal) + plane.offset;
+			t = -((top) / (bottom));
+
+			return t > 0.0 && t < FARFAR_AWAY;
+		}
+
+		//Same as Triangle::IntersectByRay, front faces only
+		static inline bool IntersectTriangle(const TriangleData& triangle, const Vector3& start, const Vector3& dir, double& t)
+		{
+			double bottom = dir.DotProduct(triangle.normal);
+
+			if (!(bottom < 0))
+				return false;
+
+			double top = start.DotProduct(triangle.normal) + triangle.offset;
+			t = -((top) / (bottom));
+
+			Vector3 vector2 = (start + dir * t) - triangle.vertex0;
+			double dot02 = triangle.edge0.DotProduct(vector2);
+			double dot12 = triangle.edge1.DotProduct(vector2);
+			double u = (triangle.dot11 * dot02 - triangle.dot01 * dot12) * triangle.invDenom;
+			double v = (triangle.dot00 * dot12 - triangle.dot01 * dot02) * triangle.invDenom;
+
+			if (u < 0 || v < 0 || u + v >= 1)
+				return false;
+
+			return t > 0 && t < FARFAR_AWAY;
+		}
+
+		//Same as Box::IntersectByRay, face is the slab the ray entered last and from which side
+		static inline bool IntersectBox(const BoxData& box, const Vector3& start, const Vector3& dir, double& t, int& face)
+		{
+			Vector3 offset = start - box.centre;
+			Vector3 localStart;
+			Vector3 localDir;
+
+			if (box.axisAligned)
+			{
+				localStart = offset;
+				localDir = dir;
+			}
+			else
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					localStart[i] = offset.DotProduct(box.axes[i]);
+					localDir[i] = dir.DotProduct(box.axes[i]);
+				}
+			}
+
+			double tNear = -FARFAR_AWAY;
+			double tFar = FARFAR_AWAY;
+			int nearAxis = -1;
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (localDir[i] == 0.0)
+				{
+					if (localStart[i] < -box.halfSize[i] || localStart[i] > box.halfSize[i])
+						return false;
+					continue;
+				}
+
+				double invDir = 1.0 / localDir[i];
+				double tA = (-box.halfSize[i] - localStart[i]) * invDir;
+				double tB = (box.halfSize[i] - localStart[i]) * invDir;
+
+				if (tA > tB)
+				{
+					double swap = tA; tA = tB; tB = swap;
+				}
+
+				if (tA > tNear)
+				{
+					tNear = tA;
+					nearAxis = i;
+				}
+
+				if (tB < tFar)
+					tFar = tB;
+
+				if (tNear > tFar)
+					return false;
+			}
+
+			if (nearAxis < 0 || tNear <= 0.0 || tNear >= FARFAR_AWAY)
+				return false;
+
+			t = tNear;
+			face = nearAxis * 2 + (localDir[nearAxis] < 0.0 ? 0 : 1);
+			return true;
+		}
+};
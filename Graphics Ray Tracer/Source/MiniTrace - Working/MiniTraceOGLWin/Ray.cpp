@@ -9,12 +9,20 @@
 ---------------------------------------------------------------------*/
 #include "Ray.h"
 
-RayHitResult Ray::s_defaultHitResult;
+static RayHitResult MakeDefaultHitResult()
+{
+	RayHitResult result;
+	result.data = nullptr;
+	result.t = FARFAR_AWAY;
+	return result;
+}
+
+//Set up once before main rather than in every Ray constructor,
+//so rays can be created from several render threads at the same time
+RayHitResult Ray::s_defaultHitResult = MakeDefaultHitResult();
 
 Ray::Ray()
 {
-	s_defaultHitResult.data = nullptr;
-	s_defaultHitResult.t = FARFAR_AWAY;
 }
 
 
@@ -0,0 +1,409 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <cmath>
+
+#include "RayPacket.h"
+#include "BVH.h"
+#include "Box.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+
+//The kernels below follow the scalar IntersectByRay of each primitive operation for operation,
+//so in double precision a lane finds the same t as the single ray would. Comparisons are written
+//the same way round as the scalar code so that NaNs are treated the same too.
+//They are templates over the scalar type and are instantiated for float and double at the end.
+
+template <class Real>
+void RayPacketT<Real>::Reset(int packetSize)
+{
+	size = packetSize < SimdOf<Real>::Width ? (int)SimdOf<Real>::Width : packetSize;
+	count = 0;
+}
+
+template <class Real>
+void RayPacketT<Real>::AddRay(const Vector3& start, const Vector3& dir)
+{
+	startX[count] = (Real)start[0];
+	startY[count] = (Real)start[1];
+	startZ[count] = (Real)start[2];
+	dirX[count] = (Real)dir[0];
+	dirY[count] = (Real)dir[1];
+	dirZ[count] = (Real)dir[2];
+	count++;
+}
+
+template <class Real>
+void RayPacketT<Real>::Finish()
+{
+	for (int i = count; i < size; i++)
+	{
+		startX[i] = startX[0];
+		startY[i] = startY[0];
+		startZ[i] = startZ[0];
+		dirX[i] = dirX[0];
+		dirY[i] = dirY[0];
+		dirZ[i] = dirZ[0];
+	}
+
+	for (int i = 0; i < size; i++)
+	{
+		Vector3 invDir = ReciprocalDirection(Vector3(dirX[i], dirY[i], dirZ[i]));
+		invDirX[i] = (Real)invDir[0];
+		invDirY[i] = (Real)invDir[1];
+		invDirZ[i] = (Real)invDir[2];
+		t[i] = (Real)FARFAR_AWAY;
+		hit[i] = nullptr;
+		number[i] = -1;
+	}
+}
+
+//Stores the new t of the lanes in valid, hits at or before the lane's t, and points them at prim;
+//a lane whose t is the same keeps its hit unless prim has the lower number
+template <class Real, class Simd>
+static inline int UpdateLanes(RayPacketT<Real>& packet, int lane, Simd valid, Simd t, Primitive* prim, int number)
+{
+	int mask = MoveMask(valid);
+	if (mask == 0)
+		return 0;
+
+	Simd current = Simd::Load(&packet.t[lane]);
+	int ties = MoveMask(valid & CmpEq(t, current));
+
+	Select(valid, t, current).Store(&packet.t[lane]);
+
+	int updated = 0;
+	for (int k = 0; k < SimdOf<Real>::Width; k++)
+	{
+		if ((mask & (1 << k)) && (!(ties & (1 << k)) || number < packet.number[lane + k]))
+		{
+			packet.hit[lane + k] = prim;
+			packet.number[lane + k] = number;
+			updated++;
+		}
+	}
+	return updated;
+}
+
+template <class Real>
+static int IntersectSpheres(Sphere* sphere, int number, RayPacketT<Real>& packet)
+{
+	typedef typename SimdOf<Real>::Type Simd;
+
+	Vector3 centre = sphere->GetCentre();
+	Simd cx(centre[0]), cy(centre[1]), cz(centre[2]);
+	Simd r2(sphere->GetRadiusSqr());
+	Simd zero(0.0), farAway(FARFAR_AWAY);
+	int updated = 0;
+
+	for (int i = 0; i < packet.size; i += SimdOf<Real>::Width)
+	{
+		Simd dx = Simd::Load(&packet.dirX[i]);
+		Simd dy = Simd::Load(&packet.dirY[i]);
+		Simd dz = Simd::Load(&packet.dirZ[i]);
+		Simd scx = Simd::Load(&packet.startX[i]) - cx;
+		Simd scy = Simd::Load(&packet.startY[i]) - cy;
+		Simd scz = Simd::Load(&packet.startZ[i]) - cz;
+
+		Simd dirDot = dx * dx + dy * dy + dz * dz;
+		Simd b = dx * scx + dy * scy + dz * scz;
+		Simd discriminant = b * b - dirDot * ((scx * scx + scy * scy + scz * scz) - r2);
+
+		Simd root = Sqrt(Max(discriminant, zero));
+		Simd tPlus = ((zero - b) + root) / dirDot;
+		Simd tMinus = ((zero - b) - root) / dirDot;
+
+		//the nearer root, which may be behind the ray start; a single root when the ray grazes the sphere
+		Simd t = Select(CmpLt(tPlus, tMinus), tPlus, Select(CmpLt(tMinus, tPlus), tMinus, farAway));
+		t = Select(CmpEq(discriminant, zero), tPlus, t);
+
+		Simd valid = CmpGe(discriminant, zero) & CmpGt(t, zero) & CmpLt(t, farAway)
+			& CmpLe(t, Simd::Load(&packet.t[i]));
+
+		updated += UpdateLanes(packet, i, valid, t, sphere, number);
+	}
+
+	return updated;
+}
+
+template <class Real>
+static int IntersectPlanes(Plane* plane, int number, RayPacketT<Real>& packet)
+{
+	typedef typename SimdOf<Real>::Type Simd;
+
+	Vector3 normal = plane->GetNormal();
+
+	Simd nx(normal[0]), ny(normal[1]), nz(normal[2]);
+	Simd offset(plane->GetOffset());
+	Simd zero(0.0), farAway(FARFAR_AWAY);
+	int updated = 0;
+
+	for (int i = 0; i < packet.size; i += SimdOf<Real>::Width)
+	{
+		Simd bottom = Simd::Load(&packet.dirX[i]) * nx
+			+ Simd::Load(&packet.dirY[i]) * ny
+			+ Simd::Load(&packet.dirZ[i]) * nz;
+		Simd top = (Simd::Load(&packet.startX[i]) * nx
+			+ Simd::Load(&packet.startY[i]) * ny
+			+ Simd::Load(&packet.startZ[i]) * nz) + offset;
+		Simd t = zero - top / bottom;
+
+		//front faces only
+		Simd valid = CmpLt(bottom, zero) & CmpGt(t, zero) & CmpLt(t, farAway)
+			& CmpLe(t, Simd::Load(&packet.t[i]));
+
+		updated += UpdateLanes(packet, i, valid, t, plane, number);
+	}
+
+	return updated;
+}
+
+template <class Real>
+static int IntersectTriangles(Triangle* triangle, int number, RayPacketT<Real>& packet)
+{
+	typedef typename SimdOf<Real>::Type Simd;
+
+	Vector3 v0 = triangle->GetVertex(0);
+	Vector3 normal = triangle->GetNormal();
+	Vector3 edge0 = triangle->GetEdge(0);
+	Vector3 edge1 = triangle->GetEdge(1);
+
+	//the parts of the barycentric test that do not depend on the ray
+	double dot00, dot01, dot11, invDenom;
+	triangle->GetBarycentricTerms(dot00, dot01, dot11, invDenom);
+
+	Simd nx(normal[0]), ny(normal[1]), nz(normal[2]);
+	Simd d(triangle->GetPlaneOffset());
+	Simd v0x(v0[0]), v0y(v0[1]), v0z(v0[2]);
+	Simd e0x(edge0[0]), e0y(edge0[1]), e0z(edge0[2]);
+	Simd e1x(edge1[0]), e1y(edge1[1]), e1z(edge1[2]);
+	Simd d00(dot00), d01(dot01), d11(dot11), inv(invDenom);
+	Simd zero(0.0), one(1.0), farAway(FARFAR_AWAY);
+	int updated = 0;
+
+	for (int i = 0; i < packet.size; i += SimdOf<Real>::Width)
+	{
+		Simd sx = Simd::Load(&packet.startX[i]);
+		Simd sy = Simd::Load(&packet.startY[i]);
+		Simd sz = Simd::Load(&packet.startZ[i]);
+		Simd dx = Simd::Load(&packet.dirX[i]);
+		Simd dy = Simd::Load(&packet.dirY[i]);
+		Simd dz = Simd::Load(&packet.dirZ[i]);
+
+		Simd bottom = dx * nx + dy * ny + dz * nz;
+		Simd top = (sx * nx + sy * ny + sz * nz) + d;
+		Simd t = zero - top / bottom;
+
+		Simd px = (sx + dx * t) - v0x;
+		Simd py = (sy + dy * t) - v0y;
+		Simd pz = (sz + dz * t) - v0z;
+
+		Simd dot02 = e0x * px + e0y * py + e0z * pz;
+		Simd dot12 = e1x * px + e1y * py + e1z * pz;
+		Simd u = (d11 * dot02 - d01 * dot12) * inv;
+		Simd v = (d00 * dot12 - d01 * dot02) * inv;
+
+		Simd outside = CmpLt(u, zero) | CmpLt(v, zero) | CmpGe(u + v, one);
+
+		Simd valid = AndNot(outside, CmpLt(bottom, zero)) & CmpGt(t, zero) & CmpLt(t, farAway)
+			& CmpLe(t, Simd::Load(&packet.t[i]));
+
+		updated += UpdateLanes(packet, i, valid, t, triangle, number);
+	}
+
+	return updated;
+}
+
+template <class Real>
+static int IntersectBoxes(Box* box, int number, RayPacketT<Real>& packet)
+{
+	typedef typename SimdOf<Real>::Type Simd;
+
+	Vector3 centre = box->GetCentre();
+	Vector3 halfSize = box->GetHalfSize();
+	bool axisAligned = box->IsAxisAligned();
+	Vector3 axes[3] = { box->GetAxis(0), box->GetAxis(1), box->GetAxis(2) };
+
+	Simd cx(centre[0]), cy(centre[1]), cz(centre[2]);
+	Simd zero(0.0), farAway(FARFAR_AWAY), nearInit(-FARFAR_AWAY);
+	int updated = 0;
+
+	for (int i = 0; i < packet.size; i += SimdOf<Real>::Width)
+	{
+		Simd ox = Simd::Load(&packet.startX[i]) - cx;
+		Simd oy = Simd::Load(&packet.startY[i]) - cy;
+		Simd oz = Simd::Load(&packet.startZ[i]) - cz;
+		Simd dx = Simd::Load(&packet.dirX[i]);
+		Simd dy = Simd::Load(&packet.dirY[i]);
+		Simd dz = Simd::Load(&packet.dirZ[i]);
+
+		Simd localStart[3];
+		Simd localDir[3];
+
+		if (axisAligned)
+		{
+			localStart[0] = ox; localStart[1] = oy; localStart[2] = oz;
+			localDir[0] = dx; localDir[1] = dy; localDir[2] = dz;
+		}
+		else
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				Simd ax(axes[a][0]), ay(axes[a][1]), az(axes[a][2]);
+				localStart[a] = ox * ax + oy * ay + oz * az;
+				localDir[a] = dx * ax + dy * ay + dz * az;
+			}
+		}
+
+		Simd tNear = nearInit;
+		Simd tFar = farAway;
+		Simd missed = CmpGt(zero, zero);		//no lane missed yet
+
+		for (int a = 0; a < 3; a++)
+		{
+			Simd h(halfSize[a]);
+			Simd minusH(-halfSize[a]);
+			Simd parallel = CmpEq(localDir[a], zero);
+
+			//parallel to this slab, either always inside it or never
+			missed = missed | (parallel & (CmpLt(localStart[a], minusH) | CmpGt(localStart[a], h)));
+
+			Simd invDir = Simd(1.0) / localDir[a];
+			Simd tA = (minusH - localStart[a]) * invDir;
+			Simd tB = (h - localStart[a]) * invDir;
+			Simd swap = CmpGt(tA, tB);
+			Simd lo = Select(swap, tB, tA);
+			Simd hi = Select(swap, tA, tB);
+
+			tNear = Select(AndNot(parallel, CmpGt(lo, tNear)), lo, tNear);
+			tFar = Select(AndNot(parallel, CmpLt(hi, tFar)), hi, tFar);
+		}
+
+		//the slab intervals only shrink, so checking for an empty overlap once at the end is enough
+		missed = missed | CmpGt(tNear, tFar);
+
+		Simd valid = AndNot(missed, CmpGt(tNear, zero)) & CmpLt(tNear, farAway)
+			& CmpLe(tNear, Simd::Load(&packet.t[i]));
+
+		updated += UpdateLanes(packet, i, valid, tNear, box, number);
+	}
+
+	return updated;
+}
+
+template <class Real>
+int IntersectPacket(Primitive* prim, int number, RayPacketT<Real>& packet)
+{
+	switch (prim->m_primtype)
+	{
+		case Primitive::PRIMTYPE_Sphere:
+			return IntersectSpheres(static_cast<Sphere*>(prim), number, packet);
+		case Primitive::PRIMTYPE_Plane:
+			return IntersectPlanes(static_cast<Plane*>(prim), number, packet);
+		case Primitive::PRIMTYPE_Triangle:
+			return IntersectTriangles(static_cast<Triangle*>(prim), number, packet);
+		case Primitive::PRIMTYPE_Box:
+			return IntersectBoxes(static_cast<Box*>(prim), number, packet);
+		default:
+			break;
+	}
+
+	//a primitive without a kernel, trace its lanes one at a time
+	int updated = 0;
+	for (int i = 0; i < packet.count; i++)
+	{
+		Ray ray = packet.GetRay(i);
+		RayHitResult current = prim->IntersectByRay(ray);
+
+		Real t = (Real)current.t;
+
+		if (current.t > 0.0 && (t < packet.t[i] || (t == packet.t[i] && number < packet.number[i])))
+		{
+			packet.t[i] = t;
+			packet.hit[i] = prim;
+			packet.number[i] = number;
+			updated++;
+		}
+	}
+	return updated;
+}
+
+//The nearest value of the scalar type at or below, or at or above, x
+template <class Real> static inline Real RoundDown(double x)
+{
+	Real r = (Real)x;
+	return r > x ? std::nextafter(r, (Real)-FARFAR_AWAY) : r;
+}
+
+template <class Real> static inline Real RoundUp(double x)
+{
+	Real r = (Real)x;
+	return r < x ? std::nextafter(r, (Real)FARFAR_AWAY) : r;
+}
+
+template <class Real>
+bool IntersectPacketBounds(const AABB& bounds, const RayPacketT<Real>& packet, Real& tNear)
+{
+	typedef typename SimdOf<Real>::Type Simd;
+
+	Simd minX(RoundDown<Real>(bounds.min[0])), minY(RoundDown<Real>(bounds.min[1])), minZ(RoundDown<Real>(bounds.min[2]));
+	Simd maxX(RoundUp<Real>(bounds.max[0])), maxY(RoundUp<Real>(bounds.max[1])), maxZ(RoundUp<Real>(bounds.max[2]));
+	Simd nearest(FARFAR_AWAY);
+	int anyHit = 0;
+
+	for (int i = 0; i < packet.size; i += SimdOf<Real>::Width)
+	{
+		Simd t0(0.0);
+		Simd t1 = Simd::Load(&packet.t[i]);
+
+		Simd start[3] = { Simd::Load(&packet.startX[i]), Simd::Load(&packet.startY[i]), Simd::Load(&packet.startZ[i]) };
+		Simd invDir[3] = { Simd::Load(&packet.invDirX[i]), Simd::Load(&packet.invDirY[i]), Simd::Load(&packet.invDirZ[i]) };
+		Simd lo[3] = { minX, minY, minZ };
+		Simd hi[3] = { maxX, maxY, maxZ };
+
+		//same as AABB::IntersectByRay
+		for (int a = 0; a < 3; a++)
+		{
+			Simd tA = (lo[a] - start[a]) * invDir[a];
+			Simd tB = (hi[a] - start[a]) * invDir[a];
+			Simd swap = CmpGt(tA, tB);
+			Simd tEnter = Select(swap, tB, tA);
+			Simd tExit = Select(swap, tA, tB);
+
+			t0 = Select(CmpGt(tEnter, t0), tEnter, t0);
+			t1 = Select(CmpLt(tExit, t1), tExit, t1);
+		}
+
+		Simd hit = CmpLe(t0, t1);
+		anyHit |= MoveMask(hit);
+		nearest = Min(nearest, Select(hit, t0, Simd(FARFAR_AWAY)));
+	}
+
+	if (anyHit == 0)
+		return false;
+
+	SIMD_ALIGN Real lanes[SimdOf<Real>::Width];
+	nearest.Store(lanes);
+
+	tNear = lanes[0];
+	for (int k = 1; k < SimdOf<Real>::Width; k++)
+	{
+		if (lanes[k] < tNear)
+			tNear = lanes[k];
+	}
+	return true;
+}
+
+template struct RayPacketT<double>;
+template struct RayPacketT<float>;
+template int IntersectPacket(Primitive* prim, int number, RayPacketT<double>& packet);
+template int IntersectPacket(Primitive* prim, int number, RayPacketT<float>& packet);
+template bool IntersectPacketBounds(const AABB& bounds, const RayPacketT<double>& packet, double& tNear);
+template bool IntersectPacketBounds(const AABB& bounds, const RayPacketT<float>& packet, float& tNear);
@@ -0,0 +1,96 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include "AABB.h"
+#include "Ray.h"
+#include "Simd.h"
+
+#define RAYPACKET_MAX_SIZE	16
+
+class Primitive;
+
+//Precision of the packet intersection tests. Float packets hold twice as many lanes per SIMD
+//register and half the memory; the hit records and shading stay in double either way.
+enum RayPrecision
+{
+	PRECISION_DOUBLE = 0,
+	PRECISION_FLOAT
+};
+
+//A bundle of rays traced together. Each component is stored in its own array
+//so that SimdOf<Real>::Width rays are tested against a primitive at once.
+//Only the nearest hit distance and primitive are found for each ray; the full
+//hit record is filled in afterwards by the primitive's own IntersectByRay.
+template <class Real>
+struct RayPacketT
+{
+	typedef Real Scalar;
+
+	SIMD_ALIGN Real		startX[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		startY[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		startZ[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		dirX[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		dirY[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		dirZ[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		invDirX[RAYPACKET_MAX_SIZE];		//see ReciprocalDirection
+	SIMD_ALIGN Real		invDirY[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		invDirZ[RAYPACKET_MAX_SIZE];
+	SIMD_ALIGN Real		t[RAYPACKET_MAX_SIZE];			//distance to the nearest hit so far
+	Primitive*			hit[RAYPACKET_MAX_SIZE];		//the primitive hit at t, nullptr for none
+	int					number[RAYPACKET_MAX_SIZE];		//the number the scene gave it, which wins ties by being lower
+
+	int					size;		//lanes processed, a multiple of the SIMD width
+	int					count;		//lanes holding real rays, the rest repeat the first ray
+
+	//Starts an empty packet of size lanes, size must be 4, 8 or 16.
+	//It is rounded up to the SIMD width, so a float packet of 4 on AVX processes 8 lanes.
+	void	Reset(int packetSize);
+	void	AddRay(const Vector3& start, const Vector3& dir);
+	//Pads the unused lanes and computes the reciprocal directions, call before tracing
+	void	Finish();
+
+	//Makes a finished packet with the other packet's rays
+	template <class Other>
+	void	Assign(const RayPacketT<Other>& other)
+	{
+		Reset(other.size);
+		for (int i = 0; i < other.count; i++)
+		{
+			AddRay(Vector3(other.startX[i], other.startY[i], other.startZ[i]),
+				Vector3(other.dirX[i], other.dirY[i], other.dirZ[i]));
+		}
+		Finish();
+	}
+
+	inline Ray GetRay(int lane) const
+	{
+		Ray ray;
+		ray.SetRay(Vector3(startX[lane], startY[lane], startZ[lane]), Vector3(dirX[lane], dirY[lane], dirZ[lane]));
+		return ray;
+	}
+};
+
+typedef RayPacketT<double>	RayPacket;
+typedef RayPacketT<float>	RayPacketF;
+
+//Tests every lane of the packet against the primitive, the same way its IntersectByRay does,
+//and records hits closer than the lane's t. A hit at the lane's t is taken if number is lower
+//than that of the primitive hit there, as in Scene::FindHit, so ties do not depend on the order
+//of the tests. Returns the number of lanes whose hit changed.
+//In double precision every lane finds the same t as the single ray would.
+template <class Real>
+int IntersectPacket(Primitive* prim, int number, RayPacketT<Real>& packet);
+
+//Slab test of every lane against a bounding box, limited to each lane's t.
+//Returns true if any lane hits it, tNear is the smallest entry distance.
+//A float test rounds the box outwards, so it never misses what the double test hits.
+template <class Real>
+bool IntersectPacketBounds(const AABB& bounds, const RayPacketT<Real>& packet, Real& tNear);
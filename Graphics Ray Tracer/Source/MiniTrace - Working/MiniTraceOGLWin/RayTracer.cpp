@@ -8,25 +8,35 @@
 * however the author does not guarantee its performance.
 ---------------------------------------------------------------------*/
 #include <math.h>
-
-#ifdef WIN32
-#include <Windows.h>
-#include <gl/GL.h>
-#endif
-
-#ifdef __APPLE__
-#include <OpenGL/gl.h>
-#endif
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
 
 #include "RayTracer.h"
 #include "Ray.h"
 #include "Scene.h"
 #include "Camera.h"
+#include "RayPacket.h"
 
 RayTracer::RayTracer()
 {
 	m_buffHeight = m_buffWidth = 0.0;
 	m_renderCount = 0;
+	m_verbose = true;
+	m_packetSize = 0;
+	m_progressive = false;
+	m_passStep = 0;
+	m_wavefront = false;
+	m_precision = PRECISION_DOUBLE;
+	m_aaGrid = 1;
+	m_aaThreshold = AA_DEFAULT_THRESHOLD;
+	m_lightBudget = 0;
+	m_shadowCache = true;
+	m_tileCulling = true;
+	m_hasRegion = false;
+	m_reprojection = false;
+	m_reprojectPending = false;
+	m_renderStats.Reset();
 	SetTraceLevel(5);
 	m_traceflag = (TraceFlag)(TRACE_AMBIENT | TRACE_DIFFUSE_AND_SPEC |
 		TRACE_SHADOW | TRACE_REFLECTION | TRACE_REFRACTION);
@@ -37,6 +47,21 @@ RayTracer::RayTracer(int Width, int Height)
 	m_buffWidth = Width;
 	m_buffHeight = Height;
 	m_renderCount = 0;
+	m_verbose = true;
+	m_packetSize = 0;
+	m_progressive = false;
+	m_passStep = 0;
+	m_wavefront = false;
+	m_precision = PRECISION_DOUBLE;
+	m_aaGrid = 1;
+	m_aaThreshold = AA_DEFAULT_THRESHOLD;
+	m_lightBudget = 0;
+	m_shadowCache = true;
+	m_tileCulling = true;
+	m_hasRegion = false;
+	m_reprojection = false;
+	m_reprojectPending = false;
+	m_renderStats.Reset();
 	SetTraceLevel(5);
 	
 	m_traceflag = (TraceFlag)(TRACE_AMBIENT | TRACE_DIFFUSE_AND_SPEC |
@@ -48,15 +73,60 @@ RayTracer::~RayTracer()
 
 }
 
-void RayTracer::DoRayTrace( Scene* pScene )
+bool RayTracer::SetPacketSize(int size)
+{
+	if (size != 0 && size != 4 && size != 8 && size != 16)
+		return false;
+
+	m_packetSize = size;
+	return true;
+}
+
+bool RayTracer::SetAntiAliasing(int maxSamples, double threshold)
+{
+	int grid = (int)(sqrt((double)maxSamples) + 0.5);
+
+	if (grid < 1 || grid > AA_MAX_GRID || grid * grid != maxSamples || threshold < 0.0)
+		return false;
+
+	m_aaGrid = grid;
+	m_aaThreshold = threshold;
+	return true;
+}
+
+//A repeatable number in [0, 1) for the given pixel and index, used to jitter the anti-aliasing samples
+//The light selections of the render thread tracing a tile, one for each trace level below the
+//first, so that shading a hit does not allocate; a pointer, as THREAD_LOCAL data must be plain
+static THREAD_LOCAL std::vector<LightSelection>* s_lightSelections;
+
+static double SampleJitter(int x, int y, int index)
+{
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)y * 19349663u ^ (unsigned int)index * 83492791u;
+
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+
+	return (h >> 8) * (1.0 / 16777216.0);
+}
+
+//True if the colours differ by at least threshold in any channel
+static inline bool ColoursDiffer(const Colour& a, const Colour& b, double threshold)
+{
+	return fabs(a.red - b.red) >= threshold
+		|| fabs(a.green - b.green) >= threshold
+		|| fabs(a.blue - b.blue) >= threshold;
+}
+
+void RayTracer::GetViewPlane(Scene* pScene, Vector3& start, double& pixelDX, double& pixelDY) const
 {
 	Camera* cam = pScene->GetSceneCamera();
-	
+
 	Vector3 camRightVector = cam->GetRightVector();
 	Vector3 camUpVector = cam->GetUpVector();
-	Vector3 camViewVector = cam->GetViewVector();
 	Vector3 centre = cam->GetViewCentre();
-	Vector3 camPosition = cam->GetPosition();
 
 	double sceneWidth = pScene->GetSceneWidth();
 	double sceneHeight = pScene->GetSceneHeight();
@@ -68,13 +138,8 @@ void RayTracer::DoRayTrace( Scene* pScene )
 		sceneHeight *= 20;
 	}
 
-	double pixelDX = sceneWidth / m_buffWidth;
-	double pixelDY = sceneHeight / m_buffHeight;
-	
-	int total = m_buffHeight*m_buffWidth;
-	int done_count = 0;
-	
-	Vector3 start;
+	pixelDX = sceneWidth / m_buffWidth;
+	pixelDY = sceneHeight / m_buffHeight;
 
 	start[0] = centre[0] - ((sceneWidth * camRightVector[0])
 		+ (sceneHeight * camUpVector[0])) / 2.0;
@@ -82,177 +147,804 @@ void RayTracer::DoRayTrace( Scene* pScene )
 		+ (sceneHeight * camUpVector[1])) / 2.0;
 	start[2] = centre[2] - ((sceneWidth * camRightVector[2])
 		+ (sceneHeight * camUpVector[2])) / 2.0;
+}
+
+double RayTracer::GetPixelSize(Scene* pScene, double depth) const
+{
+	Camera* cam = pScene->GetSceneCamera();
+
+	Vector3 start;
+	double pixelDX, pixelDY;
+	GetViewPlane(pScene, start, pixelDX, pixelDY);
+
+	double size = pixelDY * cam->GetUpVector().Norm();
+	if (m_traceflag & RayTracer::TRACE_ORTHO)
+		return size;
+
+	return size * depth / (cam->GetViewCentre() - cam->GetPosition()).DotProduct(cam->GetViewVector());
+}
+
+bool RayTracer::DoRayTrace( Scene* pScene )
+{
+	Camera* cam = pScene->GetSceneCamera();
+	
+	Vector3 camRightVector = cam->GetRightVector();
+	Vector3 camUpVector = cam->GetUpVector();
+	Vector3 camViewVector = cam->GetViewVector();
+	Vector3 camPosition = cam->GetPosition();
+
+	Vector3 start;
+	double pixelDX, pixelDY;
+	GetViewPlane(pScene, start, pixelDX, pixelDY);
 	
 	Colour scenebg = pScene->GetBackgroundColour();
 
 	if (m_renderCount == 0)
 	{
-		fprintf(stdout, "Trace start.\n");
+		//a full render is a single pass with a spacing of one pixel
+		int step = 1;
+		bool firstPass = true;
 
-		glClearColor(0.0, 0.0, 0.0, 0.0);
-		glClear(GL_COLOR_BUFFER_BIT);
+		//after a Reproject only the pixels it could not fill are traced, into the image it left
+		bool retraceOnly = m_reprojectPending;
 
-		for (int i = 0; i < m_buffHeight; i++) 
+		if (m_progressive && !retraceOnly)
 		{
-			for (int j = 0; j < m_buffWidth; j++) 
+			firstPass = m_passStep == 0;
+			step = firstPass ? PROGRESSIVE_FIRST_STEP : m_passStep / 2;
+		}
+
+		//pixels on the grid of the previous, twice as coarse, pass are traced already
+		int tracedStep = firstPass ? 0 : step * 2;
+
+		if (m_verbose && firstPass)
+			fprintf(stdout, "Trace start.\n");
+
+		std::chrono::high_resolution_clock::time_point traceStart = std::chrono::high_resolution_clock::now();
+		std::chrono::high_resolution_clock::time_point phaseStart = traceStart;
+		double phaseTimeMs[RenderStats::PHASE_COUNT];
+
+		//the time since the last call, in ms
+		auto lapTime = [&phaseStart]() -> double
+		{
+			std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+			std::chrono::duration<double, std::milli> lap = now - phaseStart;
+			phaseStart = now;
+			return lap.count();
+		};
+
+		//later passes refine the image left by the earlier ones
+		if (firstPass && !retraceOnly)
+		{
+			m_frameBuffer.Resize(m_buffWidth, m_buffHeight);
+
+			if (m_reprojection)
 			{
+				//a region render keeps what the rest of the image recorded
+				size_t pixelCount = (size_t)m_buffWidth * m_buffHeight;
+				if (!m_hasRegion || m_pixelStates.size() != pixelCount)
+					m_pixelStates.assign(pixelCount, PIXEL_EMPTY);
+				m_pixelPoints.resize(pixelCount);
+			}
+		}
+
+		//each worker sums the counters of its own tiles, so no locking is needed
+		std::vector<RenderStats> workerStats(m_scheduler.GetThreadCount());
 
-				//calculate the metric size of a pixel in the view plane (e.g. framebuffer)
-				Vector3 pixel;
-
-				pixel[0] = start[0] + (i + 0.5) * camUpVector[0] * pixelDY
-					+ (j + 0.5) * camRightVector[0] * pixelDX;
-				pixel[1] = start[1] + (i + 0.5) * camUpVector[1] * pixelDY
-					+ (j + 0.5) * camRightVector[1] * pixelDX;
-				pixel[2] = start[2] + (i + 0.5) * camUpVector[2] * pixelDY
-					+ (j + 0.5) * camRightVector[2] * pixelDX;
-
-				/*
-				* setup view ray
-				* In perspective projection, each view ray originates from the eye (camera) position 
-				* and pierces through a pixel in the view plane
-				*
-				* TODO: For a little extra credit, set up the view rays to produce orthographic projection
-				*/
-				// link: http://www.cs.cornell.edu/courses/cs4620/2011fa/lectures/06raytracingWeb.pdf
-				Ray viewray;	
-
-				//Orthographic Camera
-				if (m_traceflag & RayTracer::TRACE_ORTHO)
+		//the point (x, y) of the view plane, in pixels
+		auto viewPlanePoint = [&](double y, double x) -> Vector3
+		{
+			//calculate the metric size of a pixel in the view plane (e.g. framebuffer)
+			Vector3 pixel;
+
+			pixel[0] = start[0] + y * camUpVector[0] * pixelDY
+				+ x * camRightVector[0] * pixelDX;
+			pixel[1] = start[1] + y * camUpVector[1] * pixelDY
+				+ x * camRightVector[1] * pixelDX;
+			pixel[2] = start[2] + y * camUpVector[2] * pixelDY
+				+ x * camRightVector[2] * pixelDX;
+			return pixel;
+		};
+
+		//sets up the view ray through the point (x, y) of the view plane, in pixels
+		auto makeSampleRay = [&](double y, double x, Ray& viewray)
+		{
+			Vector3 pixel = viewPlanePoint(y, x);
+
+			/*
+			* setup view ray
+			* In perspective projection, each view ray originates from the eye (camera) position 
+			* and pierces through a pixel in the view plane
+			*
+			* TODO: For a little extra credit, set up the view rays to produce orthographic projection
+			*/
+			// link: http://www.cs.cornell.edu/courses/cs4620/2011fa/lectures/06raytracingWeb.pdf
+
+			//Orthographic Camera
+			if (m_traceflag & RayTracer::TRACE_ORTHO)
+			{
+				viewray.SetRay(pixel, camViewVector);
+			}
+			//Perspective Camera
+			else				
+			{
+				viewray.SetRay(camPosition, (pixel - camPosition).Normalise());
+			}
+		};
+
+		//sets up the view ray through the centre of pixel (j, i)
+		auto makeViewRay = [&](int i, int j, Ray& viewray)
+		{
+			makeSampleRay(i + 0.5, j + 0.5, viewray);
+		};
+
+		//finds what the primary rays of the tile can hit, null when culling is off
+		auto cullTile = [&](const RenderTile& tile, SceneCut& cut) -> const SceneCut*
+		{
+			if (!m_tileCulling)
+				return nullptr;
+
+			STATS_THREAD(stats);
+
+			//a pixel wider all round than the tile, so rounding cannot leave one of its rays out
+			Vector3 quad[4];
+			quad[0] = viewPlanePoint(tile.y0 - 1.0, tile.x0 - 1.0);
+			quad[1] = viewPlanePoint(tile.y0 - 1.0, tile.x1 + 1.0);
+			quad[2] = viewPlanePoint(tile.y1 + 1.0, tile.x1 + 1.0);
+			quad[3] = viewPlanePoint(tile.y1 + 1.0, tile.x0 - 1.0);
+
+			Frustum frustum;
+			if (m_traceflag & RayTracer::TRACE_ORTHO)
+				frustum.SetParallel(camViewVector, quad);
+			else
+				frustum.SetPerspective(camPosition, quad);
+
+			pScene->Cull(frustum, cut);
+
+			STATS_ADD(stats, culledTiles, 1);
+			STATS_ADD(stats, culledTileRoots, cut.rootCount);
+			STATS_ADD(stats, culledTilePlanes, cut.culledPlanes);
+			return &cut;
+		};
+
+		//packets cover a small block of pixels so their rays stay close together
+		int packetWidth = m_packetSize == 4 ? 2 : 4;
+		int packetHeight = m_packetSize / packetWidth;
+		bool usePackets = m_packetSize > 0 && m_traceLevel > 0;
+
+		//the first pixel on the pass grid at or after the given row or column
+		auto firstOnGrid = [step](int x) -> int
+		{
+			return (x + step - 1) / step * step;
+		};
+
+		//true for pixels on the pass grid that an earlier pass has traced
+		auto tracedBefore = [tracedStep](int x, int y) -> bool
+		{
+			return tracedStep && x % tracedStep == 0 && y % tracedStep == 0;
+		};
+
+		//the part of the image to trace, all of it without a region
+		RenderTile area;
+		area.x0 = area.y0 = 0;
+		area.x1 = m_buffWidth;
+		area.y1 = m_buffHeight;
+
+		if (m_hasRegion)
+		{
+			area.x0 = std::max(m_region.x0, 0);
+			area.y0 = std::max(m_region.y0, 0);
+			area.x1 = std::max(std::min(m_region.x1, m_buffWidth), area.x0);
+			area.y1 = std::max(std::min(m_region.y1, m_buffHeight), area.y0);
+		}
+
+		//the anti-aliasing looks at the neighbours of the area's pixels, so they are traced as well
+		RenderTile traceArea = area;
+
+		if (m_hasRegion && step == 1 && m_aaGrid > 1 && !retraceOnly)
+		{
+			traceArea.x0 = std::max(area.x0 - 1, 0);
+			traceArea.y0 = std::max(area.y0 - 1, 0);
+			traceArea.x1 = std::min(area.x1 + 1, m_buffWidth);
+			traceArea.y1 = std::min(area.y1 + 1, m_buffHeight);
+		}
+
+		if (m_wavefront)
+			m_wavefronts.resize(m_scheduler.GetThreadCount());
+		m_lightSelections.resize(m_scheduler.GetThreadCount());
+		for (size_t i = 0; i < m_lightSelections.size(); i++)
+		{
+			m_lightSelections[i].resize(std::max(m_traceLevel, 0));
+		}
+
+		phaseTimeMs[RenderStats::PHASE_SETUP] = lapTime();
+
+		//Each tile is traced by one of the render threads. Pixels do not depend on each other
+		//so the result is the same as tracing the rows one after another on a single thread.
+		m_scheduler.Run(traceArea, [&](const RenderTile& tile, int worker)
+		{
+			STATS_TILE_BEGIN(stats);
+			s_lightSelections = &m_lightSelections[worker];
+
+			SceneCut cut;
+			const SceneCut* tileCut = cullTile(tile, cut);
+
+			if (retraceOnly)
+			{
+				for (int i = tile.y0; i < tile.y1; i++)
 				{
-					viewray.SetRay(pixel, camViewVector);
+					for (int j = tile.x0; j < tile.x1; j++)
+					{
+						if (m_pixelStates[(size_t)i * m_buffWidth + j] != PIXEL_RETRACE)
+						{
+							STATS_ADD(stats, reprojectedPixels, 1);
+							continue;
+						}
+
+						Ray viewray;
+						makeViewRay(i, j, viewray);
+
+						STATS_ADD(stats, primaryRays, 1);
+						m_frameBuffer.SetPixel(j, i, TracePixel(pScene, viewray, scenebg, j, i, tileCut));
+					}
 				}
-				//Perspective Camera
-				else				
+			}
+			else if (m_wavefront)
+			{
+				//all the tile's rays go through the wavefront together
+				Wavefront& wavefront = m_wavefronts[worker];
+				wavefront.Reset();
+
+				for (int i = firstOnGrid(tile.y0); i < tile.y1; i += step)
 				{
-					viewray.SetRay(camPosition, (pixel - camPosition).Normalise());
+					for (int j = firstOnGrid(tile.x0); j < tile.x1; j += step)
+					{
+						if (tracedBefore(j, i))
+							continue;
+
+						Ray viewray;
+						makeViewRay(i, j, viewray);
+
+						STATS_ADD(stats, primaryRays, 1);
+						wavefront.AddPrimaryRay(viewray);
+					}
 				}
 
-				//trace the scene using the view ray
-				//the default colour is the background colour, unless something is hit along the way
-				Colour colour = this->TraceScene(pScene, viewray, scenebg, m_traceLevel);
+				wavefront.Trace(this, pScene, scenebg, m_packetSize, tileCut);
+
+				int index = 0;
+				for (int i = firstOnGrid(tile.y0); i < tile.y1; i += step)
+				{
+					for (int j = firstOnGrid(tile.x0); j < tile.x1; j += step)
+					{
+						if (tracedBefore(j, i))
+							continue;
 
-				/*
-				* The only OpenGL code we need
-				* Draw the pixel as a coloured rectangle
-				*/
-				glColor3f(colour.red, colour.green, colour.blue);
-				glRecti(j, i, j + 1, i + 1);
+						m_frameBuffer.SetPixel(j, i, wavefront.GetPrimaryColour(index++));
+
+						//the wavefront keeps only colours, the hit is found again
+						if (m_reprojection)
+						{
+							Ray viewray;
+							makeViewRay(i, j, viewray);
+							RecordPixel(j, i, viewray, pScene->IntersectByRay(viewray, tileCut));
+						}
+					}
+				}
+			}
+			else if (!usePackets)
+			{
+				for (int i = firstOnGrid(tile.y0); i < tile.y1; i += step)
+				{
+					for (int j = firstOnGrid(tile.x0); j < tile.x1; j += step)
+					{
+						if (tracedBefore(j, i))
+							continue;
+
+						Ray viewray;
+						makeViewRay(i, j, viewray);
+
+						//trace the scene using the view ray
+						//the default colour is the background colour, unless something is hit along the way
+						STATS_ADD(stats, primaryRays, 1);
+						m_frameBuffer.SetPixel(j, i, TracePixel(pScene, viewray, scenebg, j, i, tileCut));
+					}
+				}
 			}
-			glFlush();
+			else
+			{
+				RayPacket packet;
+				int pixelX[RAYPACKET_MAX_SIZE];
+				int pixelY[RAYPACKET_MAX_SIZE];
+
+				//traces the rays gathered so far and starts a new packet
+				auto tracePacket = [&]()
+				{
+					packet.Finish();
+					pScene->IntersectPacket(packet, m_precision, tileCut);
+
+					//the packet only finds what each ray hits, the hit details and shading
+					//come from the single ray code, as do all the rays spawned from there
+					for (int lane = 0; lane < packet.count; lane++)
+					{
+						Ray viewray = packet.GetRay(lane);
+						Colour colour = scenebg;
+
+						STATS_ADD(stats, primaryRays, 1);
+						STATS_ADD(stats, depthHistogram[0], 1);
+
+						RayHitResult result = pScene->IntersectPacketLane(packet, lane, viewray);
+						if (m_reprojection)
+							RecordPixel(pixelX[lane], pixelY[lane], viewray, result);
+						if (result.data)
+							colour = ShadeHit(pScene, viewray, result, scenebg, m_traceLevel);
+
+						m_frameBuffer.SetPixel(pixelX[lane], pixelY[lane], colour);
+					}
+
+					packet.Reset(m_packetSize);
+				};
+
+				//a packet takes a block of pixels on the pass grid, blocks with pixels
+				//traced by an earlier pass are topped up from the next block
+				int blockWidth = packetWidth * step;
+				int blockHeight = packetHeight * step;
+
+				packet.Reset(m_packetSize);
+
+				for (int y = firstOnGrid(tile.y0); y < tile.y1; y += blockHeight)
+				{
+					for (int x = firstOnGrid(tile.x0); x < tile.x1; x += blockWidth)
+					{
+						for (int i = y; i < y + blockHeight && i < tile.y1; i += step)
+						{
+							for (int j = x; j < x + blockWidth && j < tile.x1; j += step)
+							{
+								if (tracedBefore(j, i))
+									continue;
+
+								Ray viewray;
+								makeViewRay(i, j, viewray);
+
+								pixelX[packet.count] = j;
+								pixelY[packet.count] = i;
+								packet.AddRay(viewray.GetRayStart(), viewray.GetRay());
+
+								if (packet.count == m_packetSize)
+									tracePacket();
+							}
+						}
+					}
+				}
+
+				if (packet.count > 0)
+					tracePacket();
+			}
+
+			STATS_TILE_END(stats, workerStats[worker]);
+			s_lightSelections = nullptr;
+		});
+
+		//give the pixels left out of this pass the colour of their block
+		if (step > 1)
+			m_frameBuffer.FillBlocks(step);
+
+		//adaptive anti-aliasing, the edges are found in a copy of the one sample image
+		//so the pixels refined by one tile do not change what its neighbours see
+		if (step == 1 && m_aaGrid > 1 && !retraceOnly)
+		{
+			m_aaSource = m_frameBuffer;
+
+			m_scheduler.Run(area, [&](const RenderTile& tile, int worker)
+			{
+				STATS_TILE_BEGIN(stats);
+				s_lightSelections = &m_lightSelections[worker];
+
+				int grid = m_aaGrid;
+				double threshold = m_aaThreshold;
+
+				SceneCut cut;
+				const SceneCut* tileCut = nullptr;
+				bool culled = false;
+
+				for (int i = tile.y0; i < tile.y1; i++)
+				{
+					for (int j = tile.x0; j < tile.x1; j++)
+					{
+						Colour centre = m_aaSource.GetPixel(j, i);
+						bool edge = threshold == 0.0;
+
+						for (int y = std::max(i - 1, 0); y <= std::min(i + 1, m_buffHeight - 1) && !edge; y++)
+						{
+							for (int x = std::max(j - 1, 0); x <= std::min(j + 1, m_buffWidth - 1) && !edge; x++)
+							{
+								edge = ColoursDiffer(centre, m_aaSource.GetPixel(x, y), threshold);
+							}
+						}
+
+						if (!edge)
+							continue;
+
+						STATS_ADD(stats, antiAliasedPixels, 1);
+
+						//most tiles have no edges, the cut is only made for those that do
+						if (!culled)
+						{
+							tileCut = cullTile(tile, cut);
+							culled = true;
+						}
+
+						double sum[3] = { 0.0, 0.0, 0.0 };
+						bool vary = false;
+
+						//traces a sample jittered within the cell (cx, cy) of the pixel's grid and adds it to the sum
+						auto addSample = [&](int cx, int cy)
+						{
+							int cell = cy * grid + cx;
+							Ray viewray;
+							makeSampleRay(i + (cy + SampleJitter(j, i, cell * 2 + 1)) / grid,
+								j + (cx + SampleJitter(j, i, cell * 2)) / grid, viewray);
+
+							STATS_ADD(stats, primaryRays, 1);
+							Colour colour = TraceScene(pScene, viewray, scenebg, m_traceLevel, tileCut);
+
+							vary = vary || ColoursDiffer(colour, centre, threshold);
+							sum[0] += colour.red;
+							sum[1] += colour.green;
+							sum[2] += colour.blue;
+						};
+
+						//the corner cells first, they are enough to tell if the pixel varies
+						addSample(0, 0);
+						addSample(grid - 1, 0);
+						addSample(0, grid - 1);
+						addSample(grid - 1, grid - 1);
+
+						int samples = 4;
+
+						if (vary && grid > 2)
+						{
+							for (int cy = 0; cy < grid; cy++)
+							{
+								for (int cx = 0; cx < grid; cx++)
+								{
+									if ((cx == 0 || cx == grid - 1) && (cy == 0 || cy == grid - 1))
+										continue;
+
+									addSample(cx, cy);
+								}
+							}
+							samples = grid * grid;
+						}
+						else if (grid > 2)
+						{
+							//the corners alone leave the middle of the pixel out, the centre sample covers it
+							sum[0] += centre.red;
+							sum[1] += centre.green;
+							sum[2] += centre.blue;
+							samples++;
+						}
+
+						Colour colour;
+						colour.red = (float)(sum[0] / samples);
+						colour.green = (float)(sum[1] / samples);
+						colour.blue = (float)(sum[2] / samples);
+						m_frameBuffer.SetPixel(j, i, colour);
+					}
+				}
+
+				STATS_TILE_END(stats, workerStats[worker]);
+				s_lightSelections = nullptr;
+			});
+		}
+
+		phaseTimeMs[RenderStats::PHASE_TRACE] = lapTime();
+
+		RenderStats passStats = RenderStats();
+		for (size_t i = 0; i < workerStats.size(); i++)
+		{
+			passStats.Merge(workerStats[i]);
+		}
+
+		phaseTimeMs[RenderStats::PHASE_MERGE] = lapTime();
+
+		for (int i = 0; i < RenderStats::PHASE_COUNT; i++)
+		{
+			passStats.phaseTimeMs[i] = phaseTimeMs[i];
 		}
-		fprintf(stdout, "Done!!!\n");
+
+		std::chrono::duration<double, std::milli> traceTime = std::chrono::high_resolution_clock::now() - traceStart;
+		passStats.renderTimeMs = traceTime.count();
+
+		if (firstPass)
+			m_renderStats = passStats;
+		else
+			m_renderStats.Merge(passStats);
+
+		if (step > 1)
+		{
+			m_passStep = step;
+			if (m_verbose)
+				fprintf(stdout, "Pass %dx%d done.\n", step, step);
+			return true;
+		}
+
+		if (m_verbose)
+		{
+			fprintf(stdout, "Done!!!\n");
+			if (RenderStats::IsEnabled())
+			{
+				fprintf(stdout, "%llu rays, %llu intersection tests in %.1f ms\n",
+					m_renderStats.GetTotalRays(), m_renderStats.GetIntersectionTests(), m_renderStats.renderTimeMs);
+			}
+		}
+		m_passStep = 0;
+		m_reprojectPending = false;
 		m_renderCount++;
+		return true;
+	}
+	return false;
+}
+
+Colour RayTracer::TracePixel(Scene* pScene, Ray& ray, Colour incolour, int x, int y, const SceneCut* cut)
+{
+	if (!m_reprojection || m_traceLevel <= 0)
+		return TraceScene(pScene, ray, incolour, m_traceLevel, cut);
+
+	//as TraceScene, keeping the hit
+	STATS_THREAD(stats);
+	STATS_ADD(stats, depthHistogram[0], 1);
+
+	RayHitResult result = pScene->IntersectByRay(ray, cut);
+	RecordPixel(x, y, ray, result);
+
+	if (result.data)
+		return ShadeHit(pScene, ray, result, incolour, m_traceLevel);
+	return incolour;
+}
+
+bool RayTracer::Reproject(Scene* pScene)
+{
+	size_t pixelCount = (size_t)m_buffWidth * m_buffHeight;
+
+	if (!m_reprojection || m_pixelStates.size() != pixelCount
+		|| m_frameBuffer.GetWidth() != m_buffWidth || m_frameBuffer.GetHeight() != m_buffHeight)
+	{
+		ResetRenderCount();
+		return false;
+	}
+
+	Camera* cam = pScene->GetSceneCamera();
+
+	Vector3 camRightVector = cam->GetRightVector();
+	Vector3 camUpVector = cam->GetUpVector();
+	Vector3 camViewVector = cam->GetViewVector();
+	Vector3 centre = cam->GetViewCentre();
+	Vector3 camPosition = cam->GetPosition();
+	bool ortho = (m_traceflag & RayTracer::TRACE_ORTHO) != 0;
+
+	Vector3 start;
+	double pixelDX, pixelDY;
+	GetViewPlane(pScene, start, pixelDX, pixelDY);
+
+	//a point of the view plane is start + x * right * pixelDX + y * up * pixelDY, right and up are at right angles
+	double scaleX = 1.0 / (camRightVector.Norm_Sqr() * pixelDX);
+	double scaleY = 1.0 / (camUpVector.Norm_Sqr() * pixelDY);
+	double planeDistance = (centre - camPosition).DotProduct(camViewVector);
+
+	FrameBuffer image(m_buffWidth, m_buffHeight);
+	std::vector<Vector3> points(pixelCount);
+	std::vector<unsigned char> states(pixelCount, PIXEL_RETRACE);
+	std::vector<double> depths(pixelCount, FARFAR_AWAY * FARFAR_AWAY);
+
+	//splat every recorded point into the new view, the nearest wins
+	for (int y = 0; y < m_buffHeight; y++)
+	{
+		for (int x = 0; x < m_buffWidth; x++)
+		{
+			size_t index = (size_t)y * m_buffWidth + x;
+			if (m_pixelStates[index] != PIXEL_RECORDED && m_pixelStates[index] != PIXEL_MIRROR)
+				continue;
+
+			const Vector3& point = m_pixelPoints[index];
+			Vector3 offset = point - (ortho ? start : camPosition);
+			double depth = offset.DotProduct(camViewVector);
+
+			//behind the camera, or the view plane for an orthographic one
+			if (depth <= 0.0)
+				continue;
+
+			Vector3 onPlane = ortho ? point : camPosition + offset * (planeDistance / depth);
+			Vector3 fromStart = onPlane - start;
+			double px = fromStart.DotProduct(camRightVector) * scaleX;
+			double py = fromStart.DotProduct(camUpVector) * scaleY;
+
+			if (px < 0.0 || py < 0.0 || px >= m_buffWidth || py >= m_buffHeight)
+				continue;
+
+			size_t target = (size_t)py * m_buffWidth + (size_t)px;
+			if (depth >= depths[target])
+				continue;
+
+			depths[target] = depth;
+			points[target] = point;
+			states[target] = m_pixelStates[index];
+			image.SetPixel((int)px, (int)py, m_frameBuffer.GetPixel(x, y));
+		}
 	}
-	glFlush();
+
+	//a pixel well behind a neighbour may be something that was hidden seen through a gap
+	//between the points of the nearer surface, rather than what is really there
+	for (int y = 0; y < m_buffHeight; y++)
+	{
+		for (int x = 0; x < m_buffWidth; x++)
+		{
+			size_t index = (size_t)y * m_buffWidth + x;
+			if (states[index] == PIXEL_RETRACE)
+				continue;
+
+			//reflections move with the view, the old colour is only a stand in
+			if (states[index] == PIXEL_MIRROR)
+			{
+				states[index] = PIXEL_RETRACE;
+				continue;
+			}
+
+			double nearer = depths[index] * (1.0 - REPROJECT_DEPTH_TOLERANCE);
+
+			if ((x > 0 && depths[index - 1] < nearer)
+				|| (x < m_buffWidth - 1 && depths[index + 1] < nearer)
+				|| (y > 0 && depths[index - m_buffWidth] < nearer)
+				|| (y < m_buffHeight - 1 && depths[index + m_buffWidth] < nearer))
+			{
+				states[index] = PIXEL_RETRACE;
+			}
+		}
+	}
+
+	m_frameBuffer = image;
+	m_pixelPoints.swap(points);
+	m_pixelStates.swap(states);
+
+	m_renderCount = 0;
+	m_passStep = 0;
+	m_reprojectPending = true;
+	return true;
 }
 
-Colour RayTracer::TraceScene(Scene* pScene, Ray& ray, Colour incolour, int tracelevel, bool shadowray)
+Colour RayTracer::TraceScene(Scene* pScene, Ray& ray, Colour incolour, int tracelevel, const SceneCut* cut)
 {
 	RayHitResult result;
 	Colour outcolour = incolour;
-	std::vector<Light*>* light_list = pScene->GetLightList();
 
 	if (tracelevel <= 0) // reach the MAX depth of the recursion.
 	{
 		return outcolour;
 	}
 
-	result = pScene->IntersectByRay(ray, shadowray);
+	//the ray counts by kind are kept by the callers
+	STATS_THREAD(stats);
+	STATS_ADD(stats, depthHistogram[RenderStats::DepthBucket(m_traceLevel - tracelevel)], 1);
+
+	result = pScene->IntersectByRay(ray, cut);
 
 	if (result.data) //the ray has hit something
 	{
+		outcolour = ShadeHit(pScene, ray, result, incolour, tracelevel);
+	}
+	return outcolour;
+}
 
-		Vector3 start = ray.GetRayStart();
+void RayTracer::SelectLights(Scene* pScene, const Vector3& point, LightSelection& lights)
+{
+	pScene->SelectLights(point, m_lightBudget, lights);
 
-		if (!shadowray)
-		{
-			outcolour = CalculateLighting(light_list,
-				&start,
-				&result);
-		}
-		else // If the ray is a shadow ray, stops the shadow rays from being reflected/refracted.
-		{
-			outcolour.red /= 10;
-			outcolour.blue /= 10;
-			outcolour.green /= 10;
-			return outcolour;
-		}
+	STATS_THREAD(stats);
+	STATS_ADD(stats, shadedLights, lights.lights.size());
+	STATS_ADD(stats, droppedLights, lights.reaching - lights.lights.size());
+}
+
+Colour RayTracer::ShadeHit(Scene* pScene, Ray& ray, RayHitResult& result, Colour incolour, int tracelevel)
+{
+	Vector3 start = ray.GetRayStart();
+	STATS_THREAD(stats);
 
-		if (m_traceflag & TRACE_REFLECTION)
+	//the lights that reach the hit, the rest neither light nor shadow it; the render thread
+	//keeps a selection for each level, as the reflected and refracted rays shade hits of their own
+	int depth = m_traceLevel - tracelevel;
+	LightSelection local;
+	LightSelection& lights = s_lightSelections && depth >= 0 && depth < (int)s_lightSelections->size()
+		? (*s_lightSelections)[depth] : local;
+	SelectLights(pScene, result.point, lights);
+
+	Colour outcolour = CalculateLighting(lights,
+		&start,
+		&result);
+
+	if (m_traceflag & TRACE_REFLECTION)
+	{
+		//Only consider reflection for spheres and boxes
+		if (((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Sphere ||
+			((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Box)
 		{
-			//Only consider reflection for spheres and boxes
-			if (((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Sphere ||
-				((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Box)
-			{
-				//TODO: Calculate reflection ray based on the current intersection result
-				//Recursively call TraceScene with the reflection ray
-				//Combine the returned colour with the current surface colour 
-				// https://asalga.wordpress.com/2012/09/23/understanding-vector-reflection-visually/
-
-				Ray newRay;
-				newRay.SetRay(result.point, ray.GetRay().Reflect(result.normal));
-				Colour reflection = TraceScene(pScene, newRay, incolour, tracelevel - 1, shadowray);
-				Colour lights = CalculateLighting(light_list, &pScene->GetSceneCamera()->GetPosition(), &result);
-
-				outcolour.red *= reflection.red;
-				outcolour.green *= reflection.green;
-				outcolour.blue *= reflection.blue;
-			}
+			//TODO: Calculate reflection ray based on the current intersection result
+			//Recursively call TraceScene with the reflection ray
+			//Combine the returned colour with the current surface colour 
+			// https://asalga.wordpress.com/2012/09/23/understanding-vector-reflection-visually/
+
+			Ray newRay;
+			newRay.SetRay(result.point, ray.GetRay().Reflect(result.normal));
+			if (tracelevel - 1 > 0)
+				STATS_ADD(stats, reflectionRays, 1);
+			Colour reflection = TraceScene(pScene, newRay, incolour, tracelevel - 1);
+
+			outcolour.red *= reflection.red;
+			outcolour.green *= reflection.green;
+			outcolour.blue *= reflection.blue;
 		}
+	}
 
-		if (m_traceflag & TRACE_REFRACTION)
+	if (m_traceflag & TRACE_REFRACTION)
+	{
+		//Only consider refraction for spheres and boxes
+		if (((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Sphere ||
+			((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Box)
 		{
-			//Only consider refraction for spheres and boxes
-			if (((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Sphere ||
-				((Primitive*)result.data)->m_primtype == Primitive::PRIMTYPE_Box)
-			{
-				//TODO: Calculate refraction ray based on the current intersection result
-				//Recursively call TraceScene with the reflection ray
-				//Combine the returned colour with the current surface colour
-				//FUCKIN SNELLS LAW http://hyperphysics.phy-astr.gsu.edu/hbase/geoopt/imggo/snell2.gif
-
-				float coeff = 1 / 1.5;
-				Vector3 refractedVector = ray.GetRay().Refract(result.normal, coeff);
-				Ray newRay1;
-				newRay1.SetRay(result.point + (refractedVector * 0.1), refractedVector);
-
-				Colour refraction = TraceScene(pScene, newRay1, incolour, tracelevel - 1, shadowray);
-				Colour lights = CalculateLighting(light_list, &start, &result);
-
-				outcolour.red *= refraction.red;
-				outcolour.green *= refraction.green;
-				outcolour.blue *= refraction.blue;
-			}
+			//TODO: Calculate refraction ray based on the current intersection result
+			//Recursively call TraceScene with the reflection ray
+			//Combine the returned colour with the current surface colour
+			//FUCKIN SNELLS LAW http://hyperphysics.phy-astr.gsu.edu/hbase/geoopt/imggo/snell2.gif
+
+			float coeff = 1 / 1.5;
+			Vector3 refractedVector = ray.GetRay().Refract(result.normal, coeff);
+			Ray newRay1;
+			newRay1.SetRay(result.point + (refractedVector * 0.1), refractedVector);
+			if (tracelevel - 1 > 0)
+				STATS_ADD(stats, refractionRays, 1);
+
+			Colour refraction = TraceScene(pScene, newRay1, incolour, tracelevel - 1);
+
+			outcolour.red *= refraction.red;
+			outcolour.green *= refraction.green;
+			outcolour.blue *= refraction.blue;
 		}
-		
-		//////Check if this is in shadow
-		if ( m_traceflag & TRACE_SHADOW )
+	}
+	
+	//////Check if this is in shadow
+	//shadow rays take up a trace level like any other ray, so there are none on the last level
+	if ((m_traceflag & TRACE_SHADOW) && tracelevel - 1 > 0)
+	{
+		for (int l = 0; l < (int)lights.lights.size(); l++)
 		{
-			std::vector<Light*>::iterator lit_iter = light_list->begin();
-			while (lit_iter != light_list->end())
+			Vector3 lightPos = lights.lights[l].light->GetLightPosition();
+			Vector3 shadowDir = /*result.point - lightPos*/ lightPos - result.point;
+			shadowDir = shadowDir.Normalise();
+
+			Ray newRay;
+			newRay.SetRay(result.point + (shadowDir * 0.1), shadowDir);
+
+			//only objects between the surface and the light cast a shadow
+			double lightDistance = (lightPos - newRay.GetRayStart()).DotProduct(shadowDir);
+
+			STATS_ADD(stats, shadowRays, 1);
+			if (pScene->Occluded(newRay, lightDistance, m_shadowCache ? lights.lights[l].index : -1, m_traceLevel - tracelevel))
 			{
-				//TODO: Calculate the shadow ray using the current intersection result and the light position
-				//Recursively call TraceScene with the shadow ray
-				
-				Vector3 lightPos = (*lit_iter)->GetLightPosition();
-				Vector3 shadowDir = /*result.point - lightPos*/ lightPos - result.point;
-				shadowDir = shadowDir.Normalise();
-
-				Ray newRay;
-				newRay.SetRay(result.point + (shadowDir * 0.1), shadowDir);
-				outcolour = TraceScene(pScene, newRay, outcolour, tracelevel - 1, true);
-				lit_iter++;
+				STATS_ADD(stats, occludedShadowRays, 1);
+
+				//each light that is blocked darkens the surface
+				outcolour.red /= 10;
+				outcolour.blue /= 10;
+				outcolour.green /= 10;
 			}
 		}
-	}		
+	}
+
 	return outcolour;
 }
 
-Colour RayTracer::CalculateLighting(std::vector<Light*>* lights, Vector3* campos, RayHitResult* hitresult)
+Colour RayTracer::CalculateLighting(const LightSelection& lights, Vector3* campos, RayHitResult* hitresult)
 {
 	Colour outcolour;
-	std::vector<Light*>::iterator lit_iter = lights->begin();
 
 	//Retrive the material for the intersected primitive
 	Primitive* prim = (Primitive*)hitresult->data;
@@ -288,9 +980,9 @@ Colour RayTracer::CalculateLighting(std::vector<Light*>* lights, Vector3* campos
 	//and calculate the lighting at the intersection point
 	if (m_traceflag & TRACE_DIFFUSE_AND_SPEC)
 	{
-		while (lit_iter != lights->end())
+		for (int l = 0; l < (int)lights.lights.size(); l++)
 		{
-			Vector3 light_pos = (*lit_iter)->GetLightPosition();  //position of the light source
+			Vector3 light_pos = lights.lights[l].light->GetLightPosition();  //position of the light source
 			Vector3 normal = hitresult->normal; //surface normal at intersection
 			Vector3 surface_point = hitresult->point; //location of the intersection on the surface
 			
@@ -309,11 +1001,14 @@ Colour RayTracer::CalculateLighting(std::vector<Light*>* lights, Vector3* campos
 			// Caculate diffuse
 			// rd = kd * ld * cosTheta where kd = surface diffuse colour and ld = light diffuse colour.
 			Colour matDiff = mat->GetDiffuseColour();
-			Colour lightColour= (*lit_iter)->GetLightColour();
+			Colour lightColour= lights.lights[l].light->GetLightColour();
+			lightColour.red *= lights.lights[l].influence; /* Lights with a radius fade towards its edge. */
+			lightColour.green *= lights.lights[l].influence;
+			lightColour.blue *= lights.lights[l].influence;
 			Colour diffuse;
 
 			double dotProdLight = lightDir.DotProduct(normal);
-			dotProdLight = min(max(dotProdLight, 0.0), 1.0); /* Anchors dotProdLight to between 0 and 1. */
+			dotProdLight = std::min(std::max(dotProdLight, 0.0), 1.0); /* Anchors dotProdLight to between 0 and 1. */
 
 			diffuse.red = matDiff.red * lightColour.red * dotProdLight;
 			diffuse.blue = matDiff.blue * lightColour.blue * dotProdLight;
@@ -325,7 +1020,7 @@ Colour RayTracer::CalculateLighting(std::vector<Light*>* lights, Vector3* campos
 			Colour specular;
 			double intensity = mat->GetSpecPower();
 			double dotProdHalf = halfVec.DotProduct(normal);
-			dotProdHalf = min(max(dotProdHalf, 0.0), 1.0); /* Anchors dotProdHalf to between 0 and 1. */
+			dotProdHalf = std::min(std::max(dotProdHalf, 0.0), 1.0); /* Anchors dotProdHalf to between 0 and 1. */
 
 			specular.red = matSpec.red * lightColour.red * pow(dotProdHalf, intensity);
 			specular.blue = matSpec.blue * lightColour.blue * pow(dotProdHalf, intensity);
@@ -335,8 +1030,6 @@ Colour RayTracer::CalculateLighting(std::vector<Light*>* lights, Vector3* campos
 			outcolour.red += (diffuse.red + specular.red);
 			outcolour.blue += (diffuse.blue + specular.blue);
 			outcolour.green += (diffuse.green + specular.green);
-
-			lit_iter++;
 		}
 	}
 
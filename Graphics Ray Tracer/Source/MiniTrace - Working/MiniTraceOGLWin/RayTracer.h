@@ -9,9 +9,20 @@
 ---------------------------------------------------------------------*/
 #pragma once
 
+#include <algorithm>
+
+#include "FrameBuffer.h"
 #include "Material.h"
 #include "Ray.h"
+#include "RenderStats.h"
 #include "Scene.h"
+#include "TileScheduler.h"
+#include "Wavefront.h"
+
+#define PROGRESSIVE_FIRST_STEP	8	//pixel spacing of the first progressive pass, a power of two
+#define AA_DEFAULT_THRESHOLD	0.1	//colour difference, in any channel, that makes a pixel worth more samples
+#define AA_MAX_GRID				8	//anti-aliasing takes at most 8x8 samples per pixel
+#define REPROJECT_DEPTH_TOLERANCE	0.1	//a reprojected pixel this much deeper than a neighbour, relatively, is traced again
 
 class RayTracer
 {
@@ -20,6 +31,61 @@ class RayTracer
 		int				m_buffHeight;
 		int				m_renderCount;
 		int				m_traceLevel;
+		bool			m_verbose;
+		int				m_packetSize;		//primary rays traced together, 0 traces them one at a time
+		bool			m_progressive;
+		int				m_passStep;			//pixel spacing of the last progressive pass, 0 before the first
+		bool			m_wavefront;
+		RayPrecision	m_precision;		//of the packet intersection tests
+		int				m_aaGrid;			//a pixel takes up to m_aaGrid x m_aaGrid samples, 1 turns anti-aliasing off
+		double			m_aaThreshold;
+		int				m_lightBudget;		//most lights shading a hit, 0 for no limit
+		bool			m_shadowCache;		//shadow rays test their light's last blocker first
+		bool			m_tileCulling;		//primary rays only look at what their tile's frustum holds
+		bool			m_hasRegion;
+		RenderTile		m_region;			//the part of the framebuffer DoRayTrace traces, if m_hasRegion
+		bool			m_reprojection;		//record what each pixel sees, for Reproject
+		bool			m_reprojectPending;	//the next DoRayTrace only traces the pixels Reproject could not fill
+
+		TileScheduler		m_scheduler;		//hands framebuffer tiles to the render threads
+		FrameBuffer			m_frameBuffer;		//the traced image, bottom row first
+		FrameBuffer			m_aaSource;			//the one sample image the anti-aliasing pass compares pixels in
+		std::vector<Wavefront>	m_wavefronts;	//ray queues of each render thread, kept between renders
+		std::vector<std::vector<LightSelection> >	m_lightSelections;	//lights shading the hits of each render thread
+															//at each trace level, kept between renders
+		RenderStats			m_renderStats;		//counters of the last render, summed over its passes
+
+		enum PixelState
+		{
+			PIXEL_EMPTY = 0,	//nothing recorded
+			PIXEL_RECORDED,		//m_pixelPoints holds what the pixel shows
+			PIXEL_MIRROR,		//recorded, but the pixel shows a reflection or refraction so its colour depends on the view
+			PIXEL_RETRACE,		//to be traced by the next DoRayTrace after a Reproject
+		};
+
+		std::vector<Vector3>		m_pixelPoints;	//the point the ray through each pixel centre hit, far along the ray for a miss
+		std::vector<unsigned char>	m_pixelStates;	//PixelState of each pixel, bottom row first
+
+		//the bottom left corner of the view plane and the size of a pixel on it
+		void GetViewPlane(Scene* pScene, Vector3& start, double& pixelDX, double& pixelDY) const;
+
+		inline void RecordPixel(int x, int y, Ray& ray, const RayHitResult& result)
+		{
+			size_t index = (size_t)y * m_buffWidth + x;
+			m_pixelPoints[index] = result.data ? result.point : ray.GetRayStart() + ray.GetRay() * FARFAR_AWAY;
+			m_pixelStates[index] = PIXEL_RECORDED;
+
+			//as in ShadeHit, only spheres and boxes reflect and refract
+			if (result.data && (m_traceflag & (TRACE_REFLECTION | TRACE_REFRACTION)))
+			{
+				Primitive::PRIMTYPE type = ((Primitive*)result.data)->m_primtype;
+				if (type == Primitive::PRIMTYPE_Sphere || type == Primitive::PRIMTYPE_Box)
+					m_pixelStates[index] = PIXEL_MIRROR;
+			}
+		}
+
+		//TraceScene for the primary ray of pixel (x, y), recording what it hits for Reproject
+		Colour TracePixel(Scene* pScene, Ray& ray, Colour incolour, int x, int y, const SceneCut* cut = nullptr);
 
 	public:
 		
@@ -44,13 +110,250 @@ class RayTracer
 			m_traceLevel = level;
 		}
 
+		inline int GetTraceLevel() const
+		{
+			return m_traceLevel;
+		}
+
+		//Print progress messages to stdout
+		inline void SetVerbose(bool verbose)
+		{
+			m_verbose = verbose;
+		}
+
 		inline void ResetRenderCount()
 		{
 			m_renderCount = 0;
+			m_passStep = 0;
+			m_reprojectPending = false;
+		}
+
+		//In progressive mode each DoRayTrace traces one pass, coarse to fine: one pixel in every
+		//8x8 block first, then the pixels new to the 4x4, 2x2 and 1x1 grids. No pixel is traced
+		//twice and the untraced pixels of a pass are filled from the pixel of their block,
+		//so every pass leaves a complete preview. The last pass gives the same image as a full render.
+		inline void SetProgressive(bool progressive)
+		{
+			m_progressive = progressive;
+			m_passStep = 0;
+		}
+
+		inline bool IsProgressive() const
+		{
+			return m_progressive;
+		}
+
+		//True once the framebuffer holds the finished image, not a progressive preview.
+		//After a Reproject it is true once the pixels that could not be reused are traced.
+		inline bool IsRenderComplete() const
+		{
+			return m_renderCount > 0;
+		}
+
+		//Number of render threads, 0 uses one thread per hardware core.
+		//The image is the same whatever the thread count.
+		inline void SetThreadCount(int count)
+		{
+			m_scheduler.SetThreadCount(count);
+		}
+
+		inline int GetThreadCount() const
+		{
+			return m_scheduler.GetThreadCount();
+		}
+
+		inline void SetTileSize(int size)
+		{
+			m_scheduler.SetTileSize(size);
+		}
+
+		//Traces primary rays in packets of 4, 8 or 16 using the SIMD intersection kernels,
+		//0 turns packets off. Secondary and shadow rays are always traced one at a time.
+		//The image is the same either way. Returns false for an unsupported size.
+		bool SetPacketSize(int size);
+
+		inline int GetPacketSize() const
+		{
+			return m_packetSize;
+		}
+
+		//Runs the packet intersection tests in float or double, double by default.
+		//Only the choice of what each packet ray hits is made in float, the hit and
+		//everything after it is worked out in double. Has no effect without packets.
+		inline void SetPrecision(RayPrecision precision)
+		{
+			m_precision = precision;
+		}
+
+		inline RayPrecision GetPrecision() const
+		{
+			return m_precision;
+		}
+
+		//Adaptive anti-aliasing. Once every pixel has its sample through the centre, a pixel that
+		//differs from one of its eight neighbours by at least threshold, in any colour channel,
+		//is sampled again at the four corner cells of a grid of maxSamples stratified cells.
+		//If those samples and the centre still differ by threshold the rest of the grid is
+		//traced and the pixel is the mean of the grid; otherwise it is the mean of the five.
+		//Each sample is jittered within its cell by a hash of the pixel, so the image does not
+		//depend on the thread count. maxSamples must be a square, 4 to 64; 1 turns it off.
+		//A threshold of 0 samples every pixel's whole grid, i.e. uniform supersampling.
+		//The extra samples are traced one ray at a time whatever the packet and wavefront settings.
+		//In progressive mode the anti-aliasing is part of the last pass.
+		//Returns false if maxSamples is not supported.
+		bool SetAntiAliasing(int maxSamples, double threshold = AA_DEFAULT_THRESHOLD);
+
+		//The most samples a pixel takes, 1 without anti-aliasing
+		inline int GetAntiAliasing() const
+		{
+			return m_aaGrid * m_aaGrid;
+		}
+
+		inline double GetAntiAliasingThreshold() const
+		{
+			return m_aaThreshold;
+		}
+
+		//Each hit is shaded by at most this many lights, the most important of those that reach
+		//it (see LightTree). Lights past the budget are left out of the lighting and the shadows.
+		//0, the default, means no budget: every light that reaches a hit shades it.
+		inline void SetLightBudget(int budget)
+		{
+			m_lightBudget = std::max(budget, 0);
+		}
+
+		inline int GetLightBudget() const
+		{
+			return m_lightBudget;
+		}
+
+		//Shadow rays to a light test first the object that last blocked one to it on the same
+		//thread (see Scene::Occluded). It never changes the image, only the time. On by default.
+		inline void SetShadowCache(bool cache)
+		{
+			m_shadowCache = cache;
+		}
+
+		inline bool IsShadowCache() const
+		{
+			return m_shadowCache;
+		}
+
+		//Each tile finds once what the frustum through its pixels holds (see Scene::Cull), and its
+		//primary rays, anti-aliasing samples included, test only that. Packets (SetPacketSize) only
+		//leave out the planes; they still walk the whole BVH, so they gain far less. The image is
+		//the same either way. On by default.
+		inline void SetTileCulling(bool culling)
+		{
+			m_tileCulling = culling;
+		}
+
+		inline bool IsTileCulling() const
+		{
+			return m_tileCulling;
+		}
+
+		//Limits DoRayTrace to the pixels [x0, x1) by [y0, y1); the rest of the framebuffer keeps
+		//what it held before. The pixels traced are exactly those of a full render, anti-aliasing
+		//included, which traces the one sample image a pixel further round the region to find edges.
+		inline void SetRegion(const RenderTile& region)
+		{
+			m_region = region;
+			m_hasRegion = true;
+		}
+
+		//DoRayTrace traces the whole image again
+		inline void ClearRegion()
+		{
+			m_hasRegion = false;
+		}
+
+		inline int GetWidth() const
+		{
+			return m_buffWidth;
+		}
+
+		inline int GetHeight() const
+		{
+			return m_buffHeight;
+		}
+
+		//Traces each tile one bounce level at a time through a Wavefront rather than
+		//recursing through TraceScene for every pixel. The image is the same either way.
+		inline void SetWavefront(bool wavefront)
+		{
+			m_wavefront = wavefront;
+		}
+
+		inline bool IsWavefront() const
+		{
+			return m_wavefront;
+		}
+
+		//Records the point each pixel's centre ray hits as the image is traced, so that after
+		//the camera moves Reproject can reuse the image. Costs a point and a byte per pixel, and
+		//the wavefront mode has to intersect the primary rays again to find their hits.
+		inline void SetReprojection(bool reprojection)
+		{
+			m_reprojection = reprojection;
+			m_reprojectPending = false;
+			m_pixelPoints.clear();
+			m_pixelStates.clear();
+		}
+
+		inline bool IsReprojection() const
+		{
+			return m_reprojection;
+		}
+
+		//Call after moving the scene's camera instead of ResetRenderCount. The recorded points
+		//of the last image are projected into the new view, nearest first where they land on the
+		//same pixel, and carry their colour with them. The next DoRayTrace traces only the
+		//pixels nothing landed on, those much deeper than a neighbour, which are likely to
+		//show something that was hidden before, and those showing a reflection or refraction,
+		//with one ray each and no anti-aliasing. The other colours do not change with the view,
+		//so highlights are those of the old one: use ResetRenderCount for the exact image once
+		//the camera stops.
+		//Returns false, and resets the render count, if nothing was recorded to reuse.
+		bool Reproject(Scene* pScene);
+
+		//The point recorded for pixel (x, y), false if there is none
+		inline bool GetPixelPoint(int x, int y, Vector3& point) const
+		{
+			size_t index = (size_t)y * m_buffWidth + x;
+
+			if (x < 0 || y < 0 || x >= m_buffWidth || y >= m_buffHeight || index >= m_pixelStates.size()
+				|| (m_pixelStates[index] != PIXEL_RECORDED && m_pixelStates[index] != PIXEL_MIRROR))
+				return false;
+
+			point = m_pixelPoints[index];
+			return true;
+		}
+
+		//The height of a pixel in world units at depth along the camera's view, the same at any depth for an orthographic view
+		double GetPixelSize(Scene* pScene, double depth) const;
+
+		//The result of the last DoRayTrace. Use an ImageWriter to save it
+		//or upload it to a texture or the GL framebuffer to display it.
+		inline const FrameBuffer& GetFrameBuffer() const
+		{
+			return m_frameBuffer;
+		}
+
+		inline const RenderStats& GetRenderStats() const
+		{
+			return m_renderStats;
 		}
 
-		void DoRayTrace( Scene* pScene );
-		Colour TraceScene(Scene* pScene, Ray& ray, Colour incolour, int tracelevel, bool shadowray = false);
-		Colour CalculateLighting(std::vector<Light*>* lights, Vector3* campos, RayHitResult* hitresult);
+		//Traces the scene into the framebuffer, returns true if the image changed.
+		//In progressive mode call it until IsRenderComplete to finish the image.
+		bool DoRayTrace( Scene* pScene );
+		//A cut, from Scene::Cull, is only for primary rays inside its frustum
+		Colour TraceScene(Scene* pScene, Ray& ray, Colour incolour, int tracelevel, const SceneCut* cut = nullptr);
+		//Colour of a hit found by ray: lighting, reflection, refraction and shadows
+		Colour ShadeHit(Scene* pScene, Ray& ray, RayHitResult& result, Colour incolour, int tracelevel);
+		//The lights that shade the point, within the light budget
+		void SelectLights(Scene* pScene, const Vector3& point, LightSelection& lights);
+		Colour CalculateLighting(const LightSelection& lights, Vector3* campos, RayHitResult* hitresult);
 };
 
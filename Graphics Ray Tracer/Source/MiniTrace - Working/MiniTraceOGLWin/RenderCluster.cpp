@@ -0,0 +1,505 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "RenderCluster.h"
+#include "SceneSerializer.h"
+
+#define CLUSTER_PROTOCOL_VERSION	1
+#define CLUSTER_MAX_MESSAGE_SIZE	(1u << 30)	//largest body either end sends or takes, 1 GiB
+#define CLUSTER_MAX_IMAGE_SIZE		16384		//widest and tallest image a worker renders
+
+//Every message is a header followed by size bytes of body.
+//The bodies are the structs below as they are in memory, so both ends must be the same build.
+enum MessageType
+{
+	MSG_HELLO = 1,		//worker to coordinator: uint32 protocol version
+	MSG_SCENE,			//RenderSettings then a SceneSerializer snapshot
+	MSG_TILE,			//TileMessage, the tile to trace
+	MSG_RESULT,			//TileMessage, RenderStats then the tile's pixels, rows bottom first
+	MSG_QUIT			//no body
+};
+
+struct MessageHeader
+{
+	uint32_t	type;
+	uint32_t	size;
+};
+
+struct RenderSettings
+{
+	int32_t		width;
+	int32_t		height;
+	int32_t		traceLevel;
+	int32_t		traceFlags;
+	int32_t		packetSize;
+	int32_t		wavefront;
+	int32_t		precision;
+	int32_t		aaSamples;
+	double		aaThreshold;
+	int32_t		lightBudget;
+	int32_t		shadowCache;
+	int32_t		tileCulling;
+};
+
+struct TileMessage
+{
+	int32_t		x0, y0;
+	int32_t		x1, y1;
+};
+
+//Sends a message whose body is the two parts one after the other
+static bool WriteMessage(Socket& socket, MessageType type, const void* part0 = NULL, size_t size0 = 0,
+	const void* part1 = NULL, size_t size1 = 0)
+{
+	if (size0 + size1 > CLUSTER_MAX_MESSAGE_SIZE)
+		return false;
+
+	MessageHeader header;
+	header.type = type;
+	header.size = (uint32_t)(size0 + size1);
+
+	return socket.Send(&header, sizeof(header))
+		&& (size0 == 0 || socket.Send(part0, size0))
+		&& (size1 == 0 || socket.Send(part1, size1));
+}
+
+static size_t TilePixelCount(const TileMessage& tile)
+{
+	return (size_t)(tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+}
+
+RenderCoordinator::RenderCoordinator()
+{
+	m_tileSize = CLUSTER_DEFAULT_TILE_SIZE;
+	m_timeoutMs = CLUSTER_DEFAULT_TIMEOUT;
+	m_renderStats.Reset();
+	m_tilesRedispatched = 0;
+	m_workersLost = 0;
+	m_localTiles = 0;
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+	Shutdown();
+}
+
+bool RenderCoordinator::Listen(const char* address, int port)
+{
+	return m_listener.Listen(address, port);
+}
+
+int RenderCoordinator::AcceptWorkers(int count, int timeoutMs)
+{
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+	while ((int)m_workers.size() < count)
+	{
+		int left = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if (left <= 0)
+			break;
+
+		Socket* worker = new Socket();
+		MessageHeader header;
+		uint32_t version = 0;
+
+		//a connection that does not greet with the right version is not one of ours
+		if (!m_listener.Accept(*worker, left))
+		{
+			delete worker;
+			break;
+		}
+
+		worker->SetReceiveTimeout(left);
+		if (!worker->Receive(&header, sizeof(header)) || header.type != MSG_HELLO || header.size != sizeof(version)
+			|| !worker->Receive(&version, sizeof(version)) || version != CLUSTER_PROTOCOL_VERSION)
+		{
+			delete worker;
+			continue;
+		}
+
+		m_workers.push_back(worker);
+	}
+
+	return (int)m_workers.size();
+}
+
+bool RenderCoordinator::Render(RayTracer& tracer, Scene& scene, FrameBuffer& image)
+{
+	std::chrono::high_resolution_clock::time_point renderStart = std::chrono::high_resolution_clock::now();
+
+	int width = tracer.GetWidth();
+	int height = tracer.GetHeight();
+
+	m_renderStats.Reset();
+	m_tilesRedispatched = 0;
+	m_workersLost = 0;
+	m_localTiles = 0;
+
+	image.Resize(width, height);
+
+	RenderSettings settings;
+	settings.width = width;
+	settings.height = height;
+	settings.traceLevel = tracer.GetTraceLevel();
+	settings.traceFlags = tracer.m_traceflag;
+	settings.packetSize = tracer.GetPacketSize();
+	settings.wavefront = tracer.IsWavefront() ? 1 : 0;
+	settings.precision = tracer.GetPrecision();
+	settings.aaSamples = tracer.GetAntiAliasing();
+	settings.aaThreshold = tracer.GetAntiAliasingThreshold();
+	settings.lightBudget = tracer.GetLightBudget();
+	settings.shadowCache = tracer.IsShadowCache() ? 1 : 0;
+	settings.tileCulling = tracer.IsTileCulling() ? 1 : 0;
+
+	std::vector<char> snapshot;
+	SceneSerializer::Write(scene, snapshot);
+
+	std::deque<RenderTile> queue;
+	for (int y = 0; y < height; y += m_tileSize)
+	{
+		for (int x = 0; x < width; x += m_tileSize)
+		{
+			RenderTile tile;
+			tile.x0 = x;
+			tile.y0 = y;
+			tile.x1 = x + m_tileSize < width ? x + m_tileSize : width;
+			tile.y1 = y + m_tileSize < height ? y + m_tileSize : height;
+			queue.push_back(tile);
+		}
+	}
+
+	std::mutex lock;
+	std::condition_variable changed;
+	size_t remaining = queue.size();
+
+	//one thread per worker sends it the scene, then feeds it tiles until none are left or it fails
+	auto serve = [&](Socket* worker)
+	{
+		std::vector<float> pixels;
+		bool ok = WriteMessage(*worker, MSG_SCENE, &settings, sizeof(settings), snapshot.data(), snapshot.size());
+
+		worker->SetReceiveTimeout(m_timeoutMs);
+
+		while (ok)
+		{
+			RenderTile tile;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				changed.wait(guard, [&]() { return !queue.empty() || remaining == 0; });
+
+				if (queue.empty())
+					return;
+
+				tile = queue.front();
+				queue.pop_front();
+			}
+
+			TileMessage sent = { tile.x0, tile.y0, tile.x1, tile.y1 };
+			TileMessage received;
+			RenderStats stats;
+			MessageHeader header;
+			size_t pixelCount = TilePixelCount(sent);
+
+			pixels.resize(pixelCount * 3);
+
+			ok = WriteMessage(*worker, MSG_TILE, &sent, sizeof(sent))
+				&& worker->Receive(&header, sizeof(header))
+				&& header.type == MSG_RESULT
+				&& header.size == sizeof(received) + sizeof(stats) + pixels.size() * sizeof(float)
+				&& worker->Receive(&received, sizeof(received))
+				&& memcmp(&received, &sent, sizeof(sent)) == 0
+				&& worker->Receive(&stats, sizeof(stats))
+				&& worker->Receive(pixels.data(), pixels.size() * sizeof(float));
+
+			if (!ok)
+			{
+				//the tile goes to the front so the image still fills in roughly in order
+				std::lock_guard<std::mutex> guard(lock);
+				queue.push_front(tile);
+				m_tilesRedispatched++;
+				changed.notify_all();
+				break;
+			}
+
+			const float* pixel = pixels.data();
+			for (int i = tile.y0; i < tile.y1; i++)
+			{
+				for (int j = tile.x0; j < tile.x1; j++, pixel += 3)
+				{
+					Colour colour;
+					colour.red = pixel[0];
+					colour.green = pixel[1];
+					colour.blue = pixel[2];
+					image.SetPixel(j, i, colour);
+				}
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			m_renderStats.Merge(stats);
+			remaining--;
+			if (remaining == 0)
+				changed.notify_all();
+		}
+
+		std::lock_guard<std::mutex> guard(lock);
+		m_workersLost++;
+		worker->Close();
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		threads.push_back(std::thread(serve, m_workers[i]));
+	}
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		threads[i].join();
+	}
+
+	//forget the workers that failed
+	std::vector<Socket*>::iterator worker_iter = m_workers.begin();
+	while (worker_iter != m_workers.end())
+	{
+		if ((*worker_iter)->IsOpen())
+		{
+			worker_iter++;
+			continue;
+		}
+
+		delete *worker_iter;
+		worker_iter = m_workers.erase(worker_iter);
+	}
+
+	//with every worker gone the rest of the tiles are traced here
+	bool progressive = tracer.IsProgressive();
+	tracer.SetProgressive(false);
+
+	while (!queue.empty())
+	{
+		RenderTile tile = queue.front();
+		queue.pop_front();
+
+		tracer.SetRegion(tile);
+		tracer.ResetRenderCount();
+		tracer.DoRayTrace(&scene);
+		m_renderStats.Merge(tracer.GetRenderStats());
+		m_localTiles++;
+
+		const FrameBuffer& traced = tracer.GetFrameBuffer();
+		for (int i = tile.y0; i < tile.y1; i++)
+		{
+			for (int j = tile.x0; j < tile.x1; j++)
+			{
+				image.SetPixel(j, i, traced.GetPixel(j, i));
+			}
+		}
+	}
+
+	tracer.ClearRegion();
+	tracer.ResetRenderCount();
+	tracer.SetProgressive(progressive);
+
+	//the merged times are summed over the tiles, the render time is the coordinator's wall clock
+	std::chrono::duration<double, std::milli> renderTime = std::chrono::high_resolution_clock::now() - renderStart;
+	m_renderStats.renderTimeMs = renderTime.count();
+
+	return m_localTiles == 0;
+}
+
+void RenderCoordinator::Shutdown()
+{
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		WriteMessage(*m_workers[i], MSG_QUIT);
+		delete m_workers[i];
+	}
+
+	m_workers.clear();
+	m_listener.Close();
+}
+
+RenderWorker::RenderWorker()
+{
+	m_threadCount = 0;
+	m_failAfter = -1;
+	m_tilesDone = 0;
+}
+
+bool RenderWorker::Run(const char* host, int port, std::string& error)
+{
+	Socket socket;
+	uint32_t version = CLUSTER_PROTOCOL_VERSION;
+
+	if (!socket.Connect(host, port) || !WriteMessage(socket, MSG_HELLO, &version, sizeof(version)))
+	{
+		error = "cannot connect to " + std::string(host) + ":" + std::to_string(port);
+		return false;
+	}
+
+	Scene scene;
+	RayTracer* tracer = nullptr;
+	std::vector<char> body;
+	std::vector<float> pixels;
+	bool ok = true;
+
+	error = "connection to the coordinator lost";
+
+	while (ok)
+	{
+		MessageHeader header;
+
+		if (!socket.Receive(&header, sizeof(header)))
+			break;
+
+		if (header.size > CLUSTER_MAX_MESSAGE_SIZE)
+		{
+			error = "message of " + std::to_string(header.size) + " bytes is too big";
+			ok = false;
+			break;
+		}
+
+		body.resize(header.size);
+		if (header.size > 0 && !socket.Receive(body.data(), body.size()))
+			break;
+
+		if (header.type == MSG_QUIT)
+		{
+			error.clear();
+			break;
+		}
+		else if (header.type == MSG_SCENE)
+		{
+			RenderSettings settings;
+
+			if (body.size() < sizeof(settings))
+			{
+				error = "bad scene message";
+				ok = false;
+				break;
+			}
+
+			memcpy(&settings, body.data(), sizeof(settings));
+			if (settings.width <= 0 || settings.height <= 0
+				|| settings.width > CLUSTER_MAX_IMAGE_SIZE || settings.height > CLUSTER_MAX_IMAGE_SIZE)
+			{
+				error = "bad image size " + std::to_string(settings.width) + "x" + std::to_string(settings.height);
+				ok = false;
+				break;
+			}
+
+			if (settings.precision != PRECISION_DOUBLE && settings.precision != PRECISION_FLOAT)
+			{
+				error = "bad precision " + std::to_string(settings.precision);
+				ok = false;
+				break;
+			}
+
+			if (!SceneSerializer::Read(body.data() + sizeof(settings), body.size() - sizeof(settings), scene, error))
+			{
+				ok = false;
+				break;
+			}
+
+			delete tracer;
+			tracer = new RayTracer(settings.width, settings.height);
+			tracer->SetVerbose(false);
+			tracer->SetThreadCount(m_threadCount);
+			tracer->SetTraceLevel(settings.traceLevel);
+			tracer->m_traceflag = (RayTracer::TraceFlag)settings.traceFlags;
+			tracer->SetWavefront(settings.wavefront != 0);
+			tracer->SetPrecision((RayPrecision)settings.precision);
+			tracer->SetLightBudget(settings.lightBudget);
+			tracer->SetShadowCache(settings.shadowCache != 0);
+			tracer->SetTileCulling(settings.tileCulling != 0);
+
+			if (!tracer->SetPacketSize(settings.packetSize))
+			{
+				error = "bad packet size " + std::to_string(settings.packetSize);
+				ok = false;
+				break;
+			}
+
+			if (!tracer->SetAntiAliasing(settings.aaSamples, settings.aaThreshold))
+			{
+				error = "bad anti-aliasing of " + std::to_string(settings.aaSamples) + " samples";
+				ok = false;
+				break;
+			}
+
+			error = "connection to the coordinator lost";
+		}
+		else if (header.type == MSG_TILE && tracer && body.size() == sizeof(TileMessage))
+		{
+			TileMessage tile;
+			memcpy(&tile, body.data(), sizeof(tile));
+
+			if (tile.x0 < 0 || tile.y0 < 0 || tile.x1 > tracer->GetWidth() || tile.y1 > tracer->GetHeight()
+				|| tile.x0 >= tile.x1 || tile.y0 >= tile.y1)
+			{
+				error = "tile outside the image";
+				ok = false;
+				break;
+			}
+
+			if (m_failAfter >= 0 && m_tilesDone >= m_failAfter)
+			{
+				error = "dropped the connection after " + std::to_string(m_tilesDone) + " tiles as asked";
+				ok = false;
+				break;
+			}
+
+			RenderTile region = { tile.x0, tile.y0, tile.x1, tile.y1 };
+			tracer->SetRegion(region);
+			tracer->ResetRenderCount();
+			tracer->DoRayTrace(&scene);
+
+			const FrameBuffer& traced = tracer->GetFrameBuffer();
+			pixels.resize(TilePixelCount(tile) * 3);
+
+			float* pixel = pixels.data();
+			for (int i = tile.y0; i < tile.y1; i++)
+			{
+				for (int j = tile.x0; j < tile.x1; j++, pixel += 3)
+				{
+					Colour colour = traced.GetPixel(j, i);
+					pixel[0] = colour.red;
+					pixel[1] = colour.green;
+					pixel[2] = colour.blue;
+				}
+			}
+
+			//the stats go between the tile and the pixels, sent as one body
+			std::vector<char> result(sizeof(tile) + sizeof(RenderStats));
+			memcpy(result.data(), &tile, sizeof(tile));
+			memcpy(result.data() + sizeof(tile), &tracer->GetRenderStats(), sizeof(RenderStats));
+
+			if (!WriteMessage(socket, MSG_RESULT, result.data(), result.size(), pixels.data(), pixels.size() * sizeof(float)))
+				break;
+
+			m_tilesDone++;
+		}
+		else
+		{
+			error = "unexpected message " + std::to_string(header.type);
+			ok = false;
+		}
+	}
+
+	delete tracer;
+	socket.Close();
+	return error.empty();
+}
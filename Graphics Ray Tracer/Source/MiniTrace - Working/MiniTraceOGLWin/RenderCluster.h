@@ -0,0 +1,139 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FrameBuffer.h"
+#include "RayTracer.h"
+#include "RenderStats.h"
+#include "Scene.h"
+#include "Socket.h"
+
+#define CLUSTER_DEFAULT_TILE_SIZE	64
+#define CLUSTER_DEFAULT_TIMEOUT		30000	//ms a worker may take over a tile before it counts as lost
+
+//Renders an image across worker processes, on this machine or others, over TCP.
+//
+//The coordinator sends every worker a SceneSerializer copy of the scene and the tracer's
+//settings, then hands out tiles one at a time as the workers finish them. A worker that
+//closes its connection, or takes longer than the timeout over a tile, is dropped and its tile
+//goes back on the queue for another worker; if none are left the coordinator traces the rest
+//itself. Each tile is traced with RayTracer::SetRegion, so the image is the same as one
+//traced in a single process whatever the number of workers and whichever of them fail.
+class RenderCoordinator
+{
+	private:
+		Socket					m_listener;
+		std::vector<Socket*>	m_workers;			//connected and still in use
+		int						m_tileSize;
+		int						m_timeoutMs;
+
+		RenderStats				m_renderStats;		//the workers' counters of the last render, summed
+		int						m_tilesRedispatched;
+		int						m_workersLost;
+		int						m_localTiles;		//traced by the coordinator after losing every worker
+
+	public:
+		RenderCoordinator();
+		~RenderCoordinator();
+
+		//Waits for workers on the given address and port, port 0 picks a free one
+		bool Listen(const char* address, int port);
+
+		inline int GetPort() const
+		{
+			return m_listener.GetPort();
+		}
+
+		//Accepts workers until count are connected or timeoutMs passes, returns the number connected
+		int AcceptWorkers(int count, int timeoutMs);
+
+		inline int GetWorkerCount() const
+		{
+			return (int)m_workers.size();
+		}
+
+		inline void SetTileSize(int size)
+		{
+			m_tileSize = size > 0 ? size : 1;
+		}
+
+		//0 waits for a tile forever
+		inline void SetTimeout(int timeoutMs)
+		{
+			m_timeoutMs = timeoutMs;
+		}
+
+		//Renders the committed scene with the tracer's size, trace level, flags, packet,
+		//wavefront, precision, anti-aliasing, light budget, shadow cache and tile culling settings into image.
+		//Progressive mode is not used. The image is always finished; returns false if some of it
+		//had to be traced here because no worker was left.
+		bool Render(RayTracer& tracer, Scene& scene, FrameBuffer& image);
+
+		inline const RenderStats& GetRenderStats() const
+		{
+			return m_renderStats;
+		}
+
+		inline int GetTilesRedispatched() const
+		{
+			return m_tilesRedispatched;
+		}
+
+		inline int GetWorkersLost() const
+		{
+			return m_workersLost;
+		}
+
+		inline int GetLocalTiles() const
+		{
+			return m_localTiles;
+		}
+
+		//Tells the workers to quit and closes the connections
+		void Shutdown();
+};
+
+//The other end of a RenderCoordinator: connects to it, loads the scene it sends and
+//traces the tiles it asks for until told to quit.
+class RenderWorker
+{
+	private:
+		int			m_threadCount;
+		int			m_failAfter;		//-1, or the number of tiles before the worker drops out
+		int			m_tilesDone;
+
+	public:
+		RenderWorker();
+
+		//Render threads of the worker, 0 uses one per hardware core
+		inline void SetThreadCount(int count)
+		{
+			m_threadCount = count;
+		}
+
+		//For testing: after this many tiles the worker drops the connection in the middle of
+		//the next one, as if it had crashed. -1 never fails.
+		inline void SetFailAfter(int tiles)
+		{
+			m_failAfter = tiles;
+		}
+
+		inline int GetTilesDone() const
+		{
+			return m_tilesDone;
+		}
+
+		//Serves the coordinator at host:port until it says to quit.
+		//Returns false with a message in error if the connection or the scene failed.
+		bool Run(const char* host, int port, std::string& error);
+};
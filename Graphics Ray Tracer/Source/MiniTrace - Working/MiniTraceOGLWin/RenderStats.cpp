@@ -0,0 +1,176 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include "RenderStats.h"
+
+static const char* s_primitiveNames[Primitive::PRIMTYPE_Count] = { "plane", "sphere", "triangle", "box", "mesh" };
+static const char* s_phaseNames[RenderStats::PHASE_COUNT] = { "setup", "trace", "merge" };
+
+void RenderStats::Reset()
+{
+	primaryRays = 0;
+	reflectionRays = 0;
+	refractionRays = 0;
+	shadowRays = 0;
+	occludedShadowRays = 0;
+	shadowCacheTests = 0;
+	shadowCacheHits = 0;
+	culledTiles = 0;
+	culledTileRoots = 0;
+	culledTilePlanes = 0;
+	antiAliasedPixels = 0;
+	reprojectedPixels = 0;
+	shadedLights = 0;
+	droppedLights = 0;
+
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		intersectionTests[i] = 0;
+		hits[i] = 0;
+	}
+
+	for (int i = 0; i < RENDERSTATS_MAX_DEPTH; i++)
+	{
+		depthHistogram[i] = 0;
+	}
+
+	for (int i = 0; i < PHASE_COUNT; i++)
+	{
+		phaseTimeMs[i] = 0.0;
+	}
+
+	tileTimeMs = 0.0;
+	renderTimeMs = 0.0;
+}
+
+void RenderStats::Merge(const RenderStats& other)
+{
+	primaryRays += other.primaryRays;
+	reflectionRays += other.reflectionRays;
+	refractionRays += other.refractionRays;
+	shadowRays += other.shadowRays;
+	occludedShadowRays += other.occludedShadowRays;
+	shadowCacheTests += other.shadowCacheTests;
+	shadowCacheHits += other.shadowCacheHits;
+	culledTiles += other.culledTiles;
+	culledTileRoots += other.culledTileRoots;
+	culledTilePlanes += other.culledTilePlanes;
+	antiAliasedPixels += other.antiAliasedPixels;
+	reprojectedPixels += other.reprojectedPixels;
+	shadedLights += other.shadedLights;
+	droppedLights += other.droppedLights;
+
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		intersectionTests[i] += other.intersectionTests[i];
+		hits[i] += other.hits[i];
+	}
+
+	for (int i = 0; i < RENDERSTATS_MAX_DEPTH; i++)
+	{
+		depthHistogram[i] += other.depthHistogram[i];
+	}
+
+	for (int i = 0; i < PHASE_COUNT; i++)
+	{
+		phaseTimeMs[i] += other.phaseTimeMs[i];
+	}
+
+	tileTimeMs += other.tileTimeMs;
+	renderTimeMs += other.renderTimeMs;
+}
+
+unsigned long long RenderStats::GetIntersectionTests() const
+{
+	unsigned long long total = 0;
+
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		total += intersectionTests[i];
+	}
+	return total;
+}
+
+unsigned long long RenderStats::GetHits() const
+{
+	unsigned long long total = 0;
+
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		total += hits[i];
+	}
+	return total;
+}
+
+const char* RenderStats::GetPrimitiveName(int type)
+{
+	return type >= 0 && type < Primitive::PRIMTYPE_Count ? s_primitiveNames[type] : "unknown";
+}
+
+const char* RenderStats::GetPhaseName(int phase)
+{
+	return phase >= 0 && phase < PHASE_COUNT ? s_phaseNames[phase] : "unknown";
+}
+
+void RenderStats::WriteJSON(FILE* file, const char* indent) const
+{
+	fprintf(file, "{\n");
+	fprintf(file, "%s  \"enabled\": %s,\n", indent, IsEnabled() ? "true" : "false");
+	fprintf(file, "%s  \"primaryRays\": %llu,\n", indent, primaryRays);
+	fprintf(file, "%s  \"reflectionRays\": %llu,\n", indent, reflectionRays);
+	fprintf(file, "%s  \"refractionRays\": %llu,\n", indent, refractionRays);
+	fprintf(file, "%s  \"shadowRays\": %llu,\n", indent, shadowRays);
+	fprintf(file, "%s  \"occludedShadowRays\": %llu,\n", indent, occludedShadowRays);
+	fprintf(file, "%s  \"shadowCacheTests\": %llu,\n", indent, shadowCacheTests);
+	fprintf(file, "%s  \"shadowCacheHits\": %llu,\n", indent, shadowCacheHits);
+	fprintf(file, "%s  \"culledTiles\": %llu,\n", indent, culledTiles);
+	fprintf(file, "%s  \"culledTileRoots\": %llu,\n", indent, culledTileRoots);
+	fprintf(file, "%s  \"culledTilePlanes\": %llu,\n", indent, culledTilePlanes);
+	fprintf(file, "%s  \"antiAliasedPixels\": %llu,\n", indent, antiAliasedPixels);
+	fprintf(file, "%s  \"reprojectedPixels\": %llu,\n", indent, reprojectedPixels);
+	fprintf(file, "%s  \"shadedLights\": %llu,\n", indent, shadedLights);
+	fprintf(file, "%s  \"droppedLights\": %llu,\n", indent, droppedLights);
+
+	fprintf(file, "%s  \"intersectionTests\": {", indent);
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		fprintf(file, "%s \"%s\": %llu", i > 0 ? "," : "", GetPrimitiveName(i), intersectionTests[i]);
+	}
+	fprintf(file, " },\n");
+
+	fprintf(file, "%s  \"hits\": {", indent);
+	for (int i = 0; i < Primitive::PRIMTYPE_Count; i++)
+	{
+		fprintf(file, "%s \"%s\": %llu", i > 0 ? "," : "", GetPrimitiveName(i), hits[i]);
+	}
+	fprintf(file, " },\n");
+
+	//trailing empty buckets are left out
+	int depths = RENDERSTATS_MAX_DEPTH;
+	while (depths > 1 && depthHistogram[depths - 1] == 0)
+		depths--;
+
+	fprintf(file, "%s  \"depthHistogram\": [", indent);
+	for (int i = 0; i < depths; i++)
+	{
+		fprintf(file, "%s%llu", i > 0 ? ", " : " ", depthHistogram[i]);
+	}
+	fprintf(file, " ],\n");
+
+	fprintf(file, "%s  \"phaseTimeMs\": {", indent);
+	for (int i = 0; i < PHASE_COUNT; i++)
+	{
+		fprintf(file, "%s \"%s\": %.3f", i > 0 ? "," : "", GetPhaseName(i), phaseTimeMs[i]);
+	}
+	fprintf(file, " },\n");
+
+	fprintf(file, "%s  \"tileTimeMs\": %.3f,\n", indent, tileTimeMs);
+	fprintf(file, "%s  \"renderTimeMs\": %.3f\n", indent, renderTimeMs);
+	fprintf(file, "%s}", indent);
+}
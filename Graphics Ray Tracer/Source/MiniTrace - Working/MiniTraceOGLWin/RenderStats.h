@@ -0,0 +1,132 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+#include "Primitive.h"
+
+//Build with MINITRACE_STATS set to 0 to compile the counting out of the tracer, the per tile
+//set up and merging included. The RenderStats API stays, its counters and tile times are then
+//always zero; the phase times are still measured.
+#ifndef MINITRACE_STATS
+#define MINITRACE_STATS 1
+#endif
+
+//Visual Studio 2013 has no thread_local, only __declspec(thread), which takes no constructors
+//or destructors; what is kept per thread with it must be plain data, zero when a thread starts
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL thread_local
+#endif
+
+#if MINITRACE_STATS
+//Declares a reference to the calling thread's counters, look it up once per function
+#define STATS_THREAD(stats)				RenderStats& stats = RenderStats::ThreadLocal()
+#define STATS_ADD(stats, counter, n)	((stats).counter += (n))
+//Clears the calling thread's counters for a tile and starts timing it
+#define STATS_TILE_BEGIN(stats)			STATS_THREAD(stats); \
+										(stats).Reset(); \
+										std::chrono::high_resolution_clock::time_point stats##Start = std::chrono::high_resolution_clock::now()
+//Stores the time since STATS_TILE_BEGIN and merges the tile's counters into total
+#define STATS_TILE_END(stats, total)	(stats).tileTimeMs = std::chrono::duration<double, std::milli>( \
+											std::chrono::high_resolution_clock::now() - stats##Start).count(); \
+										(total).Merge(stats)
+#else
+#define STATS_THREAD(stats)
+#define STATS_ADD(stats, counter, n)	((void)0)
+#define STATS_TILE_BEGIN(stats)
+#define STATS_TILE_END(stats, total)	((void)0)
+#endif
+
+#define RENDERSTATS_MAX_DEPTH	16		//deeper rays are counted in the last bucket of the depth histogram
+
+//Ray and intersection counters for one render.
+//Every render thread counts into its own copy, the copies are merged when the render is done.
+//There is no constructor so the per thread copy needs no initialisation check on every access;
+//value initialise (RenderStats stats = RenderStats();) or call Reset before counting.
+struct RenderStats
+{
+	enum Phase
+	{
+		PHASE_SETUP = 0,	//camera and framebuffer set up
+		PHASE_TRACE,		//tracing the tiles, wall clock
+		PHASE_MERGE,		//merging the per thread counters
+		PHASE_COUNT
+	};
+
+	unsigned long long	primaryRays;
+	unsigned long long	reflectionRays;
+	unsigned long long	refractionRays;
+	unsigned long long	shadowRays;
+	unsigned long long	occludedShadowRays;		//shadow rays that found a blocker
+	unsigned long long	shadowCacheTests;		//shadow rays that tested their light's last blocker first, see Scene::Occluded
+	unsigned long long	shadowCacheHits;		//of those, the ones it blocked, so no search was needed
+	unsigned long long	culledTiles;			//tiles whose primary rays only looked at what their frustum holds, see Scene::Cull
+	unsigned long long	culledTileRoots;		//BVH subtrees kept for those tiles, summed over the tiles
+	unsigned long long	culledTilePlanes;		//planes left out of those tiles, summed over the tiles
+	unsigned long long	antiAliasedPixels;		//pixels given extra samples, see RayTracer::SetAntiAliasing
+	unsigned long long	reprojectedPixels;		//pixels kept from the previous view, see RayTracer::Reproject
+	unsigned long long	shadedLights;			//lights shading the hits, summed over the hits
+	unsigned long long	droppedLights;			//lights that reached a hit but were over RayTracer's light budget
+
+	//ray-primitive tests and closest hits by Primitive::PRIMTYPE, not counting BVH node visits
+	unsigned long long	intersectionTests[Primitive::PRIMTYPE_Count];
+	unsigned long long	hits[Primitive::PRIMTYPE_Count];
+
+	//primary (0), reflection and refraction rays by recursion depth, shadow rays are not included
+	unsigned long long	depthHistogram[RENDERSTATS_MAX_DEPTH];
+
+	double				phaseTimeMs[PHASE_COUNT];
+	double				tileTimeMs;				//time spent in tiles, summed over all threads
+	double				renderTimeMs;
+
+	void Reset();
+	void Merge(const RenderStats& other);
+
+	inline unsigned long long GetSecondaryRays() const
+	{
+		return reflectionRays + refractionRays;
+	}
+
+	inline unsigned long long GetTotalRays() const
+	{
+		return primaryRays + GetSecondaryRays() + shadowRays;
+	}
+
+	unsigned long long GetIntersectionTests() const;
+	unsigned long long GetHits() const;
+
+	//The depth histogram bucket of a ray at the given recursion depth
+	static inline int DepthBucket(int depth)
+	{
+		return depth < RENDERSTATS_MAX_DEPTH ? depth : RENDERSTATS_MAX_DEPTH - 1;
+	}
+
+	//Writes the counters as a JSON object, indent is put in front of every line but the first
+	void WriteJSON(FILE* file, const char* indent) const;
+
+	static inline bool IsEnabled()
+	{
+		return MINITRACE_STATS != 0;
+	}
+
+	static const char* GetPrimitiveName(int type);
+	static const char* GetPhaseName(int phase);
+
+	//The counters of the calling thread
+	static inline RenderStats& ThreadLocal()
+	{
+		static THREAD_LOCAL RenderStats s_threadStats;
+		return s_threadStats;
+	}
+};
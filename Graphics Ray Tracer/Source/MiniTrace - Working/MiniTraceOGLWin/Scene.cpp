@@ -7,13 +7,17 @@
 * to use and extend the functionality. The code provided here is functional
 * however the author does not guarantee its performance.
 ---------------------------------------------------------------------*/
+#include <algorithm>
+
 #include "Scene.h"
 #include "Sphere.h"
 #include "Plane.h"
 #include "Box.h"
+#include "RenderStats.h"
 
 Scene::Scene()
 {
+	m_bvhBuildMethod = BVH::BUILD_SAH;
 	InitDefaultScene();
 }
 
@@ -28,8 +32,8 @@ void Scene::InitDefaultScene()
 	//the default scene consists of 3 spheres and a plane as the ground
 	
 	//Create a box and its material
-	Primitive* newobj = new Box(Vector3(-2.0, 4.0, -8.0), 3.0, 10.0, 4.0);
-	Material* newmat = new Material();
+	Primitive* newobj = Create<Box>(Vector3(-2.0, 4.0, -8.0), 3.0, 10.0, 4.0);
+	Material* newmat = Create<Material>();
 	//mat for the box
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(1.0, 0.0, 0.0);
@@ -40,8 +44,8 @@ void Scene::InitDefaultScene()
 	m_objectMaterials.push_back(newmat);
 	
 	//Create sphere 1 and its material
-	newobj = new Sphere(3.0, 5, -3.5, 2.0); //sphere 2
-	newmat = new Material();
+	newobj = Create<Sphere>(3.0, 5, -3.5, 2.0); //sphere 2
+	newmat = Create<Material>();
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(0.0, 0.8, 0.0);
 	newmat->SetSpecularColour(1.0, 1.0, 1.0);
@@ -51,8 +55,8 @@ void Scene::InitDefaultScene()
 	m_objectMaterials.push_back(newmat);
 	
 	//Create sphere 2 and its material
-	newobj = new Sphere(-2.0, 5, 3.5, 2.0); //sphere 3
-	newmat = new Material();
+	newobj = Create<Sphere>(-2.0, 5, 3.5, 2.0); //sphere 3
+	newmat = Create<Material>();
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(0.0, 0.0, 0.9);
 	newmat->SetSpecularColour(1.0, 1.0, 1.0);
@@ -62,9 +66,9 @@ void Scene::InitDefaultScene()
 	m_objectMaterials.push_back(newmat);
 
 
-	newobj = new Plane(); //an xz plane at the origin, floor
+	newobj = Create<Plane>(); //an xz plane at the origin, floor
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(0.0, 1.0, 0.0), 0.0);
-	newmat = new Material();
+	newmat = Create<Material>();
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(1.0, 0.0, 0.0);
 	newmat->SetSpecularColour(0.0, 0.0, 0.0);
@@ -74,15 +78,15 @@ void Scene::InitDefaultScene()
 	m_sceneObjects.push_back(newobj);
 	m_objectMaterials.push_back(newmat);
 	
-	newobj = new Plane(); //an xz plane 40 units above, ceiling
+	newobj = Create<Plane>(); //an xz plane 40 units above, ceiling
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(0.0, -1.0, 0.0), -40.0);
 	newobj->SetMaterial(newmat);
 	m_sceneObjects.push_back(newobj);
 	
 
-	newobj = new Plane(); //an xy plane 40 units along -z axis, 
+	newobj = Create<Plane>(); //an xy plane 40 units along -z axis, 
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(0.0, 0.0, 1.0), -40.0);
-	newmat = new Material();
+	newmat = Create<Material>();
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(0.0, 1.0, 0.0);
 	newmat->SetSpecularColour(0.0, 0.0, 0.0);
@@ -92,14 +96,14 @@ void Scene::InitDefaultScene()
 	m_sceneObjects.push_back(newobj);
 	m_objectMaterials.push_back(newmat);
 	
-	newobj = new Plane(); //an xy plane 40 units along the z axis
+	newobj = Create<Plane>(); //an xy plane 40 units along the z axis
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(0.0, 0.0, -1.0), -40.0);
 	newobj->SetMaterial(newmat);
 	m_sceneObjects.push_back(newobj);
 	
-	newobj = new Plane(); //an yz plane 20 units along -x axis
+	newobj = Create<Plane>(); //an yz plane 20 units along -x axis
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(1.0, 0.0, 0.0), -20.0);
-	newmat = new Material();
+	newmat = Create<Material>();
 	newmat->SetAmbientColour(0.0, 0.0, 0.0);
 	newmat->SetDiffuseColour(0.0, 0.0, 1.0);
 	newmat->SetSpecularColour(0.0, 0.0, 0.0);
@@ -109,13 +113,13 @@ void Scene::InitDefaultScene()
 	m_sceneObjects.push_back(newobj);
 	m_objectMaterials.push_back(newmat);
 
-	newobj = new Plane(); //an yz plane 20 units along +x axis
+	newobj = Create<Plane>(); //an yz plane 20 units along +x axis
 	static_cast<Plane*>(newobj)->SetPlane(Vector3(-1.0, 0.0, 0.0), -20.0);
 	newobj->SetMaterial(newmat);
 	m_sceneObjects.push_back(newobj);
 
 	//Create one light source for the scene
-	Light *newlight = new Light();
+	Light *newlight = Create<Light>();
 	newlight->SetLightPosition(-3.0, 10.0, 10.0); //Original light position.
 	//newlight->SetLightPosition(10.0, -10.0, 10.0);
 	m_lights.push_back(newlight);
@@ -134,97 +138,449 @@ void Scene::InitDefaultScene()
 
 	//Orthographic Camera. (pos, lookat)
 	m_activeCamera.SetPositionAndLookAt(Vector3(2.0, 10.0, 13.0), Vector3(0.0, 7.5, 0.0));
+
+	Commit();
 }
 
-void Scene::CleanupScene()
+void Scene::CommitObjects(std::vector<AABB>& bounds)
 {
-	//Cleanup object list
+	bounds.clear();
+	m_boundedObjects.clear();
+	m_unboundedObjects.clear();
+
 	std::vector<Primitive*>::iterator prim_iter = m_sceneObjects.begin();
 
-	while(prim_iter != m_sceneObjects.end())
+	while (prim_iter != m_sceneObjects.end())
+	{
+		AABB primBounds;
+
+		(*prim_iter)->Commit();
+
+		if ((*prim_iter)->GetBounds(primBounds))
+		{
+			m_boundedObjects.push_back(*prim_iter);
+			bounds.push_back(primBounds);
+		}
+		else
+		{
+			m_unboundedObjects.push_back(*prim_iter);
+		}
+
+		prim_iter++;
+	}
+}
+
+void Scene::Commit()
+{
+	std::vector<AABB> bounds;
+
+	CommitObjects(bounds);
+	m_bvh.Build(bounds, m_bvhBuildMethod);
+	FillArrays();
+	CommitLights();
+}
+
+void Scene::CommitLights()
+{
+	m_lightTree.Build(m_lights);
+}
+
+void Scene::AssignAccelerationStructure(std::vector<BVH::Node>& nodes, std::vector<int>& items)
+{
+	//the objects are split the same way as by Commit, so the item indices match
+	std::vector<AABB> bounds;
+
+	CommitObjects(bounds);
+
+	if (!m_bvh.Assign(nodes, items, (int)m_boundedObjects.size(), m_bvhBuildMethod))
+		m_bvh.Build(bounds, m_bvhBuildMethod);
+
+	FillArrays();
+	CommitLights();
+}
+
+void Scene::Refit()
+{
+	std::vector<AABB> bounds(m_boundedObjects.size());
+	bool fits = m_boundedObjects.size() + m_unboundedObjects.size() == m_sceneObjects.size();
+
+	for (size_t i = 0; i < m_boundedObjects.size() && fits; i++)
+	{
+		fits = m_boundedObjects[i]->GetBounds(bounds[i]);
+	}
+
+	if (!fits || !m_bvh.Refit(bounds))
+	{
+		Commit();
+		return;
+	}
+
+	FillArrays();
+}
+
+void Scene::FillArrays()
+{
+	m_arrays.Clear();
+	m_boundedRefs.resize(m_boundedObjects.size());
+	m_unboundedRefs.clear();
+
+	//added in the order the leaves list them, so a leaf's objects of one type are next to each other
+	const std::vector<int>& items = m_bvh.GetItems();
+
+	for (size_t i = 0; i < items.size(); i++)
+	{
+		m_boundedRefs[items[i]] = m_arrays.Add(m_boundedObjects[items[i]]);
+	}
+
+	std::vector<Primitive*>::iterator prim_iter = m_unboundedObjects.begin();
+
+	while (prim_iter != m_unboundedObjects.end())
+	{
+		m_unboundedRefs.push_back(m_arrays.Add(*prim_iter));
+		prim_iter++;
+	}
+}
+
+void Scene::AddObject(Primitive* object)
+{
+	m_sceneObjects.push_back(object);
+
+	if (!m_arena.Owns(object))
+		m_heapObjects.push_back(object);
+}
+
+void Scene::AddMaterial(Material* material)
+{
+	m_objectMaterials.push_back(material);
+
+	if (!m_arena.Owns(material))
+		m_heapMaterials.push_back(material);
+}
+
+void Scene::AddLight(Light* light)
+{
+	m_lights.push_back(light);
+
+	if (!m_arena.Owns(light))
+		m_heapLights.push_back(light);
+}
+
+void Scene::CleanupScene()
+{
+	//Cleanup object list, what Create made goes with the arena below
+	std::vector<Primitive*>::iterator prim_iter = m_heapObjects.begin();
+
+	while(prim_iter != m_heapObjects.end())
 	{
 		delete *prim_iter;
 		prim_iter++;
 	}
 
+	m_heapObjects.clear();
 	m_sceneObjects.clear();
+	m_boundedObjects.clear();
+	m_unboundedObjects.clear();
+	m_bvh.Clear();
+	m_arrays.Clear();
+	m_boundedRefs.clear();
+	m_unboundedRefs.clear();
 
 	//Cleanup material list
-	std::vector<Material*>::iterator mat_iter = m_objectMaterials.begin();
+	std::vector<Material*>::iterator mat_iter = m_heapMaterials.begin();
 
-	while (mat_iter != m_objectMaterials.end())
+	while (mat_iter != m_heapMaterials.end())
 	{
 		delete *mat_iter;
 		mat_iter++;
 	}
+	m_heapMaterials.clear();
 	m_objectMaterials.clear();
 
 	//cleanup light list
-	std::vector<Light*>::iterator lit_iter = m_lights.begin();
+	std::vector<Light*>::iterator lit_iter = m_heapLights.begin();
 
-	while (lit_iter != m_lights.end())
+	while (lit_iter != m_heapLights.end())
 	{
 		delete *lit_iter;
 		lit_iter++;
 	}
 
+	m_heapLights.clear();
 	m_lights.clear();
+	m_lightTree.Clear();
+
+	m_arena.Release();
 }
 
-RayHitResult Scene::IntersectByRay(Ray& ray, bool isShadowRay)
+RayHitResult Scene::IntersectByRay(Ray& ray, const SceneCut* cut)
 {
-	RayHitResult result = Ray::s_defaultHitResult;
-	
-	std::vector<Primitive*>::iterator prim_iter = m_sceneObjects.begin();
-	
-	if (!isShadowRay)
+	HitRecord record;
+
+	if (!FindHit(ray, record, cut))
+		return Ray::s_defaultHitResult;
+
+	return ResolveHit(ray, record);
+}
+
+bool Scene::FindHit(Ray& ray, HitRecord& record, const SceneCut* cut)
+{
+	STATS_THREAD(stats);
+
+	int unboundedCount = (int)m_unboundedRefs.size();
+	double tMax = Ray::s_defaultHitResult.t;
+	record.prim = -1;
+
+	auto closest = [&](const PrimitiveArrays::Ref& ref, int prim, double& tClosest) -> bool
+	{
+		PrimitiveArrays::Hit hit;
+
+		STATS_ADD(stats, intersectionTests[ref.type], 1);
+
+		//a tie goes to the lower number, so the hit does not depend on the order of the tests
+		if (m_arrays.Intersect(ref, ray, hit) && (hit.t < tClosest || (hit.t == tClosest && prim < record.prim)))
+		{
+			tClosest = hit.t;
+			record.hit = hit;
+			record.prim = prim;
+			return true;
+		}
+		return false;
+	};
+
+	auto closestItem = [&](int item, double& tClosest) -> bool
+	{
+		return closest(m_boundedRefs[item], unboundedCount + item, tClosest);
+	};
+
+	//planes have no bounds, test them first to give the BVH a shorter ray
+	if (cut)
+	{
+		for (size_t i = 0; i < cut->unbounded.size(); i++)
+		{
+			int index = cut->unbounded[i];
+			closest(m_unboundedRefs[index], index, tMax);
+		}
+
+		m_bvh.ClosestHitFrom(ray, tMax, closestItem, cut->roots, cut->rootCount);
+	}
+	else
 	{
-		while (prim_iter != m_sceneObjects.end())
+		for (size_t i = 0; i < m_unboundedRefs.size(); i++)
 		{
-			RayHitResult current;
+			closest(m_unboundedRefs[i], (int)i, tMax);
+		}
+
+		m_bvh.ClosestHit(ray, tMax, closestItem);
+	}
+
+	if (record.prim < 0)
+		return false;
+
+	STATS_ADD(stats, hits[GetRef(record.prim)->type], 1);
+	return true;
+}
+
+RayHitResult Scene::ResolveHit(Ray& ray, const HitRecord& record) const
+{
+	const PrimitiveArrays::Ref* ref = GetRef(record.prim);
+
+	if (!ref)
+		return Ray::s_defaultHitResult;
+
+	return m_arrays.GetHit(*ref, ray, record.hit);
+}
+
+void Scene::Cull(const Frustum& frustum, SceneCut& cut) const
+{
+	const std::vector<BVH::Node>& nodes = m_bvh.GetNodes();
+
+	auto outside = [&](int node) -> bool
+	{
+		return frustum.Outside(nodes[node].bounds);
+	};
+
+	cut.rootCount = m_bvh.Cut(outside, cut.roots, SCENE_CUT_MAX_ROOTS);
+	cut.unbounded.clear();
+	cut.culledPlanes = 0;
+
+	for (size_t i = 0; i < m_unboundedObjects.size(); i++)
+	{
+		const PrimitiveArrays::Ref& ref = m_unboundedRefs[i];
 
-			current = (*prim_iter)->IntersectByRay(ray);
+		if (ref.type == Primitive::PRIMTYPE_Plane)
+		{
+			Plane* plane = static_cast<Plane*>(m_unboundedObjects[i]);
 
-			if (current.t > 0.0 && current.t < result.t)
+			if (frustum.MissesPlane(plane->GetNormal(), plane->GetOffset()))
 			{
-				result = current;
+				cut.culledPlanes++;
+				continue;
 			}
-
-			prim_iter++;
 		}
+
+		cut.unbounded.push_back((int)i);
 	}
-	else
+}
+
+//The last primitive that blocked a shadow ray to each light, for one thread. An entry is
+//one more than the primitive numbered as in HitRecord, 0 for none, so a new thread's zeroed
+//cache is empty.
+//It is only a guess tested first, so one left from another scene, an earlier Commit or a
+//light sharing the entry at worst misses; out of range entries are ignored.
+struct ShadowCache
+{
+	const Scene*		scene;
+	int					occluders[SHADOW_CACHE_LIGHTS * SHADOW_CACHE_DEPTHS];
+};
+
+static THREAD_LOCAL ShadowCache s_shadowCache;
+
+bool Scene::Occluded(Ray& ray, double maxT, int light, int depth)
+{
+	STATS_THREAD(stats);
+
+	auto blocks = [&](const PrimitiveArrays::Ref& ref) -> bool
 	{
-		while (prim_iter != m_sceneObjects.end())
+		if (!ref.castShadow)
+			return false;
+
+		PrimitiveArrays::Hit hit;
+
+		STATS_ADD(stats, intersectionTests[ref.type], 1);
+
+		return m_arrays.Intersect(ref, ray, hit) && hit.t < maxT;
+	};
+
+	int unboundedCount = (int)m_unboundedRefs.size();
+	int* cached = nullptr;
+
+	if (light >= 0)
+	{
+		ShadowCache& cache = s_shadowCache;
+
+		if (cache.scene != this)
 		{
-			RayHitResult current = result;
-			bool castShadow = (*prim_iter)->GetMaterial()->CastShadow();
+			cache.scene = this;
+			std::fill(cache.occluders, cache.occluders + SHADOW_CACHE_LIGHTS * SHADOW_CACHE_DEPTHS, 0);
+		}
+
+		int slot = light % SHADOW_CACHE_LIGHTS * SHADOW_CACHE_DEPTHS + std::min(std::max(depth, 0), SHADOW_CACHE_DEPTHS - 1);
+		cached = &cache.occluders[slot];
 
-			current = (*prim_iter)->IntersectByRay(ray);
+		const PrimitiveArrays::Ref* ref = GetRef(*cached - 1);
+
+		if (ref)
+		{
+			STATS_ADD(stats, shadowCacheTests, 1);
 
-			if (castShadow && current.t > 0.0 && current.t < result.t)
+			if (blocks(*ref))
 			{
-				std::vector<Light*>::iterator iter = m_lights.begin();
-
-				while (iter != m_lights.end())
-				{
-					Vector3 r = ray.GetRay();
-					double ldotr = (*iter)->GetLightPosition().DotProduct(r);
-					double pdotr = result.point.DotProduct(r);
-					
-					if (pdotr < ldotr)
-					{
-						result = current;
-					}
-
-					iter++;
-				}
-				
+				STATS_ADD(stats, shadowCacheHits, 1);
+				return true;
 			}
+		}
+	}
+
+	int occluder = -1;
+
+	for (size_t i = 0; i < m_unboundedRefs.size() && occluder < 0; i++)
+	{
+		if (blocks(m_unboundedRefs[i]))
+			occluder = (int)i;
+	}
+
+	auto occluded = [&](int item, double tMax) -> bool
+	{
+		if (!blocks(m_boundedRefs[item]))
+			return false;
+
+		occluder = unboundedCount + item;
+		return true;
+	};
+
+	if (occluder < 0)
+		m_bvh.AnyHit(ray, maxT, occluded);
+
+	//a lit hit keeps the guess, the shadow is often picked up again past a gap
+	if (cached && occluder >= 0)
+		*cached = occluder + 1;
+	return occluder >= 0;
+}
+
+void Scene::IntersectPacket(RayPacket& packet, RayPrecision precision, const SceneCut* cut)
+{
+	if (precision == PRECISION_FLOAT)
+	{
+		RayPacketF floatPacket;
+		floatPacket.Assign(packet);
+
+		IntersectPacketT(floatPacket, cut);
 
-			prim_iter++;
+		for (int i = 0; i < packet.count; i++)
+		{
+			packet.t[i] = floatPacket.t[i];
+			packet.hit[i] = floatPacket.hit[i];
 		}
+		return;
 	}
 
+	IntersectPacketT(packet, cut);
+}
+
+template <class Real>
+void Scene::IntersectPacketT(RayPacketT<Real>& packet, const SceneCut* cut)
+{
+	STATS_THREAD(stats);
+
+	//numbered as in FindHit, a tie goes to the lower number whatever order the tests are in
+	int unboundedCount = (int)m_unboundedObjects.size();
+
+	auto test = [&](int index)
+	{
+		Primitive* prim = m_unboundedObjects[index];
+		STATS_ADD(stats, intersectionTests[prim->m_primtype], packet.count);
+		::IntersectPacket(prim, index, packet);
+	};
+
+	if (cut)
+	{
+		for (size_t i = 0; i < cut->unbounded.size(); i++)
+		{
+			test(cut->unbounded[i]);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < m_unboundedObjects.size(); i++)
+		{
+			test((int)i);
+		}
+	}
+
+	auto closest = [&](int item)
+	{
+		STATS_ADD(stats, intersectionTests[m_boundedObjects[item]->m_primtype], packet.count);
+		::IntersectPacket(m_boundedObjects[item], unboundedCount + item, packet);
+	};
+
+	m_bvh.ClosestHitPacket(packet, closest);
+}
+
+RayHitResult Scene::IntersectPacketLane(const RayPacket& packet, int lane, Ray& ray)
+{
+	Primitive* prim = packet.hit[lane];
+
+	if (!prim)
+		return Ray::s_defaultHitResult;
+
+	STATS_THREAD(stats);
+	STATS_ADD(stats, intersectionTests[prim->m_primtype], 1);
+	RayHitResult result = prim->IntersectByRay(ray);
+
+	//a lane right at the edge of an object may not agree with the single ray test
+	if (!result.data)
+		return IntersectByRay(ray);
+
+	STATS_ADD(stats, hits[prim->m_primtype], 1);
 	return result;
 }
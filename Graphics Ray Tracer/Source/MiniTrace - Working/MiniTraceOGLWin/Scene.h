@@ -9,21 +9,88 @@
 ---------------------------------------------------------------------*/
 #pragma once
 
+#include "Arena.h"
+#include "BVH.h"
 #include "Camera.h"
+#include "Frustum.h"
 #include "Primitive.h"
 #include "Material.h"
 #include "Light.h"
+#include "LightTree.h"
+#include "PrimitiveArrays.h"
+#include <stddef.h>
 #include <vector>
 
+#define SHADOW_CACHE_DEPTHS		8		//trace depths with blockers of their own in Occluded's cache, deeper ones share the last
+#define SHADOW_CACHE_LIGHTS		64		//lights with blockers of their own in Occluded's cache, the rest share by index
+#define SCENE_CUT_MAX_ROOTS		16		//most BVH subtrees a SceneCut keeps
+
+//The closest hit of a ray as Scene::FindHit leaves it: the t, the primitive and the little its
+//hit record is made from. The point, normal and object are left to Scene::ResolveHit.
+struct HitRecord
+{
+	PrimitiveArrays::Hit	hit;
+	int						prim;		//the index among the unbounded objects, or their count plus the BVH item;
+										//every ray tests the unbounded objects, so as the lower numbers they win
+										//ties even with objects in BVH nodes a ray passes by
+};
+
+//What the rays inside a frustum can hit, as Scene::Cull finds it
+struct SceneCut
+{
+	int					roots[SCENE_CUT_MAX_ROOTS];		//BVH subtrees inside or across the frustum
+	int					rootCount;
+	std::vector<int>	unbounded;						//indices of the unbounded objects the rays may hit, in order
+	int					culledPlanes;					//unbounded objects left out
+};
+
+//The scene is only read while tracing, so one Scene can be shared by all render threads
 class Scene
 {
 	private:
 		Camera							m_activeCamera;
 		
+		Arena							m_arena;				//holds what Create made
 		std::vector<Primitive*>			m_sceneObjects;
 		std::vector<Material*>			m_objectMaterials;
 		std::vector<Light*>				m_lights;
 
+		//what was added but not made by Create, deleted one by one in CleanupScene
+		std::vector<Primitive*>			m_heapObjects;
+		std::vector<Material*>			m_heapMaterials;
+		std::vector<Light*>				m_heapLights;
+		LightTree						m_lightTree;			//finds the lights that shade a point
+
+		BVH								m_bvh;					//built over the bounded objects
+		BVH::BuildMethod				m_bvhBuildMethod;
+		std::vector<Primitive*>			m_boundedObjects;		//indexed by BVH item
+		std::vector<Primitive*>			m_unboundedObjects;		//planes, tested against every ray
+
+		//the objects' intersection data by type, with the bounded ones in the BVH's leaf order
+		PrimitiveArrays					m_arrays;
+		std::vector<PrimitiveArrays::Ref>	m_boundedRefs;		//indexed by BVH item
+		std::vector<PrimitiveArrays::Ref>	m_unboundedRefs;
+
+		//the ref of a primitive numbered as in HitRecord, null if there is none
+		inline const PrimitiveArrays::Ref* GetRef(int prim) const
+		{
+			int unboundedCount = (int)m_unboundedRefs.size();
+
+			if (prim >= 0 && prim < unboundedCount)
+				return &m_unboundedRefs[prim];
+			if (prim >= unboundedCount && prim - unboundedCount < (int)m_boundedRefs.size())
+				return &m_boundedRefs[prim - unboundedCount];
+			return nullptr;
+		}
+
+		//commits every object and splits them into the bounded and unbounded lists
+		void CommitObjects(std::vector<AABB>& bounds);
+		//fills the primitive arrays once the BVH is ready
+		void FillArrays();
+
+		template <class Real>
+		void IntersectPacketT(RayPacketT<Real>& packet, const SceneCut* cut);
+
 		Colour							m_background;
 		double							m_sceneWidth;
 		double							m_sceneHeight;
@@ -34,6 +101,53 @@ class Scene
 
 		void InitDefaultScene();
 
+		//Gets the scene ready to trace: every object precomputes its ray independent data
+		//and the BVH and light tree are (re)built. Call after adding, moving or changing objects.
+		void Commit();
+
+		//Rebuilds only the light tree, after adding or moving lights or changing their colour or radius
+		void CommitLights();
+
+		//The lights that shade the point, see LightTree::Select
+		inline void SelectLights(const Vector3& point, int budget, LightSelection& selection) const
+		{
+			m_lightTree.Select(m_lights, point, budget, selection);
+		}
+
+		inline const LightTree& GetLightTree() const
+		{
+			return m_lightTree;
+		}
+
+		//Commits the objects like Commit but uses a BVH saved from an earlier build over the
+		//same objects, see BVH::Assign. Falls back to building one if the saved tree does not fit.
+		void AssignAccelerationStructure(std::vector<BVH::Node>& nodes, std::vector<int>& items);
+
+		//Catches up with objects moved by Primitive::Translate, e.g. between the frames of an
+		//animation: the BVH keeps its tree and only its bounds are refitted. The objects are
+		//not committed again. Falls back to Commit if the objects no longer fit the tree.
+		void Refit();
+
+		inline const BVH& GetBVH() const
+		{
+			return m_bvh;
+		}
+
+		inline void SetBVHBuildMethod(BVH::BuildMethod method)
+		{
+			m_bvhBuildMethod = method;
+		}
+
+		inline BVH::BuildMethod GetBVHBuildMethod() const
+		{
+			return m_bvhBuildMethod;
+		}
+
+		inline const BVH::BuildStats& GetBVHStats() const
+		{
+			return m_bvh.GetBuildStats();
+		}
+
 		inline void SetSceneWidth(double width)
 		{
 			m_sceneWidth = width;
@@ -44,29 +158,130 @@ class Scene
 			return &m_activeCamera;
 		}
 
-		inline double GetSceneWidth() 
+		inline const Camera* GetSceneCamera() const
+		{
+			return &m_activeCamera;
+		}
+
+		inline double GetSceneWidth() const
 		{
 			return m_sceneWidth;
 		}
 
-		inline double GetSceneHeight() 
+		inline double GetSceneHeight() const
 		{
 			return m_sceneHeight;
 		}
 
-		inline Colour GetBackgroundColour()
+		inline Colour GetBackgroundColour() const
 		{
 			return m_background;
 		}
 
-		RayHitResult IntersectByRay(Ray& ray, bool isShadowRay = false);
+		//Finds the closest primitive hit by the ray; of two at exactly the same t, the one numbered
+		//lower as in HitRecord. Given a cut, only what it holds is tested, so the ray must be
+		//inside the frustum the cut was made for.
+		RayHitResult IntersectByRay(Ray& ray, const SceneCut* cut = nullptr);
+
+		//IntersectByRay in two steps: FindHit finds the closest hit, false if there is none, and
+		//ResolveHit makes the hit record of what it found, for the same ray. Only the hit that is
+		//kept has its point and normal worked out.
+		bool FindHit(Ray& ray, HitRecord& record, const SceneCut* cut = nullptr);
+		RayHitResult ResolveHit(Ray& ray, const HitRecord& record) const;
+
+		//Shadow query: true if a shadow casting primitive is hit before maxT.
+		//Stops at the first one found rather than looking for the closest.
+		//light is the index of the light the ray goes to, or -1. Given a light, the primitive
+		//that last blocked a shadow ray to it from the same trace depth (0 for primary hits) on
+		//the calling thread is tested first, as rays from neighbouring hits are usually blocked
+		//by the same object. The answer is the same either way; a guess that misses costs one
+		//test more than the search.
+		bool Occluded(Ray& ray, double maxT, int light = -1, int depth = 0);
+
+		//Finds what the rays inside the frustum can hit, once for a whole bundle of them such as
+		//the primary rays of a tile: the BVH subtrees that are not outside it and the planes that
+		//face its rays. IntersectByRay with the cut then gives each ray the same hit as without,
+		//skipping the top of the tree and the planes behind the bundle.
+		void Cull(const Frustum& frustum, SceneCut& cut) const;
+
+		//Finds the nearest primitive and its t for every ray of the packet,
+		//as IntersectByRay would for each ray on its own.
+		//With PRECISION_FLOAT the tests run on a float copy of the packet, which can pick
+		//a different primitive where two are closer together than float can tell apart.
+		//Given a cut, only its planes are tested; the BVH is walked from the root all the same,
+		//as the order a packet visits the cut's subtrees in could change which of two objects
+		//at the same t it keeps.
+		void IntersectPacket(RayPacket& packet, RayPrecision precision = PRECISION_DOUBLE, const SceneCut* cut = nullptr);
+
+		//The hit record of one lane after IntersectPacket, the same IntersectByRay gives for the lane's ray
+		RayHitResult IntersectPacketLane(const RayPacket& packet, int lane, Ray& ray);
 
 		inline std::vector<Light*>* GetLightList()
 		{
 			return &m_lights;
 		}
+
+		inline const std::vector<Light*>* GetLightList() const
+		{
+			return &m_lights;
+		}
+
+		inline void SetSceneHeight(double height)
+		{
+			m_sceneHeight = height;
+		}
+
+		inline void SetBackgroundColour(float r, float g, float b)
+		{
+			m_background.red = r;
+			m_background.green = g;
+			m_background.blue = b;
+		}
+
+		inline size_t GetObjectCount() const
+		{
+			return m_sceneObjects.size();
+		}
+
+		inline Primitive* GetObject(size_t i) const
+		{
+			return m_sceneObjects[i];
+		}
+
+		inline size_t GetMaterialCount() const
+		{
+			return m_objectMaterials.size();
+		}
+
+		inline Material* GetMaterial(size_t i) const
+		{
+			return m_objectMaterials[i];
+		}
+
+		//Makes an object, material or light in the scene's arena, next in memory to the ones made
+		//before it, e.g. Create<Sphere>(x, y, z, radius). It still has to be added; CleanupScene
+		//destroys it whether it was or not, and frees the arena's memory in one go.
+		template <class T, class... Args>
+		inline T* Create(Args&&... args)
+		{
+			return m_arena.New<T>(std::forward<Args>(args)...);
+		}
+
+		//The scene takes ownership of everything added: what Create made goes with the arena
+		//in CleanupScene, anything made with new is deleted there.
+		//A material can be shared by several objects but must only be added once.
+		//Call Commit once all objects are added.
+		void		AddObject(Primitive* object);
+		void		AddMaterial(Material* material);
+		void		AddLight(Light* light);
 		
 		void		CleanupScene();
+
+		//Memory of the objects, materials and lights made with Create
+		inline const Arena& GetArena() const
+		{
+			return m_arena;
+		}
 		
 };
 
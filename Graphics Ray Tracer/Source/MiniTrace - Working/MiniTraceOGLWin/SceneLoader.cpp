@@ -0,0 +1,722 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "SceneLoader.h"
+#include "Box.h"
+#include "Light.h"
+#include "Material.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+
+static const char		s_cacheMagic[8] = "MTSCENE";
+static const uint32_t	s_cacheVersion = 2;
+
+//A read only view of a whole file in memory
+class MappedFile
+{
+	private:
+		const char*		m_data;
+		size_t			m_size;
+#ifdef _WIN32
+		HANDLE			m_file;
+		HANDLE			m_mapping;
+#endif
+
+	public:
+		MappedFile()
+		{
+			m_data = nullptr;
+			m_size = 0;
+#ifdef _WIN32
+			m_file = INVALID_HANDLE_VALUE;
+			m_mapping = NULL;
+#endif
+		}
+
+		~MappedFile()
+		{
+			Close();
+		}
+
+		bool Open(const char* filename)
+		{
+#ifdef _WIN32
+			m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (m_file == INVALID_HANDLE_VALUE)
+				return false;
+
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+				return false;
+
+			m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (!m_mapping)
+				return false;
+
+			m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+			m_size = (size_t)size.QuadPart;
+#else
+			int fd = open(filename, O_RDONLY);
+			if (fd < 0)
+				return false;
+
+			struct stat info;
+			if (fstat(fd, &info) == 0 && info.st_size > 0)
+			{
+				void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data != MAP_FAILED)
+				{
+					m_data = (const char*)data;
+					m_size = info.st_size;
+				}
+			}
+
+			//the mapping stays valid once the file is closed
+			close(fd);
+#endif
+			return m_data != nullptr;
+		}
+
+		void Close()
+		{
+#ifdef _WIN32
+			if (m_data)
+				UnmapViewOfFile(m_data);
+			if (m_mapping)
+				CloseHandle(m_mapping);
+			if (m_file != INVALID_HANDLE_VALUE)
+				CloseHandle(m_file);
+			m_file = INVALID_HANDLE_VALUE;
+			m_mapping = NULL;
+#else
+			if (m_data)
+				munmap((void*)m_data, m_size);
+#endif
+			m_data = nullptr;
+			m_size = 0;
+		}
+
+		inline const char* GetData() const
+		{
+			return m_data;
+		}
+
+		inline size_t GetSize() const
+		{
+			return m_size;
+		}
+};
+
+//Reads count numbers from the tokens starting at first, false if one is not a number
+static bool ReadNumbers(const std::vector<char*>& tokens, size_t first, int count, double* numbers)
+{
+	if (first + count > tokens.size())
+		return false;
+
+	for (int i = 0; i < count; i++)
+	{
+		char* end;
+		numbers[i] = strtod(tokens[first + i], &end);
+
+		if (end == tokens[first + i] || *end != '\0')
+			return false;
+	}
+	return true;
+}
+
+SceneLoader::SceneLoader()
+{
+	m_useCache = true;
+	m_loadedFromCache = false;
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+SceneLoader::~SceneLoader()
+{
+	DeleteMeshes();
+}
+
+void SceneLoader::DeleteMeshes()
+{
+	for (size_t i = 0; i < m_meshes.size(); i++)
+	{
+		delete m_meshes[i];
+	}
+	m_meshes.clear();
+}
+
+bool SceneLoader::Load(const char* filename, Scene& scene)
+{
+	m_error.clear();
+	m_loadedFromCache = false;
+
+	struct stat info;
+	if (stat(filename, &info) != 0)
+	{
+		m_error = std::string("Cannot open ") + filename;
+		return false;
+	}
+
+	std::string cacheName = std::string(filename) + ".cache";
+
+	if (m_useCache && LoadCache(cacheName, info.st_size, info.st_mtime, scene))
+	{
+		m_loadedFromCache = true;
+		return true;
+	}
+
+	if (!Parse(filename))
+	{
+		DeleteMeshes();
+		return false;
+	}
+
+	m_header.sourceSize = info.st_size;
+	m_header.sourceTime = info.st_mtime;
+
+	Build(m_header, m_materials.data(), m_lights.data(), m_primitives.data(), scene);
+	scene.Commit();
+
+	//if the cache cannot be written the next load just parses the text again
+	if (m_useCache && m_meshes.empty())
+		WriteCache(cacheName, scene);
+
+	//the scene owns them now
+	m_meshes.clear();
+
+	std::vector<MaterialRecord>().swap(m_materials);
+	std::vector<LightRecord>().swap(m_lights);
+	std::vector<PrimitiveRecord>().swap(m_primitives);
+	return true;
+}
+
+bool SceneLoader::Parse(const char* filename)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file)
+	{
+		m_error = std::string("Cannot open ") + filename;
+		return false;
+	}
+
+	std::vector<char> text;
+	char buffer[65536];
+	size_t count;
+
+	while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.insert(text.end(), buffer, buffer + count);
+	}
+	fclose(file);
+	text.push_back('\0');
+
+	//the same defaults as a Scene with no content
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.magic, s_cacheMagic, sizeof(m_header.magic));
+	m_header.version = s_cacheVersion;
+	m_header.camera[1] = m_header.camera[4] = 6.0;
+	m_header.camera[2] = 13.0;
+	m_header.camera[5] = 12.0;
+	m_header.view[0] = 1.33333333;
+	m_header.view[1] = 1.0;
+
+	m_materials.clear();
+	m_lights.clear();
+	m_primitives.clear();
+	DeleteMeshes();
+
+	//mesh files are relative to the folder of the scene file
+	std::string folder = filename;
+	size_t slash = folder.find_last_of("/\\");
+	folder = slash == std::string::npos ? std::string() : folder.substr(0, slash + 1);
+
+	std::vector<std::string> materialNames;
+	std::vector<char*> tokens;
+	char* next = &text[0];
+	int lineNumber = 0;
+
+	while (*next)
+	{
+		char* line = next;
+		lineNumber++;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+
+		char* comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+
+		//split the line in place
+		tokens.clear();
+		for (char* token = strtok(line, " \t\r"); token; token = strtok(nullptr, " \t\r"))
+		{
+			tokens.push_back(token);
+		}
+
+		if (tokens.empty())
+			continue;
+
+		std::string keyword = tokens[0];
+		std::string error;
+		double numbers[12];
+
+		//finds the material named by the token at index, adds an error if there is none
+		auto findMaterial = [&](size_t index, uint32_t& material) -> bool
+		{
+			if (index >= tokens.size())
+			{
+				error = "missing material";
+				return false;
+			}
+
+			for (size_t i = 0; i < materialNames.size(); i++)
+			{
+				if (materialNames[i] == tokens[index])
+				{
+					material = (uint32_t)i;
+					return true;
+				}
+			}
+			error = std::string("unknown material ") + tokens[index];
+			return false;
+		};
+
+		//a primitive line: count numbers followed by the material name
+		auto addPrimitive = [&](Primitive::PRIMTYPE type, int count) -> bool
+		{
+			PrimitiveRecord prim;
+			memset(&prim, 0, sizeof(prim));
+			prim.type = type;
+
+			if (!ReadNumbers(tokens, 1, count, prim.data))
+			{
+				error = std::string("expected ") + std::to_string(count) + " numbers";
+				return false;
+			}
+
+			if (!findMaterial(1 + count, prim.material))
+				return false;
+
+			size_t end = 2 + count;
+
+			if (type == Primitive::PRIMTYPE_Box && end < tokens.size() && !strcmp(tokens[end], "axes"))
+			{
+				if (!ReadNumbers(tokens, end + 1, 6, prim.data + count))
+				{
+					error = "expected 6 numbers after axes";
+					return false;
+				}
+				end += 7;
+			}
+
+			if (end != tokens.size())
+			{
+				error = std::string("unexpected ") + tokens[end];
+				return false;
+			}
+
+			m_primitives.push_back(prim);
+			return true;
+		};
+
+		if (keyword == "camera")
+		{
+			if (tokens.size() != 7 || !ReadNumbers(tokens, 1, 6, m_header.camera))
+				error = "expected position and look at point";
+		}
+		else if (keyword == "view")
+		{
+			if (tokens.size() != 3 || !ReadNumbers(tokens, 1, 2, m_header.view))
+				error = "expected width and height";
+		}
+		else if (keyword == "background")
+		{
+			if (tokens.size() != 4 || !ReadNumbers(tokens, 1, 3, numbers))
+				error = "expected r g b";
+
+			for (int i = 0; i < 3 && error.empty(); i++)
+			{
+				m_header.background[i] = (float)numbers[i];
+			}
+		}
+		else if (keyword == "light")
+		{
+			LightRecord light;
+			light.colour[0] = light.colour[1] = light.colour[2] = 1.0;
+			light.radius = 0.0;
+
+			//the radius comes last, the rest is read without it
+			size_t end = tokens.size();
+			if (end >= 2 && !strcmp(tokens[end - 2], "radius"))
+			{
+				if (!ReadNumbers(tokens, end - 1, 1, &light.radius) || light.radius < 0.0)
+					error = "expected a radius";
+				end -= 2;
+			}
+
+			if (error.empty() && ((end != 4 && end != 7) || !ReadNumbers(tokens, 1, (int)end - 1, numbers)))
+				error = "expected x y z, optionally r g b and radius r";
+
+			if (error.empty())
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					light.position[i] = numbers[i];
+					if (end == 7)
+						light.colour[i] = numbers[3 + i];
+				}
+				m_lights.push_back(light);
+			}
+		}
+		else if (keyword == "material")
+		{
+			//start from the defaults of a new Material
+			Material defaults;
+			Colour ambient = defaults.GetAmbientColour();
+			Colour diffuse = defaults.GetDiffuseColour();
+			Colour specular = defaults.GetSpecularColour();
+
+			MaterialRecord mat;
+			mat.ambient[0] = ambient.red; mat.ambient[1] = ambient.green; mat.ambient[2] = ambient.blue;
+			mat.diffuse[0] = diffuse.red; mat.diffuse[1] = diffuse.green; mat.diffuse[2] = diffuse.blue;
+			mat.specular[0] = specular.red; mat.specular[1] = specular.green; mat.specular[2] = specular.blue;
+			mat.specPower = defaults.GetSpecPower();
+			mat.castShadow = defaults.CastShadow();
+
+			if (tokens.size() < 2)
+				error = "missing material name";
+
+			for (size_t i = 2; i < tokens.size() && error.empty(); i++)
+			{
+				std::string option = tokens[i];
+				float* colour = option == "ambient" ? mat.ambient : option == "diffuse" ? mat.diffuse
+					: option == "specular" ? mat.specular : nullptr;
+
+				if (colour)
+				{
+					if (!ReadNumbers(tokens, i + 1, 3, numbers))
+						error = "expected r g b after " + option;
+
+					for (int c = 0; c < 3 && error.empty(); c++)
+					{
+						colour[c] = (float)numbers[c];
+					}
+					i += 3;
+				}
+				else if (option == "power")
+				{
+					if (!ReadNumbers(tokens, i + 1, 1, &mat.specPower))
+						error = "expected a number after power";
+					i++;
+				}
+				else if (option == "noshadow")
+				{
+					mat.castShadow = 0;
+				}
+				else
+				{
+					error = "unknown material option " + option;
+				}
+			}
+
+			if (error.empty())
+			{
+				materialNames.push_back(tokens[1]);
+				m_materials.push_back(mat);
+			}
+		}
+		else if (keyword == "sphere")
+		{
+			addPrimitive(Primitive::PRIMTYPE_Sphere, 4);
+		}
+		else if (keyword == "plane")
+		{
+			addPrimitive(Primitive::PRIMTYPE_Plane, 4);
+		}
+		else if (keyword == "triangle")
+		{
+			addPrimitive(Primitive::PRIMTYPE_Triangle, 9);
+		}
+		else if (keyword == "box")
+		{
+			addPrimitive(Primitive::PRIMTYPE_Box, 6);
+		}
+		else if (keyword == "mesh")
+		{
+			PrimitiveRecord prim;
+			memset(&prim, 0, sizeof(prim));
+			prim.type = Primitive::PRIMTYPE_Mesh;
+
+			bool fit = tokens.size() > 3 && !strcmp(tokens[3], "fit");
+
+			if (tokens.size() < 2)
+				error = "missing mesh file";
+			else if (findMaterial(2, prim.material))
+			{
+				if (fit && !ReadNumbers(tokens, 4, 4, numbers))
+					error = "expected x y z size after fit";
+				else if (tokens.size() != (fit ? 8u : 3u))
+					error = std::string("unexpected ") + tokens[fit ? 8 : 3];
+			}
+
+			if (error.empty())
+			{
+				std::string path = tokens[1];
+				if (path[0] != '/' && path[0] != '\\' && path.find(':') == std::string::npos)
+					path = folder + path;
+
+				TriangleMesh* mesh = new TriangleMesh();
+				m_meshes.push_back(mesh);
+
+				if (mesh->LoadOBJ(path.c_str(), error))
+				{
+					if (fit)
+						mesh->Fit(Vector3(numbers[0], numbers[1], numbers[2]), numbers[3]);
+				
+					prim.data[0] = (double)(m_meshes.size() - 1);
+					m_primitives.push_back(prim);
+				}
+			}
+		}
+		else
+		{
+			error = "unknown keyword " + keyword;
+		}
+
+		if (!error.empty())
+		{
+			m_error = std::string(filename) + ":" + std::to_string(lineNumber) + ": " + error;
+			return false;
+		}
+	}
+
+	m_header.materialCount = (uint32_t)m_materials.size();
+	m_header.lightCount = (uint32_t)m_lights.size();
+	m_header.primitiveCount = (uint32_t)m_primitives.size();
+	return true;
+}
+
+bool SceneLoader::LoadCache(const std::string& cacheName, uint64_t sourceSize, int64_t sourceTime, Scene& scene)
+{
+	MappedFile file;
+
+	if (!file.Open(cacheName.c_str()) || file.GetSize() < sizeof(Header))
+		return false;
+
+	const Header* header = (const Header*)file.GetData();
+
+	if (memcmp(header->magic, s_cacheMagic, sizeof(header->magic)) || header->version != s_cacheVersion
+		|| header->sourceSize != sourceSize || header->sourceTime != sourceTime)
+		return false;
+
+	//each count is checked against the file before it is multiplied, and the sizes are added up
+	//in 64 bits, so damaged counts cannot wrap round to the file's size on a 32 bit build
+	uint64_t fileSize = file.GetSize();
+	uint64_t size = sizeof(Header);
+	const uint32_t counts[5] = { header->materialCount, header->lightCount, header->primitiveCount,
+		header->nodeCount, header->itemCount };
+	const uint64_t recordSizes[5] = { sizeof(MaterialRecord), sizeof(LightRecord), sizeof(PrimitiveRecord),
+		sizeof(NodeRecord), sizeof(int32_t) };
+
+	for (int i = 0; i < 5; i++)
+	{
+		if (counts[i] > fileSize / recordSizes[i])
+			return false;
+
+		size += counts[i] * recordSizes[i];
+	}
+
+	if (fileSize != size)
+		return false;
+
+	//every record is a multiple of 8 bytes, so they are all aligned in the mapped file
+	const MaterialRecord* materials = (const MaterialRecord*)(header + 1);
+	const LightRecord* lights = (const LightRecord*)(materials + header->materialCount);
+	const PrimitiveRecord* primitives = (const PrimitiveRecord*)(lights + header->lightCount);
+	const NodeRecord* nodeRecords = (const NodeRecord*)(primitives + header->primitiveCount);
+	const int32_t* itemRecords = (const int32_t*)(nodeRecords + header->nodeCount);
+
+	for (uint32_t i = 0; i < header->primitiveCount; i++)
+	{
+		//meshes are never cached
+		if (primitives[i].type >= Primitive::PRIMTYPE_Count || primitives[i].type == Primitive::PRIMTYPE_Mesh
+			|| primitives[i].material >= header->materialCount)
+			return false;
+	}
+
+	Build(*header, materials, lights, primitives, scene);
+
+	//a tree built another way than the scene asks for is built again
+	if (header->bvhMethod != (uint32_t)scene.GetBVHBuildMethod())
+	{
+		scene.Commit();
+		return true;
+	}
+
+	std::vector<BVH::Node> nodes(header->nodeCount);
+	std::vector<int> items(itemRecords, itemRecords + header->itemCount);
+
+	for (uint32_t i = 0; i < header->nodeCount; i++)
+	{
+		nodes[i].bounds.min = Vector3(nodeRecords[i].min[0], nodeRecords[i].min[1], nodeRecords[i].min[2]);
+		nodes[i].bounds.max = Vector3(nodeRecords[i].max[0], nodeRecords[i].max[1], nodeRecords[i].max[2]);
+		nodes[i].first = nodeRecords[i].first;
+		nodes[i].count = nodeRecords[i].count;
+	}
+
+	scene.AssignAccelerationStructure(nodes, items);
+	return true;
+}
+
+bool SceneLoader::WriteCache(const std::string& cacheName, const Scene& scene)
+{
+	const std::vector<BVH::Node>& nodes = scene.GetBVH().GetNodes();
+	const std::vector<int>& items = scene.GetBVH().GetItems();
+
+	std::vector<NodeRecord> nodeRecords(nodes.size());
+	std::vector<int32_t> itemRecords(items.begin(), items.end());
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			nodeRecords[i].min[j] = nodes[i].bounds.min[j];
+			nodeRecords[i].max[j] = nodes[i].bounds.max[j];
+		}
+		nodeRecords[i].first = nodes[i].first;
+		nodeRecords[i].count = nodes[i].count;
+	}
+
+	m_header.nodeCount = (uint32_t)nodeRecords.size();
+	m_header.itemCount = (uint32_t)itemRecords.size();
+	m_header.bvhMethod = (uint32_t)scene.GetBVH().GetBuildMethod();
+
+	FILE* file = fopen(cacheName.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool ok = fwrite(&m_header, sizeof(Header), 1, file) == 1
+		&& fwrite(m_materials.data(), sizeof(MaterialRecord), m_materials.size(), file) == m_materials.size()
+		&& fwrite(m_lights.data(), sizeof(LightRecord), m_lights.size(), file) == m_lights.size()
+		&& fwrite(m_primitives.data(), sizeof(PrimitiveRecord), m_primitives.size(), file) == m_primitives.size()
+		&& fwrite(nodeRecords.data(), sizeof(NodeRecord), nodeRecords.size(), file) == nodeRecords.size()
+		&& fwrite(itemRecords.data(), sizeof(int32_t), itemRecords.size(), file) == itemRecords.size();
+
+	if (fclose(file) != 0)
+		ok = false;
+
+	//a partly written cache would only be rejected on the next load, but do not leave it around
+	if (!ok)
+		remove(cacheName.c_str());
+
+	return ok;
+}
+
+void SceneLoader::Build(const Header& header, const MaterialRecord* materials, const LightRecord* lights,
+	const PrimitiveRecord* primitives, Scene& scene)
+{
+	scene.CleanupScene();
+
+	std::vector<Material*> sceneMaterials(header.materialCount);
+
+	for (uint32_t i = 0; i < header.materialCount; i++)
+	{
+		const MaterialRecord& record = materials[i];
+		Material* mat = scene.Create<Material>();
+
+		mat->SetAmbientColour(record.ambient[0], record.ambient[1], record.ambient[2]);
+		mat->SetDiffuseColour(record.diffuse[0], record.diffuse[1], record.diffuse[2]);
+		mat->SetSpecularColour(record.specular[0], record.specular[1], record.specular[2]);
+		mat->SetSpecPower(record.specPower);
+		mat->SetCastShadow(record.castShadow != 0);
+
+		scene.AddMaterial(mat);
+		sceneMaterials[i] = mat;
+	}
+
+	for (uint32_t i = 0; i < header.lightCount; i++)
+	{
+		Light* light = scene.Create<Light>();
+		light->SetLightPosition(lights[i].position[0], lights[i].position[1], lights[i].position[2]);
+		light->SetLightColour(lights[i].colour[0], lights[i].colour[1], lights[i].colour[2]);
+		light->SetRadius(lights[i].radius);
+		scene.AddLight(light);
+	}
+
+	for (uint32_t i = 0; i < header.primitiveCount; i++)
+	{
+		const PrimitiveRecord& record = primitives[i];
+		const double* d = record.data;
+		Primitive* obj = nullptr;
+
+		switch (record.type)
+		{
+		case Primitive::PRIMTYPE_Sphere:
+			obj = scene.Create<Sphere>(d[0], d[1], d[2], d[3]);
+			break;
+		case Primitive::PRIMTYPE_Plane:
+			{
+				Plane* plane = scene.Create<Plane>();
+				plane->SetPlane(Vector3(d[0], d[1], d[2]), d[3]);
+				obj = plane;
+			}
+			break;
+		case Primitive::PRIMTYPE_Triangle:
+			obj = scene.Create<Triangle>(Vector3(d[0], d[1], d[2]), Vector3(d[3], d[4], d[5]), Vector3(d[6], d[7], d[8]));
+			break;
+		case Primitive::PRIMTYPE_Box:
+			{
+				Box* box = scene.Create<Box>(Vector3(d[0], d[1], d[2]), d[3], d[4], d[5]);
+				Vector3 xAxis(d[6], d[7], d[8]);
+				Vector3 yAxis(d[9], d[10], d[11]);
+
+				if (xAxis.Norm_Sqr() > 0.0 && yAxis.Norm_Sqr() > 0.0)
+					box->SetOrientation(xAxis, yAxis);
+				obj = box;
+			}
+			break;
+		case Primitive::PRIMTYPE_Mesh:
+			obj = m_meshes[(size_t)d[0]];
+			break;
+		default:
+			continue;
+		}
+
+		obj->SetMaterial(sceneMaterials[record.material]);
+		scene.AddObject(obj);
+	}
+
+	scene.SetBackgroundColour(header.background[0], header.background[1], header.background[2]);
+	scene.SetSceneWidth(header.view[0]);
+	scene.SetSceneHeight(header.view[1]);
+	scene.GetSceneCamera()->SetPositionAndLookAt(Vector3(header.camera[0], header.camera[1], header.camera[2]),
+		Vector3(header.camera[3], header.camera[4], header.camera[5]));
+}
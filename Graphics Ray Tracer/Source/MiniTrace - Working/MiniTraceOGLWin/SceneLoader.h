@@ -0,0 +1,139 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Scene.h"
+
+class TriangleMesh;
+
+//Loads a scene from a text description, one item per line:
+//
+//	camera px py pz lx ly lz				position and look at point
+//	view width height						size of the view plane, the width is usually the aspect ratio
+//	background r g b
+//	light x y z [r g b] [radius r]			radius limits the light's reach, see Light::SetRadius
+//	material name [ambient r g b] [diffuse r g b] [specular r g b] [power p] [noshadow]
+//	sphere x y z radius material
+//	plane nx ny nz offset material
+//	triangle x0 y0 z0 x1 y1 z1 x2 y2 z2 material
+//	box x y z width height depth material [axes xx xy xz yx yy yz]
+//	mesh file.obj material [fit x y z size]		a TriangleMesh, fit centres it on x y z and scales it to size
+//
+//Anything after a # is a comment. Materials must be defined before they are used.
+//Mesh files are found relative to the scene file.
+//scenes/default.scene holds the built in default scene.
+//
+//The first load writes a binary copy of the scene and its BVH next to the text file, with
+//".cache" added to the name. Later loads map that file into memory and build the scene
+//straight from its records, as long as the text file has the same size and time stamp.
+//Scenes with meshes are not cached, the OBJ files would have to be checked as well.
+class SceneLoader
+{
+	public:
+		//The binary cache is these records one after the other: the header, the materials,
+		//the lights, the primitives, the BVH nodes and then the BVH items
+		struct Header
+		{
+			char		magic[8];			//"MTSCENE" and a zero
+			uint32_t	version;
+			uint32_t	materialCount;
+			uint32_t	lightCount;
+			uint32_t	primitiveCount;
+			uint32_t	nodeCount;
+			uint32_t	itemCount;
+			uint64_t	sourceSize;			//size and modification time of the text file
+			int64_t		sourceTime;
+			double		camera[6];			//position then look at point
+			double		view[2];
+			float		background[3];
+			uint32_t	bvhMethod;			//the BVH::BuildMethod the tree was built with
+		};
+
+		struct MaterialRecord
+		{
+			float		ambient[3];
+			float		diffuse[3];
+			float		specular[3];
+			uint32_t	castShadow;
+			double		specPower;
+		};
+
+		struct LightRecord
+		{
+			double		position[3];
+			double		colour[3];
+			double		radius;
+		};
+
+		struct PrimitiveRecord
+		{
+			uint32_t	type;				//a Primitive::PRIMTYPE
+			uint32_t	material;			//index in the materials
+			double		data[12];			//the numbers from the text line, box axes are zero if not given,
+											//a mesh has its index in the loaded meshes
+		};
+
+		//A BVH::Node without the Vector3 padding, so the file does not depend on the build
+		struct NodeRecord
+		{
+			double		min[3];
+			double		max[3];
+			int32_t		first;
+			int32_t		count;
+		};
+
+	private:
+		std::string						m_error;
+		bool							m_useCache;
+		bool							m_loadedFromCache;
+
+		Header							m_header;
+		std::vector<MaterialRecord>		m_materials;
+		std::vector<LightRecord>		m_lights;
+		std::vector<PrimitiveRecord>	m_primitives;
+		std::vector<TriangleMesh*>		m_meshes;			//loaded by Parse, Build hands them to the scene
+
+		bool	Parse(const char* filename);
+		void	DeleteMeshes();
+		bool	LoadCache(const std::string& cacheName, uint64_t sourceSize, int64_t sourceTime, Scene& scene);
+		bool	WriteCache(const std::string& cacheName, const Scene& scene);
+		//fills the scene from the records, the caller sets up its BVH
+		void	Build(const Header& header, const MaterialRecord* materials, const LightRecord* lights,
+					const PrimitiveRecord* primitives, Scene& scene);
+
+	public:
+		SceneLoader();
+		~SceneLoader();
+
+		//Replaces the scene's contents with the file's. Returns false if the file
+		//could not be read or has an error, GetError says what went wrong.
+		bool	Load(const char* filename, Scene& scene);
+
+		//Turns the binary cache on or off, it is on by default
+		inline void SetUseCache(bool useCache)
+		{
+			m_useCache = useCache;
+		}
+
+		//True if the last Load came from the binary cache
+		inline bool WasLoadedFromCache() const
+		{
+			return m_loadedFromCache;
+		}
+
+		inline const std::string& GetError() const
+		{
+			return m_error;
+		}
+};
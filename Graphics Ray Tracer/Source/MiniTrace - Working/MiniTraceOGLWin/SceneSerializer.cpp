@@ -0,0 +1,442 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdint.h>
+
+#include "SceneSerializer.h"
+#include "Box.h"
+#include "Light.h"
+#include "Material.h"
+#include "Plane.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+
+static const char		s_magic[8] = "MTSNAP";
+static const uint32_t	s_version = 2;
+//a BVH node is written as its bounds, 2 Vector3 of doubles, then its first item and item count
+static const size_t		s_nodeRecordSize = 6 * sizeof(double) + 2 * sizeof(int32_t);
+
+static void PutVector3(SceneSerializer::Writer& writer, const Vector3& v)
+{
+	double values[3] = { v[0], v[1], v[2] };
+	writer.PutArray(values, 3);
+}
+
+static bool GetVector3(SceneSerializer::Reader& reader, Vector3& v)
+{
+	double values[3];
+	if (!reader.GetArray(values, 3))
+		return false;
+
+	v.SetVector(values[0], values[1], values[2]);
+	return true;
+}
+
+static void PutColour(SceneSerializer::Writer& writer, const Colour& colour)
+{
+	float values[3] = { colour.red, colour.green, colour.blue };
+	writer.PutArray(values, 3);
+}
+
+static bool GetColour(SceneSerializer::Reader& reader, Colour& colour)
+{
+	float values[3];
+	if (!reader.GetArray(values, 3))
+		return false;
+
+	colour.red = values[0];
+	colour.green = values[1];
+	colour.blue = values[2];
+	return true;
+}
+
+static bool ValidBuildMethod(uint32_t method)
+{
+	return method == BVH::BUILD_SAH || method == BVH::BUILD_MEDIAN;
+}
+
+void SceneSerializer::Write(const Scene& scene, std::vector<char>& data)
+{
+	data.clear();
+	Writer writer(data);
+
+	writer.PutArray(s_magic, sizeof(s_magic));
+	writer.Put(s_version);
+
+	const Camera* camera = scene.GetSceneCamera();
+	PutVector3(writer, camera->GetPosition());
+	PutVector3(writer, camera->GetViewVector());
+	PutVector3(writer, camera->GetUpVector());
+	PutVector3(writer, camera->GetRightVector());
+	writer.Put(camera->GetFocalLength());
+
+	writer.Put(scene.GetSceneWidth());
+	writer.Put(scene.GetSceneHeight());
+	PutColour(writer, scene.GetBackgroundColour());
+
+	//objects refer to materials by their index, one the scene does not list is added to the end;
+	//an object without a material is given a default one, as every hit is shaded with its material
+	std::vector<Material*> materials;
+	for (size_t i = 0; i < scene.GetMaterialCount(); i++)
+	{
+		materials.push_back(scene.GetMaterial(i));
+	}
+
+	Material defaultMaterial;
+	std::vector<int32_t> objectMaterials(scene.GetObjectCount());
+	for (size_t i = 0; i < scene.GetObjectCount(); i++)
+	{
+		Material* material = scene.GetObject(i)->GetMaterial();
+		if (!material)
+			material = &defaultMaterial;
+
+		size_t index = 0;
+		while (index < materials.size() && materials[index] != material)
+			index++;
+
+		if (index == materials.size())
+			materials.push_back(material);
+		objectMaterials[i] = (int32_t)index;
+	}
+
+	writer.Put((uint32_t)materials.size());
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		PutColour(writer, materials[i]->GetAmbientColour());
+		PutColour(writer, materials[i]->GetDiffuseColour());
+		PutColour(writer, materials[i]->GetSpecularColour());
+		writer.Put(materials[i]->GetSpecPower());
+		writer.Put((uint8_t)materials[i]->CastShadow());
+	}
+
+	const std::vector<Light*>* lights = scene.GetLightList();
+	writer.Put((uint32_t)lights->size());
+	for (size_t i = 0; i < lights->size(); i++)
+	{
+		PutVector3(writer, (*lights)[i]->GetLightPosition());
+		PutColour(writer, (*lights)[i]->GetLightColour());
+		writer.Put((*lights)[i]->GetRadius());
+	}
+
+	writer.Put((uint32_t)scene.GetObjectCount());
+	for (size_t i = 0; i < scene.GetObjectCount(); i++)
+	{
+		Primitive* prim = scene.GetObject(i);
+
+		writer.Put((uint32_t)prim->m_primtype);
+		writer.Put(objectMaterials[i]);
+
+		switch (prim->m_primtype)
+		{
+		case Primitive::PRIMTYPE_Sphere:
+			{
+				Sphere* sphere = static_cast<Sphere*>(prim);
+				PutVector3(writer, sphere->GetCentre());
+				writer.Put(sphere->GetRadius());
+			}
+			break;
+		case Primitive::PRIMTYPE_Plane:
+			{
+				Plane* plane = static_cast<Plane*>(prim);
+				PutVector3(writer, plane->GetNormal());
+				writer.Put(plane->GetOffset());
+			}
+			break;
+		case Primitive::PRIMTYPE_Triangle:
+			{
+				Triangle* triangle = static_cast<Triangle*>(prim);
+				for (int j = 0; j < 3; j++)
+				{
+					PutVector3(writer, triangle->GetVertex(j));
+				}
+			}
+			break;
+		case Primitive::PRIMTYPE_Box:
+			{
+				Box* box = static_cast<Box*>(prim);
+				PutVector3(writer, box->GetCentre());
+				PutVector3(writer, box->GetHalfSize());
+				for (int j = 0; j < 3; j++)
+				{
+					PutVector3(writer, box->GetAxis(j));
+				}
+			}
+			break;
+		case Primitive::PRIMTYPE_Mesh:
+			{
+				TriangleMesh* mesh = static_cast<TriangleMesh*>(prim);
+				for (int j = 0; j < 3; j++)
+				{
+					writer.PutVector(mesh->GetPositionArray(j));
+				}
+				for (int j = 0; j < 3; j++)
+				{
+					writer.PutVector(mesh->GetNormalArray(j));
+				}
+				writer.PutVector(mesh->GetPositionIndices());
+				writer.PutVector(mesh->GetNormalIndices());
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	//the BVH is sent as is, building it again would take longer than the copy
+	const BVH& bvh = scene.GetBVH();
+	const std::vector<BVH::Node>& nodes = bvh.GetNodes();
+
+	writer.Put((uint32_t)scene.GetBVHBuildMethod());
+	writer.Put((uint32_t)bvh.GetBuildMethod());
+	writer.Put((uint32_t)nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		PutVector3(writer, nodes[i].bounds.min);
+		PutVector3(writer, nodes[i].bounds.max);
+		writer.Put((int32_t)nodes[i].first);
+		writer.Put((int32_t)nodes[i].count);
+	}
+
+	std::vector<int32_t> items(bvh.GetItems().begin(), bvh.GetItems().end());
+	writer.PutVector(items);
+}
+
+bool SceneSerializer::Read(const char* data, size_t size, Scene& scene, std::string& error)
+{
+	Reader reader(data, size);
+	char magic[8];
+	uint32_t version;
+
+	scene.CleanupScene();
+
+	if (!reader.GetArray(magic, sizeof(magic)) || memcmp(magic, s_magic, sizeof(magic))
+		|| !reader.Get(version) || version != s_version)
+	{
+		error = "not a scene";
+		return false;
+	}
+
+	//sets error for the part of the data that is cut short or damaged
+	auto damaged = [&error](const std::string& part) -> bool
+	{
+		error = "scene data is cut short or damaged in " + part;
+		return false;
+	};
+
+	Vector3 position, view, up, right;
+	double focalLength, width, height;
+	Colour background;
+
+	if (!GetVector3(reader, position) || !GetVector3(reader, view) || !GetVector3(reader, up)
+		|| !GetVector3(reader, right) || !reader.Get(focalLength)
+		|| !reader.Get(width) || !reader.Get(height) || !GetColour(reader, background))
+		return damaged("the camera");
+
+	scene.GetSceneCamera()->SetFrame(position, view, up, right, focalLength);
+	scene.SetSceneWidth(width);
+	scene.SetSceneHeight(height);
+	scene.SetBackgroundColour(background.red, background.green, background.blue);
+
+	uint32_t count;
+	if (!reader.Get(count))
+		return damaged("the material count");
+
+	std::vector<Material*> materials;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Colour ambient, diffuse, specular;
+		double specPower;
+		uint8_t castShadow;
+
+		if (!GetColour(reader, ambient) || !GetColour(reader, diffuse) || !GetColour(reader, specular)
+			|| !reader.Get(specPower) || !reader.Get(castShadow))
+			return damaged("material " + std::to_string(i));
+
+		Material* mat = scene.Create<Material>();
+		mat->SetAmbientColour(ambient.red, ambient.green, ambient.blue);
+		mat->SetDiffuseColour(diffuse.red, diffuse.green, diffuse.blue);
+		mat->SetSpecularColour(specular.red, specular.green, specular.blue);
+		mat->SetSpecPower(specPower);
+		mat->SetCastShadow(castShadow != 0);
+
+		scene.AddMaterial(mat);
+		materials.push_back(mat);
+	}
+
+	if (!reader.Get(count))
+		return damaged("the light count");
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Vector3 lightPosition;
+		Colour colour;
+		double radius;
+
+		if (!GetVector3(reader, lightPosition) || !GetColour(reader, colour) || !reader.Get(radius))
+			return damaged("light " + std::to_string(i));
+
+		Light* light = scene.Create<Light>();
+		light->SetLightPosition(lightPosition[0], lightPosition[1], lightPosition[2]);
+		light->SetLightColour(colour.red, colour.green, colour.blue);
+		light->SetRadius(radius);
+		scene.AddLight(light);
+	}
+
+	if (!reader.Get(count))
+		return damaged("the object count");
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t type;
+		int32_t material;
+		Primitive* obj = nullptr;
+
+		std::string object = "object " + std::to_string(i);
+
+		if (!reader.Get(type) || !reader.Get(material))
+			return damaged(object);
+
+		if (material < 0 || material >= (int32_t)materials.size())
+		{
+			error = object + " uses material " + std::to_string(material) + " of " + std::to_string(materials.size());
+			return false;
+		}
+
+		switch (type)
+		{
+		case Primitive::PRIMTYPE_Sphere:
+			{
+				Vector3 centre;
+				double radius;
+
+				if (!GetVector3(reader, centre) || !reader.Get(radius))
+					return damaged(object);
+				obj = scene.Create<Sphere>(centre[0], centre[1], centre[2], radius);
+			}
+			break;
+		case Primitive::PRIMTYPE_Plane:
+			{
+				Vector3 normal;
+				double offset;
+
+				if (!GetVector3(reader, normal) || !reader.Get(offset))
+					return damaged(object);
+
+				//GetOffset gives the d of the plane equation, SetPlane takes minus that
+				Plane* plane = scene.Create<Plane>();
+				plane->SetPlane(normal, -offset);
+				obj = plane;
+			}
+			break;
+		case Primitive::PRIMTYPE_Triangle:
+			{
+				Vector3 v[3];
+
+				if (!GetVector3(reader, v[0]) || !GetVector3(reader, v[1]) || !GetVector3(reader, v[2]))
+					return damaged(object);
+				obj = scene.Create<Triangle>(v[0], v[1], v[2]);
+			}
+			break;
+		case Primitive::PRIMTYPE_Box:
+			{
+				Vector3 centre, halfSize, axes[3];
+
+				if (!GetVector3(reader, centre) || !GetVector3(reader, halfSize)
+					|| !GetVector3(reader, axes[0]) || !GetVector3(reader, axes[1]) || !GetVector3(reader, axes[2]))
+					return damaged(object);
+
+				Box* box = scene.Create<Box>(centre, halfSize[0] * 2.0, halfSize[1] * 2.0, halfSize[2] * 2.0);
+				box->SetAxes(axes[0], axes[1], axes[2]);
+				obj = box;
+			}
+			break;
+		case Primitive::PRIMTYPE_Mesh:
+			{
+				std::vector<float> positions[3], normals[3];
+				std::vector<unsigned int> positionIndices, normalIndices;
+
+				for (int j = 0; j < 3; j++)
+				{
+					if (!reader.GetVector(positions[j]))
+						return damaged(object);
+				}
+				for (int j = 0; j < 3; j++)
+				{
+					if (!reader.GetVector(normals[j]))
+						return damaged(object);
+				}
+				if (!reader.GetVector(positionIndices) || !reader.GetVector(normalIndices))
+					return damaged(object);
+
+				TriangleMesh* mesh = scene.Create<TriangleMesh>();
+				if (!mesh->SetBuffers(positions, normals, positionIndices, normalIndices))
+				{
+					error = object + " is a mesh with indices out of range";
+					return false;
+				}
+				obj = mesh;
+			}
+			break;
+		default:
+			error = "unknown primitive type " + std::to_string(type);
+			return false;
+		}
+
+		obj->SetMaterial(materials[material]);
+		scene.AddObject(obj);
+	}
+
+	uint32_t sceneMethod, treeMethod, nodeCount;
+	if (!reader.Get(sceneMethod) || !reader.Get(treeMethod) || !reader.Get(nodeCount))
+		return damaged("the BVH");
+
+	if (!ValidBuildMethod(sceneMethod) || !ValidBuildMethod(treeMethod))
+	{
+		error = "unknown BVH build method " + std::to_string(ValidBuildMethod(sceneMethod) ? treeMethod : sceneMethod);
+		return false;
+	}
+
+	//checked before the nodes are made, so a damaged count cannot ask for more than the data holds
+	if (nodeCount > reader.GetRemaining() / s_nodeRecordSize)
+		return damaged("the BVH");
+
+	std::vector<BVH::Node> nodes(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++)
+	{
+		int32_t first, nodeItems;
+
+		if (!GetVector3(reader, nodes[i].bounds.min) || !GetVector3(reader, nodes[i].bounds.max)
+			|| !reader.Get(first) || !reader.Get(nodeItems))
+			return damaged("BVH node " + std::to_string(i));
+
+		nodes[i].first = first;
+		nodes[i].count = nodeItems;
+	}
+
+	std::vector<int32_t> itemRecords;
+	if (!reader.GetVector(itemRecords))
+		return damaged("the BVH items");
+
+	if (!reader.AtEnd())
+	{
+		error = "scene data has " + std::to_string(reader.GetRemaining()) + " bytes past its end";
+		return false;
+	}
+
+	std::vector<int> items(itemRecords.begin(), itemRecords.end());
+
+	//the tree is taken over with the method it was built with, later commits use the scene's own
+	scene.SetBVHBuildMethod((BVH::BuildMethod)treeMethod);
+	scene.AssignAccelerationStructure(nodes, items);
+	scene.SetBVHBuildMethod((BVH::BuildMethod)sceneMethod);
+
+	error.clear();
+	return true;
+}
@@ -0,0 +1,117 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "Scene.h"
+
+//Copies a whole Scene to a block of bytes and back, e.g. to send it to another process.
+//Unlike the text files of SceneLoader every value is stored as it is in memory, so the copy
+//renders exactly like the original: the camera, the shapes, meshes included, the materials,
+//the lights and the scene BVH. The bytes are only meant for a build of the same program.
+class SceneSerializer
+{
+	public:
+		//Appends values to a byte buffer
+		class Writer
+		{
+			private:
+				std::vector<char>&	m_buffer;
+
+			public:
+				Writer(std::vector<char>& buffer) : m_buffer(buffer)
+				{
+				}
+
+				template <class T>
+				inline void Put(const T& value)
+				{
+					PutArray(&value, 1);
+				}
+
+				template <class T>
+				inline void PutArray(const T* values, size_t count)
+				{
+					const char* bytes = (const char*)values;
+					m_buffer.insert(m_buffer.end(), bytes, bytes + count * sizeof(T));
+				}
+
+				//a count followed by the elements
+				template <class T>
+				inline void PutVector(const std::vector<T>& values)
+				{
+					Put((unsigned long long)values.size());
+					if (!values.empty())
+						PutArray(&values[0], values.size());
+				}
+		};
+
+		//Reads values back from a byte buffer. Reading past the end fails and leaves the value alone.
+		class Reader
+		{
+			private:
+				const char*		m_data;
+				const char*		m_end;
+
+			public:
+				Reader(const char* data, size_t size) : m_data(data), m_end(data + size)
+				{
+				}
+
+				template <class T>
+				inline bool Get(T& value)
+				{
+					return GetArray(&value, 1);
+				}
+
+				template <class T>
+				inline bool GetArray(T* values, size_t count)
+				{
+					if ((size_t)(m_end - m_data) / sizeof(T) < count)
+						return false;
+
+					memcpy(values, m_data, count * sizeof(T));
+					m_data += count * sizeof(T);
+					return true;
+				}
+
+				template <class T>
+				inline bool GetVector(std::vector<T>& values)
+				{
+					unsigned long long count;
+					if (!Get(count) || (size_t)(m_end - m_data) / sizeof(T) < count)
+						return false;
+
+					values.resize((size_t)count);
+					return count == 0 || GetArray(&values[0], (size_t)count);
+				}
+
+				inline bool AtEnd() const
+				{
+					return m_data == m_end;
+				}
+
+				inline size_t GetRemaining() const
+				{
+					return (size_t)(m_end - m_data);
+				}
+		};
+
+		//Replaces the contents of data with the scene, which must be committed
+		static void Write(const Scene& scene, std::vector<char>& data);
+
+		//Replaces the scene's contents with the copy in data and commits it.
+		//Returns false and sets error if the data is not a whole scene.
+		static bool Read(const char* data, size_t size, Scene& scene, std::string& error);
+};
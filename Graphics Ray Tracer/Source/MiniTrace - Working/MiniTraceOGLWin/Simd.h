@@ -0,0 +1,249 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+//A thin wrapper over the widest SIMD registers the compiler targets. SimdDouble has
+//4 lanes with AVX, 2 with SSE2 and a plain double otherwise; SimdFloat has twice as many.
+//Comparisons return masks with every bit of a lane set or clear, ready for Select.
+
+#if defined(_MSC_VER)
+#define SIMD_ALIGN __declspec(align(32))
+#else
+#define SIMD_ALIGN alignas(32)
+#endif
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+#define SIMD_DOUBLE_WIDTH	4
+
+struct SimdDouble
+{
+	__m256d v;
+
+	SimdDouble() {}
+	SimdDouble(__m256d x) : v(x) {}
+	explicit SimdDouble(double x) : v(_mm256_set1_pd(x)) {}
+
+	static inline SimdDouble Load(const double* p) { return _mm256_load_pd(p); }
+	inline void Store(double* p) const { _mm256_store_pd(p, v); }
+};
+
+inline SimdDouble operator + (SimdDouble a, SimdDouble b) { return _mm256_add_pd(a.v, b.v); }
+inline SimdDouble operator - (SimdDouble a, SimdDouble b) { return _mm256_sub_pd(a.v, b.v); }
+inline SimdDouble operator * (SimdDouble a, SimdDouble b) { return _mm256_mul_pd(a.v, b.v); }
+inline SimdDouble operator / (SimdDouble a, SimdDouble b) { return _mm256_div_pd(a.v, b.v); }
+inline SimdDouble operator & (SimdDouble a, SimdDouble b) { return _mm256_and_pd(a.v, b.v); }
+inline SimdDouble operator | (SimdDouble a, SimdDouble b) { return _mm256_or_pd(a.v, b.v); }
+inline SimdDouble AndNot(SimdDouble a, SimdDouble b) { return _mm256_andnot_pd(a.v, b.v); }	// ~a & b
+inline SimdDouble Sqrt(SimdDouble a) { return _mm256_sqrt_pd(a.v); }
+inline SimdDouble Min(SimdDouble a, SimdDouble b) { return _mm256_min_pd(a.v, b.v); }
+inline SimdDouble Max(SimdDouble a, SimdDouble b) { return _mm256_max_pd(a.v, b.v); }
+inline SimdDouble CmpLt(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+inline SimdDouble CmpLe(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+inline SimdDouble CmpGt(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+inline SimdDouble CmpGe(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+inline SimdDouble CmpEq(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ); }
+inline SimdDouble Select(SimdDouble mask, SimdDouble a, SimdDouble b) { return _mm256_blendv_pd(b.v, a.v, mask.v); }
+inline int MoveMask(SimdDouble mask) { return _mm256_movemask_pd(mask.v); }
+
+#define SIMD_FLOAT_WIDTH	8
+
+struct SimdFloat
+{
+	__m256 v;
+
+	SimdFloat() {}
+	SimdFloat(__m256 x) : v(x) {}
+	explicit SimdFloat(float x) : v(_mm256_set1_ps(x)) {}
+
+	static inline SimdFloat Load(const float* p) { return _mm256_load_ps(p); }
+	inline void Store(float* p) const { _mm256_store_ps(p, v); }
+};
+
+inline SimdFloat operator + (SimdFloat a, SimdFloat b) { return _mm256_add_ps(a.v, b.v); }
+inline SimdFloat operator - (SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline SimdFloat operator * (SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline SimdFloat operator / (SimdFloat a, SimdFloat b) { return _mm256_div_ps(a.v, b.v); }
+inline SimdFloat operator & (SimdFloat a, SimdFloat b) { return _mm256_and_ps(a.v, b.v); }
+inline SimdFloat operator | (SimdFloat a, SimdFloat b) { return _mm256_or_ps(a.v, b.v); }
+inline SimdFloat AndNot(SimdFloat a, SimdFloat b) { return _mm256_andnot_ps(a.v, b.v); }	// ~a & b
+inline SimdFloat Sqrt(SimdFloat a) { return _mm256_sqrt_ps(a.v); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a.v, b.v); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a.v, b.v); }
+inline SimdFloat CmpLt(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline SimdFloat CmpLe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline SimdFloat CmpGt(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline SimdFloat CmpGe(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline SimdFloat CmpEq(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+inline int MoveMask(SimdFloat mask) { return _mm256_movemask_ps(mask.v); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define SIMD_DOUBLE_WIDTH	2
+
+struct SimdDouble
+{
+	__m128d v;
+
+	SimdDouble() {}
+	SimdDouble(__m128d x) : v(x) {}
+	explicit SimdDouble(double x) : v(_mm_set1_pd(x)) {}
+
+	static inline SimdDouble Load(const double* p) { return _mm_load_pd(p); }
+	inline void Store(double* p) const { _mm_store_pd(p, v); }
+};
+
+inline SimdDouble operator + (SimdDouble a, SimdDouble b) { return _mm_add_pd(a.v, b.v); }
+inline SimdDouble operator - (SimdDouble a, SimdDouble b) { return _mm_sub_pd(a.v, b.v); }
+inline SimdDouble operator * (SimdDouble a, SimdDouble b) { return _mm_mul_pd(a.v, b.v); }
+inline SimdDouble operator / (SimdDouble a, SimdDouble b) { return _mm_div_pd(a.v, b.v); }
+inline SimdDouble operator & (SimdDouble a, SimdDouble b) { return _mm_and_pd(a.v, b.v); }
+inline SimdDouble operator | (SimdDouble a, SimdDouble b) { return _mm_or_pd(a.v, b.v); }
+inline SimdDouble AndNot(SimdDouble a, SimdDouble b) { return _mm_andnot_pd(a.v, b.v); }	// ~a & b
+inline SimdDouble Sqrt(SimdDouble a) { return _mm_sqrt_pd(a.v); }
+inline SimdDouble Min(SimdDouble a, SimdDouble b) { return _mm_min_pd(a.v, b.v); }
+inline SimdDouble Max(SimdDouble a, SimdDouble b) { return _mm_max_pd(a.v, b.v); }
+inline SimdDouble CmpLt(SimdDouble a, SimdDouble b) { return _mm_cmplt_pd(a.v, b.v); }
+inline SimdDouble CmpLe(SimdDouble a, SimdDouble b) { return _mm_cmple_pd(a.v, b.v); }
+inline SimdDouble CmpGt(SimdDouble a, SimdDouble b) { return _mm_cmpgt_pd(a.v, b.v); }
+inline SimdDouble CmpGe(SimdDouble a, SimdDouble b) { return _mm_cmpge_pd(a.v, b.v); }
+inline SimdDouble CmpEq(SimdDouble a, SimdDouble b) { return _mm_cmpeq_pd(a.v, b.v); }
+inline SimdDouble Select(SimdDouble mask, SimdDouble a, SimdDouble b) { return _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v)); }
+inline int MoveMask(SimdDouble mask) { return _mm_movemask_pd(mask.v); }
+
+#define SIMD_FLOAT_WIDTH	4
+
+struct SimdFloat
+{
+	__m128 v;
+
+	SimdFloat() {}
+	SimdFloat(__m128 x) : v(x) {}
+	explicit SimdFloat(float x) : v(_mm_set1_ps(x)) {}
+
+	static inline SimdFloat Load(const float* p) { return _mm_load_ps(p); }
+	inline void Store(float* p) const { _mm_store_ps(p, v); }
+};
+
+inline SimdFloat operator + (SimdFloat a, SimdFloat b) { return _mm_add_ps(a.v, b.v); }
+inline SimdFloat operator - (SimdFloat a, SimdFloat b) { return _mm_sub_ps(a.v, b.v); }
+inline SimdFloat operator * (SimdFloat a, SimdFloat b) { return _mm_mul_ps(a.v, b.v); }
+inline SimdFloat operator / (SimdFloat a, SimdFloat b) { return _mm_div_ps(a.v, b.v); }
+inline SimdFloat operator & (SimdFloat a, SimdFloat b) { return _mm_and_ps(a.v, b.v); }
+inline SimdFloat operator | (SimdFloat a, SimdFloat b) { return _mm_or_ps(a.v, b.v); }
+inline SimdFloat AndNot(SimdFloat a, SimdFloat b) { return _mm_andnot_ps(a.v, b.v); }	// ~a & b
+inline SimdFloat Sqrt(SimdFloat a) { return _mm_sqrt_ps(a.v); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a.v, b.v); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a.v, b.v); }
+inline SimdFloat CmpLt(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a.v, b.v); }
+inline SimdFloat CmpLe(SimdFloat a, SimdFloat b) { return _mm_cmple_ps(a.v, b.v); }
+inline SimdFloat CmpGt(SimdFloat a, SimdFloat b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline SimdFloat CmpGe(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a.v, b.v); }
+inline SimdFloat CmpEq(SimdFloat a, SimdFloat b) { return _mm_cmpeq_ps(a.v, b.v); }
+inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+inline int MoveMask(SimdFloat mask) { return _mm_movemask_ps(mask.v); }
+
+#else
+
+#include <math.h>
+#include <string.h>
+
+#define SIMD_DOUBLE_WIDTH	1
+
+//Scalar fallback, masks are doubles with all bits set
+struct SimdDouble
+{
+	double v;
+
+	SimdDouble() {}
+	explicit SimdDouble(double x) : v(x) {}
+
+	static inline SimdDouble Load(const double* p) { return SimdDouble(*p); }
+	inline void Store(double* p) const { *p = v; }
+};
+
+inline unsigned long long SimdBits(double x) { unsigned long long b; memcpy(&b, &x, 8); return b; }
+inline SimdDouble SimdFromBits(unsigned long long b) { double x; memcpy(&x, &b, 8); return SimdDouble(x); }
+inline SimdDouble SimdMask(bool m) { return SimdFromBits(m ? ~0ull : 0ull); }
+
+inline SimdDouble operator + (SimdDouble a, SimdDouble b) { return SimdDouble(a.v + b.v); }
+inline SimdDouble operator - (SimdDouble a, SimdDouble b) { return SimdDouble(a.v - b.v); }
+inline SimdDouble operator * (SimdDouble a, SimdDouble b) { return SimdDouble(a.v * b.v); }
+inline SimdDouble operator / (SimdDouble a, SimdDouble b) { return SimdDouble(a.v / b.v); }
+inline SimdDouble operator & (SimdDouble a, SimdDouble b) { return SimdFromBits(SimdBits(a.v) & SimdBits(b.v)); }
+inline SimdDouble operator | (SimdDouble a, SimdDouble b) { return SimdFromBits(SimdBits(a.v) | SimdBits(b.v)); }
+inline SimdDouble AndNot(SimdDouble a, SimdDouble b) { return SimdFromBits(~SimdBits(a.v) & SimdBits(b.v)); }
+inline SimdDouble Sqrt(SimdDouble a) { return SimdDouble(sqrt(a.v)); }
+inline SimdDouble Min(SimdDouble a, SimdDouble b) { return SimdDouble(a.v < b.v ? a.v : b.v); }
+inline SimdDouble Max(SimdDouble a, SimdDouble b) { return SimdDouble(a.v > b.v ? a.v : b.v); }
+inline SimdDouble CmpLt(SimdDouble a, SimdDouble b) { return SimdMask(a.v < b.v); }
+inline SimdDouble CmpLe(SimdDouble a, SimdDouble b) { return SimdMask(a.v <= b.v); }
+inline SimdDouble CmpGt(SimdDouble a, SimdDouble b) { return SimdMask(a.v > b.v); }
+inline SimdDouble CmpGe(SimdDouble a, SimdDouble b) { return SimdMask(a.v >= b.v); }
+inline SimdDouble CmpEq(SimdDouble a, SimdDouble b) { return SimdMask(a.v == b.v); }
+inline SimdDouble Select(SimdDouble mask, SimdDouble a, SimdDouble b) { return SimdBits(mask.v) ? a : b; }
+inline int MoveMask(SimdDouble mask) { return SimdBits(mask.v) ? 1 : 0; }
+
+#define SIMD_FLOAT_WIDTH	1
+
+struct SimdFloat
+{
+	float v;
+
+	SimdFloat() {}
+	explicit SimdFloat(float x) : v(x) {}
+
+	static inline SimdFloat Load(const float* p) { return SimdFloat(*p); }
+	inline void Store(float* p) const { *p = v; }
+};
+
+inline unsigned int SimdBits(float x) { unsigned int b; memcpy(&b, &x, 4); return b; }
+inline SimdFloat SimdFloatFromBits(unsigned int b) { float x; memcpy(&x, &b, 4); return SimdFloat(x); }
+inline SimdFloat SimdFloatMask(bool m) { return SimdFloatFromBits(m ? ~0u : 0u); }
+
+inline SimdFloat operator + (SimdFloat a, SimdFloat b) { return SimdFloat(a.v + b.v); }
+inline SimdFloat operator - (SimdFloat a, SimdFloat b) { return SimdFloat(a.v - b.v); }
+inline SimdFloat operator * (SimdFloat a, SimdFloat b) { return SimdFloat(a.v * b.v); }
+inline SimdFloat operator / (SimdFloat a, SimdFloat b) { return SimdFloat(a.v / b.v); }
+inline SimdFloat operator & (SimdFloat a, SimdFloat b) { return SimdFloatFromBits(SimdBits(a.v) & SimdBits(b.v)); }
+inline SimdFloat operator | (SimdFloat a, SimdFloat b) { return SimdFloatFromBits(SimdBits(a.v) | SimdBits(b.v)); }
+inline SimdFloat AndNot(SimdFloat a, SimdFloat b) { return SimdFloatFromBits(~SimdBits(a.v) & SimdBits(b.v)); }
+inline SimdFloat Sqrt(SimdFloat a) { return SimdFloat(sqrtf(a.v)); }
+inline SimdFloat Min(SimdFloat a, SimdFloat b) { return SimdFloat(a.v < b.v ? a.v : b.v); }
+inline SimdFloat Max(SimdFloat a, SimdFloat b) { return SimdFloat(a.v > b.v ? a.v : b.v); }
+inline SimdFloat CmpLt(SimdFloat a, SimdFloat b) { return SimdFloatMask(a.v < b.v); }
+inline SimdFloat CmpLe(SimdFloat a, SimdFloat b) { return SimdFloatMask(a.v <= b.v); }
+inline SimdFloat CmpGt(SimdFloat a, SimdFloat b) { return SimdFloatMask(a.v > b.v); }
+inline SimdFloat CmpGe(SimdFloat a, SimdFloat b) { return SimdFloatMask(a.v >= b.v); }
+inline SimdFloat CmpEq(SimdFloat a, SimdFloat b) { return SimdFloatMask(a.v == b.v); }
+inline SimdFloat Select(SimdFloat mask, SimdFloat a, SimdFloat b) { return SimdBits(mask.v) ? a : b; }
+inline int MoveMask(SimdFloat mask) { return SimdBits(mask.v) ? 1 : 0; }
+
+#endif
+
+//The SIMD type and lane count for a scalar type, so kernels can be written once for both
+template <class Real> struct SimdOf;
+
+template <> struct SimdOf<double>
+{
+	typedef SimdDouble Type;
+	enum { Width = SIMD_DOUBLE_WIDTH };
+};
+
+template <> struct SimdOf<float>
+{
+	typedef SimdFloat Type;
+	enum { Width = SIMD_FLOAT_WIDTH };
+};
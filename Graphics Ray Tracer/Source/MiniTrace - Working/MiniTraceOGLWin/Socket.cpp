@@ -0,0 +1,259 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#include <mutex>
+
+#include "Socket.h"
+
+#ifdef _WIN32
+#define INVALID_HANDLE		((Socket::Handle)INVALID_SOCKET)
+#define CLOSE_SOCKET(h)		closesocket((SOCKET)(h))
+#define SEND_FLAGS			0
+#else
+#define INVALID_HANDLE		(-1)
+#define CLOSE_SOCKET(h)		close(h)
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS			MSG_NOSIGNAL		//a dead peer gives an error rather than SIGPIPE
+#else
+#define SEND_FLAGS			0
+#endif
+#endif
+
+//Winsock has to be started once per process before any other call
+static bool InitSockets()
+{
+#ifdef _WIN32
+	static std::once_flag s_once;
+	static bool s_started = false;
+
+	std::call_once(s_once, []()
+	{
+		WSADATA data;
+		s_started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	});
+	return s_started;
+#else
+	return true;
+#endif
+}
+
+//Waits until the socket can be read, false on a timeout or error. A negative timeout waits forever.
+static bool WaitReadable(Socket::Handle handle, int timeoutMs)
+{
+#ifdef _WIN32
+	WSAPOLLFD fd;
+	fd.fd = (SOCKET)handle;
+	fd.events = POLLRDNORM;
+	fd.revents = 0;
+	return WSAPoll(&fd, 1, timeoutMs) > 0;
+#else
+	pollfd fd;
+	fd.fd = handle;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	return poll(&fd, 1, timeoutMs) > 0;
+#endif
+}
+
+Socket::Socket()
+{
+	m_handle = INVALID_HANDLE;
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+bool Socket::Listen(const char* address, int port)
+{
+	Close();
+
+	if (!InitSockets())
+		return false;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+		return false;
+
+	m_handle = (Handle)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (m_handle == INVALID_HANDLE)
+		return false;
+
+	int reuse = 1;
+	setsockopt(m_handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	if (bind(m_handle, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_handle, SOMAXCONN) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool Socket::Accept(Socket& client, int timeoutMs)
+{
+	if (!IsOpen() || !WaitReadable(m_handle, timeoutMs))
+		return false;
+
+	Handle handle = (Handle)accept(m_handle, NULL, NULL);
+	if (handle == INVALID_HANDLE)
+		return false;
+
+	//the messages are small and answered one at a time, sending them at once matters more than packing them
+	int noDelay = 1;
+	setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+	client.Close();
+	client.m_handle = handle;
+	return true;
+}
+
+bool Socket::Connect(const char* host, int port)
+{
+	Close();
+
+	if (!InitSockets())
+		return false;
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	char service[16];
+	sprintf(service, "%d", port);
+
+	addrinfo* found = NULL;
+	if (getaddrinfo(host, service, &hints, &found) != 0)
+		return false;
+
+	for (addrinfo* info = found; info; info = info->ai_next)
+	{
+		m_handle = (Handle)socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		if (m_handle == INVALID_HANDLE)
+			continue;
+
+		if (connect(m_handle, info->ai_addr, (int)info->ai_addrlen) == 0)
+			break;
+
+		Close();
+	}
+
+	freeaddrinfo(found);
+
+	if (!IsOpen())
+		return false;
+
+	int noDelay = 1;
+	setsockopt(m_handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+	return true;
+}
+
+int Socket::GetPort() const
+{
+	sockaddr_in addr;
+	socklen_t size = sizeof(addr);
+
+	if (!IsOpen() || getsockname(m_handle, (sockaddr*)&addr, &size) != 0)
+		return 0;
+
+	return ntohs(addr.sin_port);
+}
+
+void Socket::SetReceiveTimeout(int timeoutMs)
+{
+	if (!IsOpen())
+		return;
+
+#ifdef _WIN32
+	DWORD timeout = timeoutMs;
+#else
+	timeval timeout;
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+#endif
+	setsockopt(m_handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+bool Socket::Send(const void* data, size_t size)
+{
+	const char* bytes = (const char*)data;
+
+	while (size > 0 && IsOpen())
+	{
+		int chunk = size < (1 << 30) ? (int)size : (1 << 30);
+		int sent = (int)send(m_handle, bytes, chunk, SEND_FLAGS);
+
+		if (sent <= 0)
+			return false;
+
+		bytes += sent;
+		size -= sent;
+	}
+
+	return size == 0;
+}
+
+bool Socket::Receive(void* data, size_t size)
+{
+	char* bytes = (char*)data;
+
+	while (size > 0 && IsOpen())
+	{
+		int chunk = size < (1 << 30) ? (int)size : (1 << 30);
+		int received = (int)recv(m_handle, bytes, chunk, 0);
+
+		//0 is the peer closing the connection
+		if (received <= 0)
+			return false;
+
+		bytes += received;
+		size -= received;
+	}
+
+	return size == 0;
+}
+
+void Socket::Close()
+{
+	if (m_handle != INVALID_HANDLE)
+		CLOSE_SOCKET(m_handle);
+	m_handle = INVALID_HANDLE;
+}
+
+bool Socket::IsOpen() const
+{
+	return m_handle != INVALID_HANDLE;
+}
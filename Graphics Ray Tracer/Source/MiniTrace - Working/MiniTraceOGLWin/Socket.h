@@ -0,0 +1,59 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <stddef.h>
+
+//A blocking TCP socket, Winsock on Windows and BSD sockets elsewhere.
+//Only what the render cluster needs: listen, accept, connect and whole-buffer send and receive.
+class Socket
+{
+	public:
+#ifdef _WIN32
+		typedef unsigned long long Handle;		//a SOCKET
+#else
+		typedef int Handle;
+#endif
+
+	private:
+		Handle		m_handle;
+
+		//not copyable, the handle has one owner
+		Socket(const Socket&);
+		Socket& operator=(const Socket&);
+
+	public:
+		Socket();
+		~Socket();
+
+		//Listens on the given IPv4 address and port; port 0 picks a free one, see GetPort
+		bool	Listen(const char* address, int port);
+
+		//Waits up to timeoutMs, or forever for a negative timeout, for a connection
+		//and hands it to client. Returns false if none came.
+		bool	Accept(Socket& client, int timeoutMs);
+
+		bool	Connect(const char* host, int port);
+
+		//The local port, e.g. the one a listening socket was given
+		int		GetPort() const;
+
+		//Makes Receive fail once no data has arrived for timeoutMs, 0 waits forever
+		void	SetReceiveTimeout(int timeoutMs);
+
+		//Sends or receives exactly size bytes. Returns false if the connection fails or is
+		//closed first, the socket should then be closed.
+		bool	Send(const void* data, size_t size);
+		bool	Receive(void* data, size_t size);
+
+		void	Close();
+
+		bool	IsOpen() const;
+};
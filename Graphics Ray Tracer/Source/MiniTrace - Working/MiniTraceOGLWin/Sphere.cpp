@@ -18,6 +18,7 @@ Sphere::Sphere()
 	m_centre.SetZero();
 	m_radius = 2.0;
 	m_primtype = PRIMTYPE_Sphere;
+	Commit();
 }
 
 Sphere::Sphere(double x, double y, double z, double r)
@@ -25,12 +26,33 @@ Sphere::Sphere(double x, double y, double z, double r)
 	m_centre.SetVector(x, y, z);
 	m_radius = r;
 	m_primtype = PRIMTYPE_Sphere;
+	Commit();
 }
 
 Sphere::~Sphere()
 {
 }
 
+void Sphere::Commit()
+{
+	m_radiusSqr = m_radius * m_radius;
+}
+
+bool Sphere::Translate(const Vector3& offset)
+{
+	m_centre = m_centre + offset;
+	return true;
+}
+
+bool Sphere::GetBounds(AABB& bounds)
+{
+	Vector3 extent(m_radius, m_radius, m_radius);
+
+	bounds.min = m_centre - extent;
+	bounds.max = m_centre + extent;
+	return true;
+}
+
 RayHitResult Sphere::IntersectByRay(Ray& ray)
 {
 	RayHitResult result = Ray::s_defaultHitResult;
@@ -60,7 +82,7 @@ RayHitResult Sphere::IntersectByRay(Ray& ray)
 	double rayDirDot = ray.GetRay().DotProduct(ray.GetRay());
 
 	// Works out the descriminant of the quadratic equation
-	double discriminant = pow(rayDir.DotProduct(sMinusC), 2) - (rayDirDot * (sMinusC.DotProduct(sMinusC) - pow(m_radius, 2)));
+	double discriminant = pow(rayDir.DotProduct(sMinusC), 2) - (rayDirDot * (sMinusC.DotProduct(sMinusC) - m_radiusSqr));
 
 	double tPlus;
 	double tMinus;
@@ -17,6 +17,7 @@ class Sphere : public Primitive
 	private:
 		Vector3				m_centre;
 		double				m_radius;
+		double				m_radiusSqr;		//set by Commit
 
 	public:
 		Sphere();
@@ -33,6 +34,14 @@ class Sphere : public Primitive
 			return m_radius;
 		}
 
+		inline double		GetRadiusSqr()
+		{
+			return m_radiusSqr;
+		}
+
+		void				Commit();
+		bool				Translate(const Vector3& offset);
 		RayHitResult		IntersectByRay(Ray& ray);
+		bool				GetBounds(AABB& bounds);
 };
 
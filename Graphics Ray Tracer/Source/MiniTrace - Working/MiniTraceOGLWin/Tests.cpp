@@ -0,0 +1,665 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+// Behaviour checks run by ctest: minitrace_test NAME runs the check called NAME,
+// prints what it found wrong and exits with 0 if there was nothing.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Box.h"
+#include "Light.h"
+#include "LightTree.h"
+#include "Material.h"
+#include "Plane.h"
+#include "Scene.h"
+#include "Sphere.h"
+#include "Triangle.h"
+#include "TriangleMesh.h"
+
+//A small deterministic generator so every run checks the same cases
+static unsigned int s_seed;
+
+static double Random(double lo, double hi)
+{
+	s_seed = s_seed * 1664525u + 1013904223u;
+	return lo + (hi - lo) * ((s_seed >> 8) / 16777216.0);
+}
+
+static Vector3 RandomPoint(double lo, double hi)
+{
+	return Vector3(Random(lo, hi), Random(lo, hi), Random(lo, hi));
+}
+
+static bool Close(double a, double b)
+{
+	return fabs(a - b) <= 1e-7 * (1.0 + fabs(a));
+}
+
+//Fills the scene with count spheres, boxes and triangles over a floor. Every fourth
+//material casts no shadow, so shadow rays have objects to go through.
+static void GenerateScene(Scene& scene, int count)
+{
+	scene.CleanupScene();
+
+	std::vector<Material*> materials;
+	for (int i = 0; i < 4; i++)
+	{
+		Material* mat = scene.Create<Material>();
+		mat->SetCastShadow(i != 3);
+		scene.AddMaterial(mat);
+		materials.push_back(mat);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		Vector3 centre = RandomPoint(-10.0, 10.0);
+		double size = Random(0.2, 1.5);
+		Primitive* obj;
+
+		switch (i % 3)
+		{
+		case 0:
+			obj = scene.Create<Sphere>(centre[0], centre[1], centre[2], size);
+			break;
+		case 1:
+			obj = scene.Create<Box>(centre, size, Random(0.2, 1.5), Random(0.2, 1.5));
+			break;
+		default:
+			obj = scene.Create<Triangle>(centre + RandomPoint(-size, size),
+				centre + RandomPoint(-size, size), centre + RandomPoint(-size, size));
+			break;
+		}
+
+		obj->SetMaterial(materials[i % materials.size()]);
+		scene.AddObject(obj);
+	}
+
+	Plane* floor = scene.Create<Plane>();
+	floor->SetPlane(Vector3(0.0, 1.0, 0.0), -12.0);
+	floor->SetMaterial(materials[0]);
+	scene.AddObject(floor);
+
+	scene.Commit();
+}
+
+//The closest hit of the ray found by testing every object of the scene, nullptr if none
+static Primitive* BruteForceHit(const Scene& scene, Ray& ray, double& t)
+{
+	Primitive* closest = nullptr;
+	t = FARFAR_AWAY;
+
+	for (size_t i = 0; i < scene.GetObjectCount(); i++)
+	{
+		RayHitResult result = scene.GetObject(i)->IntersectByRay(ray);
+
+		if (result.data && result.t < t)
+		{
+			closest = scene.GetObject(i);
+			t = result.t;
+		}
+	}
+	return closest;
+}
+
+//The closest hit and the shadow query of the BVH against testing every object, for rays
+//from inside and around a scene of mixed objects, with trees built by both methods
+static bool CheckBVH()
+{
+	const BVH::BuildMethod methods[] = { BVH::BUILD_SAH, BVH::BUILD_MEDIAN };
+	int failures = 0;
+
+	for (int m = 0; m < 2; m++)
+	{
+		s_seed = 12345u;
+
+		Scene scene;
+		scene.SetBVHBuildMethod(methods[m]);
+		GenerateScene(scene, 300);
+
+		for (int i = 0; i < 5000; i++)
+		{
+			Ray ray;
+			Vector3 start = RandomPoint(-15.0, 15.0);
+			Vector3 dir = RandomPoint(-10.0, 10.0) - start;
+			ray.SetRay(start, dir.Normalise());
+
+			double expectedT;
+			Primitive* expected = BruteForceHit(scene, ray, expectedT);
+			RayHitResult result = scene.IntersectByRay(ray);
+
+			if (!expected != !result.data)
+			{
+				printf("method %d ray %d: %s by the BVH but %s by every object\n", m, i,
+					result.data ? "hit" : "missed", expected ? "hit" : "missed");
+				failures++;
+				continue;
+			}
+
+			//of objects at the same t either may be kept, but it must be at that t
+			if (expected && (!Close(result.t, expectedT) ||
+				!Close(static_cast<Primitive*>(result.data)->IntersectByRay(ray).t, expectedT)))
+			{
+				printf("method %d ray %d: hit at %g by the BVH but at %g by every object\n", m, i,
+					result.t, expectedT);
+				failures++;
+			}
+
+			//a shadow ray to a point part of the way along, ignoring objects at about that distance
+			double maxT = Random(0.0, 30.0);
+			bool occluded = false;
+			bool near = false;
+
+			for (size_t j = 0; j < scene.GetObjectCount(); j++)
+			{
+				Primitive* obj = scene.GetObject(j);
+				RayHitResult hit = obj->IntersectByRay(ray);
+
+				if (!hit.data || !obj->GetMaterial()->CastShadow())
+					continue;
+
+				near = near || Close(hit.t, maxT);
+				occluded = occluded || hit.t < maxT;
+			}
+
+			if (!near && scene.Occluded(ray, maxT) != occluded)
+			{
+				printf("method %d ray %d: %s by the BVH before %g but %s by every object\n", m, i,
+					occluded ? "not occluded" : "occluded", maxT, occluded ? "occluded" : "not occluded");
+				failures++;
+			}
+		}
+	}
+
+	return failures == 0;
+}
+
+//Whether the point is on an edge of the box, where the faces either side may both be missed
+static bool OnBoxEdge(Box& box, const Vector3& point)
+{
+	Vector3 offset = point - box.GetCentre();
+	int faces = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (fabs(offset.DotProduct(box.GetAxis(i))) > box.GetHalfSize()[i] - 1e-6)
+			faces++;
+	}
+	return faces > 1;
+}
+
+//The slab test of Box against the box as the 12 triangles it used to be built from, for boxes
+//both axis aligned and turned and rays from around and inside them: the same hits and misses,
+//at the same t with the same normal, apart from rays that pass along an edge
+static bool CheckBox()
+{
+	//corners of the box as signs along its axes and the triangles of each face, facing out
+	const int corners[8][3] =
+	{
+		{ -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 },
+		{ -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 }
+	};
+	const int faces[12][3] =
+	{
+		{ 0, 1, 2 }, { 0, 2, 3 }, { 1, 6, 2 }, { 1, 5, 6 }, { 0, 3, 7 }, { 0, 7, 4 },
+		{ 4, 7, 6 }, { 4, 6, 5 }, { 3, 6, 7 }, { 3, 2, 6 }, { 0, 4, 5 }, { 0, 5, 1 }
+	};
+
+	int failures = 0;
+	s_seed = 4242u;
+
+	for (int b = 0; b < 200; b++)
+	{
+		Box box(RandomPoint(-5.0, 5.0), Random(0.1, 4.0), Random(0.1, 4.0), Random(0.1, 4.0));
+		if (b % 2)
+			box.SetOrientation(RandomPoint(-1.0, 1.0), RandomPoint(-1.0, 1.0));
+		box.Commit();
+
+		Vector3 vertices[8];
+		for (int i = 0; i < 8; i++)
+		{
+			vertices[i] = box.GetCentre();
+			for (int j = 0; j < 3; j++)
+				vertices[i] = vertices[i] + box.GetAxis(j) * (corners[i][j] * box.GetHalfSize()[j]);
+		}
+
+		Triangle triangles[12];
+		for (int i = 0; i < 12; i++)
+		{
+			triangles[i].SetTriangle(vertices[faces[i][0]], vertices[faces[i][1]], vertices[faces[i][2]]);
+			triangles[i].Commit();
+		}
+
+		for (int r = 0; r < 200; r++)
+		{
+			Ray ray;
+			Vector3 start = box.GetCentre() + RandomPoint(-6.0, 6.0);
+			Vector3 dir = box.GetCentre() + RandomPoint(-2.0, 2.0) - start;
+			ray.SetRay(start, dir.Normalise());
+
+			RayHitResult expected = Ray::s_defaultHitResult;
+			for (int i = 0; i < 12; i++)
+			{
+				RayHitResult hit = triangles[i].IntersectByRay(ray);
+				if (hit.data && hit.t < expected.t)
+					expected = hit;
+			}
+
+			RayHitResult result = box.IntersectByRay(ray);
+
+			if ((expected.data && OnBoxEdge(box, expected.point)) || (result.data && OnBoxEdge(box, result.point)))
+				continue;
+
+			if (!expected.data != !result.data)
+			{
+				printf("box %d ray %d: %s by the slab test but %s by the triangles\n", b, r,
+					result.data ? "hit" : "missed", expected.data ? "hit" : "missed");
+				failures++;
+			}
+			else if (expected.data && (!Close(result.t, expected.t) ||
+				!Close(result.normal.DotProduct(expected.normal), 1.0)))
+			{
+				printf("box %d ray %d: hit at %g by the slab test but at %g by the triangles, "
+					"normals %g apart\n", b, r, result.t, expected.t,
+					1.0 - result.normal.DotProduct(expected.normal));
+				failures++;
+			}
+		}
+	}
+
+	return failures == 0;
+}
+
+//Loads text as an OBJ file through a file in the working directory
+static bool LoadOBJText(TriangleMesh& mesh, const char* text, std::string& error)
+{
+	const char* filename = "minitrace_test.obj";
+	FILE* file = fopen(filename, "wb");
+
+	if (!file)
+	{
+		error = std::string("Cannot write ") + filename;
+		return false;
+	}
+
+	fputs(text, file);
+	fclose(file);
+
+	bool loaded = mesh.LoadOBJ(filename, error);
+	remove(filename);
+	return loaded;
+}
+
+static bool SameIndices(const char* what, const std::vector<unsigned int>& indices, const unsigned int* expected, size_t count)
+{
+	if (indices.size() == count && std::equal(indices.begin(), indices.end(), expected))
+		return true;
+
+	printf("%s indices:", what);
+	for (size_t i = 0; i < indices.size(); i++)
+		printf(" %u", indices[i]);
+	printf(", expected");
+	for (size_t i = 0; i < count; i++)
+		printf(" %u", expected[i]);
+	printf("\n");
+	return false;
+}
+
+//The OBJ loader: indices from the start and from the end, corners with and without texture
+//coordinates and normals, polygons split into fans, and files with bad indices rejected
+static bool CheckOBJ()
+{
+	//a quad with v//vn corners counted from 1, then a pentagon with v/vt/vn corners
+	//counted back from the last vertex and normal read so far
+	const char* polygons =
+		"# two polygons\n"
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 1 1 0\n"
+		"v 0 1 0\n"
+		"vn 0 0 1\n"
+		"vn 0 0 -1\n"
+		"f 1//1 2//1 3//1 4//1\n"
+		"v 0 0 2\n"
+		"v 1 0 2\n"
+		"v 2 1 2\n"
+		"v 1 2 2\n"
+		"v 0 1 2\n"
+		"vt 0 0\n"
+		"  f -5/1/-1 -4/1/-1 -3/1/-1 -2/1/-1 -1/1/-1   # indented, with a comment\n";
+	const unsigned int positions[] = { 0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 4, 7, 8 };
+	const unsigned int normals[] = { 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+	//v and v/vt corners, without normals
+	const char* plain =
+		"v 0 0 0\n"
+		"v 1 0 0\n"
+		"v 1 1 0\n"
+		"v 0 1 0\n"
+		"f 4 3/1 2\n"
+		"f 4 -3 -2\n";
+	const unsigned int plainPositions[] = { 3, 2, 1, 3, 1, 2 };
+
+	const char* bad[] =
+	{
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 0 1 2\n",				//indices count from 1
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n",				//past the last vertex
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf -4 -1 -2\n",			//before the first vertex
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 3\nv 2 2 0\nf 1 2 5\n",	//a vertex read after the face
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nvn 0 0 1\nf 1//1 2//1 3//2\n",	//past the last normal
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 a 3\n",				//not a number
+		"v 0 0 0\nv 1 0 0\nv 1 1 0\n",						//no faces
+	};
+
+	bool passed = true;
+	TriangleMesh mesh;
+	std::string error;
+
+	if (!LoadOBJText(mesh, polygons, error))
+	{
+		printf("polygons: %s\n", error.c_str());
+		return false;
+	}
+
+	passed = SameIndices("polygon position", mesh.GetPositionIndices(), positions, 15) && passed;
+	passed = SameIndices("polygon normal", mesh.GetNormalIndices(), normals, 15) && passed;
+
+	if (mesh.GetVertexCount() != 9 || mesh.GetNormalArray(2).size() != 2)
+	{
+		printf("polygons: %d vertices and %d normals, expected 9 and 2\n",
+			mesh.GetVertexCount(), (int)mesh.GetNormalArray(2).size());
+		passed = false;
+	}
+
+	//the pentagon is hit from behind its normals, in the last triangle of its fan, and the
+	//normal of the hit is turned to face the ray
+	mesh.Commit();
+
+	Ray ray;
+	ray.SetRay(Vector3(0.2, 0.9, 5.0), Vector3(0.0, 0.0, -1.0));
+	RayHitResult hit = mesh.IntersectByRay(ray);
+
+	if (!hit.data || !Close(hit.t, 3.0) || !Close(hit.normal[2], 1.0))
+	{
+		printf("polygons: ray hit %s at %g with normal z %g, expected the pentagon at 3 with 1\n",
+			hit.data ? "" : "nothing", hit.t, hit.normal[2]);
+		passed = false;
+	}
+
+	if (!LoadOBJText(mesh, plain, error))
+	{
+		printf("plain: %s\n", error.c_str());
+		return false;
+	}
+
+	passed = SameIndices("plain position", mesh.GetPositionIndices(), plainPositions, 6) && passed;
+
+	if (!mesh.GetNormalIndices().empty())
+	{
+		printf("plain: normals read from a file without them\n");
+		passed = false;
+	}
+
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+	{
+		if (LoadOBJText(mesh, bad[i], error))
+		{
+			printf("bad file %d loaded:\n%s", (int)i, bad[i]);
+			passed = false;
+		}
+	}
+
+	return passed;
+}
+
+//Adds a mesh of a bumpy grid of size by size quads, a mesh refits its own BVH when it moves
+static void AddGridMesh(Scene& scene, int size)
+{
+	std::vector<float> positions[3];
+	std::vector<float> normals[3];
+	std::vector<unsigned int> positionIndices;
+	std::vector<unsigned int> normalIndices;
+
+	for (int z = 0; z <= size; z++)
+	{
+		for (int x = 0; x <= size; x++)
+		{
+			positions[0].push_back((float)(x - size * 0.5));
+			positions[1].push_back((float)Random(-0.5, 0.5));
+			positions[2].push_back((float)(z - size * 0.5));
+		}
+	}
+
+	for (int z = 0; z < size; z++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			unsigned int corner = z * (size + 1) + x;
+			unsigned int quad[6] = { corner, corner + 1, corner + size + 2, corner, corner + size + 2, corner + size + 1 };
+			positionIndices.insert(positionIndices.end(), quad, quad + 6);
+		}
+	}
+
+	TriangleMesh* mesh = scene.Create<TriangleMesh>();
+	mesh->SetBuffers(positions, normals, positionIndices, normalIndices);
+	mesh->SetMaterial(scene.GetMaterial(0));
+	scene.AddObject(mesh);
+}
+
+//Refit against a fresh build: two scenes of the same objects are moved the same way over
+//several steps, one refitting its BVH and the other building it again, and must give every
+//ray the same hit and the same shadow query answer
+static bool CheckRefit()
+{
+	Scene refitted;
+	Scene built;
+	Scene* scenes[2] = { &refitted, &built };
+
+	for (int i = 0; i < 2; i++)
+	{
+		s_seed = 777u;
+		GenerateScene(*scenes[i], 300);
+		AddGridMesh(*scenes[i], 12);
+		scenes[i]->Commit();
+	}
+
+	int failures = 0;
+	size_t numObjects = refitted.GetObjectCount();
+
+	for (int step = 0; step < 8; step++)
+	{
+		//every object moves a little, a few a long way so their leaves spread over the scene
+		for (size_t i = 0; i < numObjects; i++)
+		{
+			double distance = i % 10 == 0 ? 8.0 : 1.0;
+			Vector3 offset = RandomPoint(-distance, distance);
+
+			refitted.GetObject(i)->Translate(offset);
+			built.GetObject(i)->Translate(offset);
+		}
+
+		refitted.Refit();
+		built.Commit();
+
+		for (int r = 0; r < 2000; r++)
+		{
+			Ray ray;
+			Vector3 start = RandomPoint(-20.0, 20.0);
+			Vector3 dir = RandomPoint(-10.0, 10.0) - start;
+			ray.SetRay(start, dir.Normalise());
+
+			RayHitResult hits[2];
+			int objects[2] = { -1, -1 };
+
+			for (int i = 0; i < 2; i++)
+			{
+				hits[i] = scenes[i]->IntersectByRay(ray);
+
+				for (size_t j = 0; j < numObjects && hits[i].data; j++)
+				{
+					if (scenes[i]->GetObject(j) == hits[i].data)
+						objects[i] = (int)j;
+				}
+			}
+
+			if (objects[0] != objects[1] || (objects[0] >= 0 && hits[0].t != hits[1].t))
+			{
+				printf("step %d ray %d: object %d at %g after the refit but %d at %g after a build\n",
+					step, r, objects[0], hits[0].t, objects[1], hits[1].t);
+				failures++;
+			}
+
+			double maxT = Random(0.0, 30.0);
+			bool occluded = refitted.Occluded(ray, maxT);
+
+			if (occluded != built.Occluded(ray, maxT))
+			{
+				printf("step %d ray %d: %s before %g after the refit but not after a build\n",
+					step, r, occluded ? "occluded" : "not occluded", maxT);
+				failures++;
+			}
+		}
+	}
+
+	return failures == 0;
+}
+
+//Light selection against weighing every light: the lights reaching a point, and with a budget
+//the budget most important of them, the heaviest first and of the same weight the first listed
+static bool CheckLightSelection()
+{
+	const double levels[] = { 0.25, 0.5, 1.0 };
+	const int budgets[] = { 0, 1, 3, 8 };
+
+	Scene scene;
+	scene.CleanupScene();
+	s_seed = 31337u;
+
+	int failures = 0;
+	LightSelection selection;
+	std::vector<SelectedLight> expected;
+
+	//only lights with a radius, then some reaching everywhere as well, then one added since
+	//the tree was built, which has to be found all the same
+	for (int round = 0; round < 3; round++)
+	{
+		int numLights = round == 2 ? 1 : 150;
+
+		for (int i = 0; i < numLights; i++)
+		{
+			//few colours, so lights of the same weight are common
+			Light* light = scene.Create<Light>();
+			Vector3 position = RandomPoint(-10.0, 10.0);
+			light->SetLightPosition(position[0], position[1], position[2]);
+			light->SetLightColour(levels[i % 3], levels[i / 3 % 3], levels[i / 9 % 3]);
+			light->SetRadius(round == 1 && i % 4 == 0 ? 0.0 : Random(1.0, 8.0));
+			scene.AddLight(light);
+		}
+
+		if (round < 2)
+			scene.CommitLights();
+
+		const std::vector<Light*>& lights = *scene.GetLightList();
+
+		for (int p = 0; p < 500; p++)
+		{
+			Vector3 point = RandomPoint(-12.0, 12.0);
+
+			std::vector<SelectedLight> reaching;
+			for (size_t i = 0; i < lights.size(); i++)
+			{
+				double influence = lights[i]->GetInfluence(point);
+				SelectedLight candidate = { lights[i], (int)i, influence, LightTree::Brightness(lights[i]) * influence };
+
+				if (influence > 0.0)
+					reaching.push_back(candidate);
+			}
+
+			std::stable_sort(reaching.begin(), reaching.end(), [](const SelectedLight& a, const SelectedLight& b)
+			{
+				return a.weight > b.weight;
+			});
+
+			for (int b = 0; b < 4; b++)
+			{
+				int budget = budgets[b];
+				size_t kept = budget > 0 ? std::min(reaching.size(), (size_t)budget) : reaching.size();
+
+				expected.assign(reaching.begin(), reaching.begin() + kept);
+				std::sort(expected.begin(), expected.end(), [](const SelectedLight& a, const SelectedLight& b)
+				{
+					return a.index < b.index;
+				});
+
+				scene.SelectLights(point, budget, selection);
+
+				bool same = selection.lights.size() == expected.size()
+					&& (budget > 0 ? selection.reaching >= (int)kept : selection.reaching == (int)reaching.size());
+
+				for (size_t i = 0; i < expected.size() && same; i++)
+				{
+					same = selection.lights[i].light == expected[i].light && selection.lights[i].index == expected[i].index
+						&& selection.lights[i].influence == expected[i].influence && selection.lights[i].weight == expected[i].weight;
+				}
+
+				if (!same)
+				{
+					printf("round %d point %d budget %d: lights", round, p, budget);
+					for (size_t i = 0; i < selection.lights.size(); i++)
+						printf(" %d", selection.lights[i].index);
+					printf(" of %d reaching, expected", selection.reaching);
+					for (size_t i = 0; i < expected.size(); i++)
+						printf(" %d", expected[i].index);
+					printf(" of %d\n", (int)reaching.size());
+					failures++;
+				}
+			}
+		}
+	}
+
+	return failures == 0;
+}
+
+struct Check
+{
+	const char*	name;
+	bool		(*run)();
+};
+
+static const Check s_checks[] =
+{
+	{ "bvh_brute_force", CheckBVH },
+	{ "box_triangles", CheckBox },
+	{ "obj_loader", CheckOBJ },
+	{ "refit_build", CheckRefit },
+	{ "light_selection", CheckLightSelection },
+};
+
+int main(int argc, char** argv)
+{
+	int numChecks = sizeof(s_checks) / sizeof(s_checks[0]);
+
+	if (argc == 2)
+	{
+		for (int i = 0; i < numChecks; i++)
+		{
+			if (strcmp(argv[1], s_checks[i].name) == 0)
+				return s_checks[i].run() ? 0 : 1;
+		}
+	}
+
+	fprintf(stderr, "usage: minitrace_test NAME, with NAME one of:\n");
+	for (int i = 0; i < numChecks; i++)
+		fprintf(stderr, "  %s\n", s_checks[i].name);
+	return 2;
+}
@@ -0,0 +1,229 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include "TileScheduler.h"
+
+TileScheduler::TileScheduler()
+{
+	m_job = nullptr;
+	m_jobGeneration = 0;
+	m_busyWorkers = 0;
+	m_shutdown = false;
+	m_threadCount = 0;
+	m_tileSize = 16;
+}
+
+TileScheduler::~TileScheduler()
+{
+	StopWorkers();
+}
+
+void TileScheduler::SetThreadCount(int count)
+{
+	if (count < 0)
+		count = 0;
+
+	if (count != m_threadCount)
+	{
+		//the pool is rebuilt with the new size on the next Run
+		StopWorkers();
+		m_threadCount = count;
+	}
+}
+
+int TileScheduler::GetThreadCount() const
+{
+	if (m_threadCount > 0)
+		return m_threadCount;
+
+	int cores = (int)std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
+void TileScheduler::StartWorkers(int count)
+{
+	m_shutdown = false;
+
+	m_queues.push_back(new WorkQueue());	//the calling thread's queue
+
+	for (int i = 1; i < count; i++)
+	{
+		m_queues.push_back(new WorkQueue());
+		m_workers.push_back(std::thread(&TileScheduler::WorkerMain, this, i, m_jobGeneration));
+	}
+}
+
+void TileScheduler::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_jobLock);
+		m_shutdown = true;
+	}
+	m_jobStart.notify_all();
+
+	std::vector<std::thread>::iterator thread_iter = m_workers.begin();
+	while (thread_iter != m_workers.end())
+	{
+		thread_iter->join();
+		thread_iter++;
+	}
+	m_workers.clear();
+
+	std::vector<WorkQueue*>::iterator queue_iter = m_queues.begin();
+	while (queue_iter != m_queues.end())
+	{
+		delete *queue_iter;
+		queue_iter++;
+	}
+	m_queues.clear();
+}
+
+void TileScheduler::WorkerMain(int worker, unsigned int seenGeneration)
+{
+	while (true)
+	{
+		const TileFunc* job;
+
+		{
+			std::unique_lock<std::mutex> guard(m_jobLock);
+			while (!m_shutdown && m_jobGeneration == seenGeneration)
+				m_jobStart.wait(guard);
+
+			if (m_shutdown)
+				return;
+
+			seenGeneration = m_jobGeneration;
+			job = m_job;
+		}
+
+		ProcessTiles(worker, *job);
+
+		{
+			std::lock_guard<std::mutex> guard(m_jobLock);
+			m_busyWorkers--;
+		}
+		m_jobDone.notify_one();
+	}
+}
+
+bool TileScheduler::GrabTile(int worker, RenderTile& tile)
+{
+	int numQueues = (int)m_queues.size();
+
+	//own queue first, newest tile first
+	{
+		WorkQueue* own = m_queues[worker];
+		std::lock_guard<std::mutex> guard(own->lock);
+		if (!own->tiles.empty())
+		{
+			tile = own->tiles.back();
+			own->tiles.pop_back();
+			return true;
+		}
+	}
+
+	//steal the oldest tile of the next worker that still has some
+	for (int i = 1; i < numQueues; i++)
+	{
+		WorkQueue* victim = m_queues[(worker + i) % numQueues];
+		std::lock_guard<std::mutex> guard(victim->lock);
+		if (!victim->tiles.empty())
+		{
+			tile = victim->tiles.front();
+			victim->tiles.pop_front();
+			return true;
+		}
+	}
+
+	//tiles are only ever added before a job starts, so empty queues mean we are done
+	return false;
+}
+
+void TileScheduler::ProcessTiles(int worker, const TileFunc& func)
+{
+	RenderTile tile;
+
+	while (GrabTile(worker, tile))
+	{
+		func(tile, worker);
+	}
+}
+
+void TileScheduler::Run(int width, int height, const TileFunc& func)
+{
+	RenderTile area;
+	area.x0 = area.y0 = 0;
+	area.x1 = width;
+	area.y1 = height;
+
+	Run(area, func);
+}
+
+void TileScheduler::Run(const RenderTile& area, const TileFunc& func)
+{
+	std::vector<RenderTile> tiles;
+
+	for (int y = area.y0; y < area.y1; y += m_tileSize)
+	{
+		for (int x = area.x0; x < area.x1; x += m_tileSize)
+		{
+			RenderTile tile;
+			tile.x0 = x;
+			tile.y0 = y;
+			tile.x1 = x + m_tileSize < area.x1 ? x + m_tileSize : area.x1;
+			tile.y1 = y + m_tileSize < area.y1 ? y + m_tileSize : area.y1;
+			tiles.push_back(tile);
+		}
+	}
+
+	Run(tiles, func);
+}
+
+void TileScheduler::Run(const std::vector<RenderTile>& tiles, const TileFunc& func)
+{
+	int count = GetThreadCount();
+
+	if (count <= 1 || tiles.size() <= 1)
+	{
+		std::vector<RenderTile>::const_iterator tile_iter = tiles.begin();
+		while (tile_iter != tiles.end())
+		{
+			func(*tile_iter, 0);
+			tile_iter++;
+		}
+		return;
+	}
+
+	if ((int)m_queues.size() != count)
+	{
+		StopWorkers();
+		StartWorkers(count);
+	}
+
+	//deal the tiles out round robin so every worker starts with a spread of the image
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		m_queues[i % count]->tiles.push_back(tiles[i]);
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(m_jobLock);
+		m_job = &func;
+		m_busyWorkers = count - 1;
+		m_jobGeneration++;
+	}
+	m_jobStart.notify_all();
+
+	ProcessTiles(0, func);
+
+	std::unique_lock<std::mutex> guard(m_jobLock);
+	while (m_busyWorkers > 0)
+		m_jobDone.wait(guard);
+	m_job = nullptr;
+}
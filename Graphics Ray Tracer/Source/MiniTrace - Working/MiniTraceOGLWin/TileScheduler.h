@@ -0,0 +1,88 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A rectangular block of the framebuffer, [x0, x1) by [y0, y1)
+struct RenderTile
+{
+	int x0, y0;
+	int x1, y1;
+};
+
+//Splits a framebuffer into tiles and runs them on a persistent worker pool.
+//Every worker owns a queue of tiles; it pops from the back of its own queue
+//and, once that runs dry, steals from the front of the other workers' queues.
+//The calling thread takes part in the work as worker 0.
+class TileScheduler
+{
+	public:
+		typedef std::function<void(const RenderTile& tile, int worker)> TileFunc;
+
+	private:
+		struct WorkQueue
+		{
+			std::mutex					lock;
+			std::deque<RenderTile>		tiles;
+		};
+
+		std::vector<std::thread>		m_workers;
+		std::vector<WorkQueue*>			m_queues;		//one per worker, including the calling thread
+
+		std::mutex						m_jobLock;
+		std::condition_variable			m_jobStart;
+		std::condition_variable			m_jobDone;
+		const TileFunc*					m_job;
+		unsigned int					m_jobGeneration;
+		int								m_busyWorkers;
+		bool							m_shutdown;
+
+		int								m_threadCount;	//0 means one thread per hardware core
+		int								m_tileSize;
+
+		void StartWorkers(int count);
+		void StopWorkers();
+		void WorkerMain(int worker, unsigned int seenGeneration);
+		void ProcessTiles(int worker, const TileFunc& func);
+		bool GrabTile(int worker, RenderTile& tile);
+
+	public:
+		TileScheduler();
+		~TileScheduler();
+
+		void SetThreadCount(int count);
+		int GetThreadCount() const;
+
+		inline void SetTileSize(int size)
+		{
+			m_tileSize = size > 0 ? size : 1;
+		}
+
+		inline int GetTileSize() const
+		{
+			return m_tileSize;
+		}
+
+		//Calls func once for every tile of a width x height framebuffer and
+		//returns once all of them are done. func must be safe to call concurrently.
+		void Run(int width, int height, const TileFunc& func);
+
+		//Same for the tiles of a part of the framebuffer, tiled from its top left corner
+		void Run(const RenderTile& area, const TileFunc& func);
+
+		//Runs func on an explicit list of tiles
+		void Run(const std::vector<RenderTile>& tiles, const TileFunc& func);
+};
@@ -16,6 +16,7 @@ Triangle::Triangle()
 	m_vertices[2] = Vector3(1.0, 0.0, -5.0);
 	m_normal = Vector3(0.0, 0.0, 1.0);
 	m_primtype = PRIMTYPE_Triangle;
+	Commit();
 }
 
 Triangle::Triangle(Vector3 pos1, Vector3 pos2, Vector3 pos3)
@@ -23,6 +24,7 @@ Triangle::Triangle(Vector3 pos1, Vector3 pos2, Vector3 pos3)
 	SetTriangle(pos1, pos2, pos3);
 
 	m_primtype = PRIMTYPE_Triangle;
+	Commit();
 }
 
 
@@ -44,6 +46,40 @@ void Triangle::SetTriangle(Vector3 v0, Vector3 v1, Vector3 v2)
 	m_normal = Norm;
 }
 
+void Triangle::Commit()
+{
+	m_edge0 = m_vertices[2] - m_vertices[0];
+	m_edge1 = m_vertices[1] - m_vertices[0];
+	m_offset = -m_vertices[0].DotProduct(m_normal);
+
+	m_dot00 = m_edge0.DotProduct(m_edge0);
+	m_dot01 = m_edge0.DotProduct(m_edge1);
+	m_dot11 = m_edge1.DotProduct(m_edge1);
+	m_invDenom = 1 / (m_dot00 * m_dot11 - m_dot01 * m_dot01);
+
+	m_bounds.SetEmpty();
+	m_bounds.Expand(m_vertices[0]);
+	m_bounds.Expand(m_vertices[1]);
+	m_bounds.Expand(m_vertices[2]);
+}
+
+bool Triangle::Translate(const Vector3& offset)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_vertices[i] = m_vertices[i] + offset;
+	}
+
+	Commit();
+	return true;
+}
+
+bool Triangle::GetBounds(AABB& bounds)
+{
+	bounds = m_bounds;
+	return true;
+}
+
 RayHitResult Triangle::IntersectByRay(Ray& ray)
 {
 	RayHitResult result = Ray::s_defaultHitResult;
@@ -63,8 +99,7 @@ RayHitResult Triangle::IntersectByRay(Ray& ray)
 	// calculate the exact location of intersection.
 	if (ray.GetRay().DotProduct(m_normal) < 0)
 	{
-		double d = -m_vertices[0].DotProduct(m_normal);
-		double top = ray.GetRayStart().DotProduct(m_normal) + d;
+		double top = ray.GetRayStart().DotProduct(m_normal) + m_offset;
 		double bottom = ray.GetRay().DotProduct(m_normal);
 		t = -((top) / (bottom));
 
@@ -74,25 +109,20 @@ RayHitResult Triangle::IntersectByRay(Ray& ray)
 		/* Barycentric Links: - http://www.blackpawn.com/texts/pointinpoly/
 		- http://facultyfp.salisbury.edu/despickler/personal/Resources/Graphics/Resources/barycentric.pdf
 		(this implementation is from the first link)
-		vector0 is the vector of m_vertices[0] to m_vertices[2]
-		vector1 is the vector of m_vertices[0] to m_vertices[1]
+		m_edge0 is the vector of m_vertices[0] to m_vertices[2]
+		m_edge1 is the vector of m_vertices[0] to m_vertices[1]
 		vector2 is the vector of m_vertices[0] to the intersection point of the ray
+		The dot products of the edges and the inverse denominator are worked out by Commit
 		*/
-		Vector3 vector0 = m_vertices[2].operator-(m_vertices[0]); // point 0 to point 2
-		Vector3 vector1 = m_vertices[1].operator-(m_vertices[0]); // point 0 to point 1
 		Vector3 vector2 = intersection_point.operator-(m_vertices[0]); // point 0 to intersection point
 
 		// Computes Dot products
-		double dot00 = vector0.DotProduct(vector0);
-		double dot01 = vector0.DotProduct(vector1);
-		double dot02 = vector0.DotProduct(vector2);
-		double dot11 = vector1.DotProduct(vector1);
-		double dot12 = vector1.DotProduct(vector2);
+		double dot02 = m_edge0.DotProduct(vector2);
+		double dot12 = m_edge1.DotProduct(vector2);
 
 		// Computes Barycentric coordinates
-		double invDenom = 1 / (dot00 * dot11 - dot01 * dot01); // Inverse Denominator
-		double u = (dot11 * dot02 - dot01 * dot12) * invDenom;
-		double v = (dot00 * dot12 - dot01 * dot02) * invDenom;
+		double u = (m_dot11 * dot02 - m_dot01 * dot12) * m_invDenom;
+		double v = (m_dot00 * dot12 - m_dot01 * dot02) * m_invDenom;
 
 		// If point is outside zero, reset t
 		if (u < 0 || v < 0 || u + v >= 1)
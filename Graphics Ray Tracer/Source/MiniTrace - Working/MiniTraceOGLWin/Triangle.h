@@ -19,13 +19,54 @@ private:
 	Vector3 m_vertices[3];
 	Vector3 m_normal;
 
+	//ray independent parts of the plane and barycentric tests, set by Commit
+	Vector3 m_edge0;		//vertex 0 to vertex 2
+	Vector3 m_edge1;		//vertex 0 to vertex 1
+	double m_offset;		//plane offset, -vertex 0 dot normal
+	double m_dot00, m_dot01, m_dot11;
+	double m_invDenom;
+	AABB m_bounds;
+
 public:
 	Triangle();
 	Triangle(Vector3 pos1, Vector3 pos2, Vector3 pos3);
 	~Triangle();
 	
+	//Call Commit, or Scene::Commit, after changing the triangle
 	void SetTriangle(Vector3 v0, Vector3 v1, Vector3 v2);
 
+	inline Vector3 GetVertex(int i)
+	{
+		return m_vertices[i];
+	}
+
+	inline Vector3 GetNormal()
+	{
+		return m_normal;
+	}
+
+	inline Vector3 GetEdge(int i)
+	{
+		return i == 0 ? m_edge0 : m_edge1;
+	}
+
+	inline double GetPlaneOffset()
+	{
+		return m_offset;
+	}
+
+	//the dot products of the edges, 00, 01 and 11, then the inverse denominator of the barycentric test
+	inline void GetBarycentricTerms(double& dot00, double& dot01, double& dot11, double& invDenom)
+	{
+		dot00 = m_dot00;
+		dot01 = m_dot01;
+		dot11 = m_dot11;
+		invDenom = m_invDenom;
+	}
+
+	void Commit();
+	bool Translate(const Vector3& offset);
 	RayHitResult IntersectByRay(Ray& ray);
+	bool GetBounds(AABB& bounds);
 };
 
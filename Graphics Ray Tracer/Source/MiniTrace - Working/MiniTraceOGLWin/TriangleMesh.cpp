@@ -0,0 +1,463 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "TriangleMesh.h"
+
+#define MESH_EPSILON	1.0e-9		//hits closer than this to the ray start are the surface the ray left
+
+TriangleMesh::TriangleMesh()
+{
+	m_primtype = PRIMTYPE_Mesh;
+}
+
+TriangleMesh::~TriangleMesh()
+{
+}
+
+//Reads an OBJ index, which counts from 1 or from the end if negative.
+//Returns false if there is no number or it is out of range.
+static bool ReadIndex(const char*& text, size_t count, unsigned int& index)
+{
+	char* end;
+	long value = strtol(text, &end, 10);
+
+	if (end == text)
+		return false;
+	text = end;
+
+	if (value < 0)
+		value += (long)count;
+	else
+		value -= 1;
+
+	if (value < 0 || value >= (long)count)
+		return false;
+
+	index = (unsigned int)value;
+	return true;
+}
+
+bool TriangleMesh::LoadOBJ(const char* filename, std::string& error)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file)
+	{
+		error = std::string("Cannot open ") + filename;
+		return false;
+	}
+
+	m_px.clear(); m_py.clear(); m_pz.clear();
+	m_nx.clear(); m_ny.clear(); m_nz.clear();
+	m_positionIndices.clear();
+	m_normalIndices.clear();
+
+	std::vector<unsigned int> facePositions;
+	std::vector<unsigned int> faceNormals;
+	bool allNormals = true;		//smooth normals are only used if every face has them
+	int lineNumber = 0;
+	char line[4096];
+
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+		const char* text = line;
+
+		while (*text == ' ' || *text == '\t')
+			text++;
+
+		if (text[0] == 'v' && (text[1] == ' ' || text[1] == '\t'))
+		{
+			char* end;
+			double x = strtod(text + 2, &end);
+			double y = strtod(end, &end);
+			double z = strtod(end, &end);
+
+			m_px.push_back((float)x);
+			m_py.push_back((float)y);
+			m_pz.push_back((float)z);
+		}
+		else if (text[0] == 'v' && text[1] == 'n')
+		{
+			char* end;
+			double x = strtod(text + 2, &end);
+			double y = strtod(end, &end);
+			double z = strtod(end, &end);
+
+			m_nx.push_back((float)x);
+			m_ny.push_back((float)y);
+			m_nz.push_back((float)z);
+		}
+		else if (text[0] == 'f' && (text[1] == ' ' || text[1] == '\t'))
+		{
+			//each corner is v, v/vt, v//vn or v/vt/vn
+			facePositions.clear();
+			faceNormals.clear();
+			text += 2;
+
+			while (true)
+			{
+				while (*text == ' ' || *text == '\t')
+					text++;
+
+				if (*text == '\0' || *text == '\r' || *text == '\n' || *text == '#')
+					break;
+
+				unsigned int position, normal;
+				bool hasNormal = false;
+
+				if (!ReadIndex(text, m_px.size(), position))
+				{
+					fclose(file);
+					error = std::string(filename) + ":" + std::to_string(lineNumber) + ": bad vertex index";
+					return false;
+				}
+
+				if (*text == '/')
+				{
+					text++;
+					if (*text != '/')
+						strtol(text, (char**)&text, 10);	//texture coordinates are not used
+
+					if (*text == '/')
+					{
+						text++;
+						if (!ReadIndex(text, m_nx.size(), normal))
+						{
+							fclose(file);
+							error = std::string(filename) + ":" + std::to_string(lineNumber) + ": bad normal index";
+							return false;
+						}
+						hasNormal = true;
+					}
+				}
+
+				facePositions.push_back(position);
+				faceNormals.push_back(hasNormal ? normal : 0);
+				allNormals = allNormals && hasNormal;
+			}
+
+			for (size_t i = 2; i < facePositions.size(); i++)
+			{
+				m_positionIndices.push_back(facePositions[0]);
+				m_positionIndices.push_back(facePositions[i - 1]);
+				m_positionIndices.push_back(facePositions[i]);
+
+				m_normalIndices.push_back(faceNormals[0]);
+				m_normalIndices.push_back(faceNormals[i - 1]);
+				m_normalIndices.push_back(faceNormals[i]);
+			}
+		}
+	}
+
+	fclose(file);
+
+	if (m_positionIndices.empty())
+	{
+		error = std::string(filename) + ": no faces";
+		return false;
+	}
+
+	//Commit works the normals out from the faces instead
+	if (!allNormals)
+	{
+		m_nx.clear(); m_ny.clear(); m_nz.clear();
+		m_normalIndices.clear();
+	}
+
+	return true;
+}
+
+bool TriangleMesh::SetBuffers(std::vector<float> positions[3], std::vector<float> normals[3],
+	std::vector<unsigned int>& positionIndices, std::vector<unsigned int>& normalIndices)
+{
+	size_t numPositions = positions[0].size();
+	size_t numNormals = normals[0].size();
+
+	if (positions[1].size() != numPositions || positions[2].size() != numPositions
+		|| normals[1].size() != numNormals || normals[2].size() != numNormals
+		|| positionIndices.size() % 3 != 0
+		|| (!normalIndices.empty() && normalIndices.size() != positionIndices.size()))
+		return false;
+
+	for (size_t i = 0; i < positionIndices.size(); i++)
+	{
+		if (positionIndices[i] >= numPositions)
+			return false;
+	}
+
+	for (size_t i = 0; i < normalIndices.size(); i++)
+	{
+		if (normalIndices[i] >= numNormals)
+			return false;
+	}
+
+	m_px.swap(positions[0]); m_py.swap(positions[1]); m_pz.swap(positions[2]);
+	m_nx.swap(normals[0]); m_ny.swap(normals[1]); m_nz.swap(normals[2]);
+	m_positionIndices.swap(positionIndices);
+	m_normalIndices.swap(normalIndices);
+
+	for (int i = 0; i < 3; i++)
+	{
+		positions[i].clear();
+		normals[i].clear();
+	}
+	positionIndices.clear();
+	normalIndices.clear();
+	return true;
+}
+
+void TriangleMesh::Fit(const Vector3& centre, double size)
+{
+	AABB bounds;
+	for (size_t i = 0; i < m_px.size(); i++)
+	{
+		bounds.Expand(GetPosition((unsigned int)i));
+	}
+
+	if (bounds.IsEmpty())
+		return;
+
+	Vector3 extent = bounds.max - bounds.min;
+	double longest = std::max(extent[0], std::max(extent[1], extent[2]));
+	double scale = longest > 0.0 ? size / longest : 1.0;
+	Vector3 offset = centre - bounds.GetCentre() * scale;
+
+	for (size_t i = 0; i < m_px.size(); i++)
+	{
+		m_px[i] = (float)(m_px[i] * scale + offset[0]);
+		m_py[i] = (float)(m_py[i] * scale + offset[1]);
+		m_pz[i] = (float)(m_pz[i] * scale + offset[2]);
+	}
+}
+
+void TriangleMesh::ComputeVertexNormals()
+{
+	size_t numVertices = m_px.size();
+	std::vector<double> nx(numVertices, 0.0), ny(numVertices, 0.0), nz(numVertices, 0.0);
+
+	//the cross product of two edges is the face normal scaled by twice the area,
+	//summing them weights each face by its area
+	for (size_t i = 0; i < m_positionIndices.size(); i += 3)
+	{
+		unsigned int* tri = &m_positionIndices[i];
+		Vector3 v0 = GetPosition(tri[0]);
+		Vector3 normal = (GetPosition(tri[1]) - v0).CrossProduct(GetPosition(tri[2]) - v0);
+
+		for (int j = 0; j < 3; j++)
+		{
+			nx[tri[j]] += normal[0];
+			ny[tri[j]] += normal[1];
+			nz[tri[j]] += normal[2];
+		}
+	}
+
+	m_nx.resize(numVertices);
+	m_ny.resize(numVertices);
+	m_nz.resize(numVertices);
+
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		Vector3 normal(nx[i], ny[i], nz[i]);
+		normal.Normalise();
+
+		m_nx[i] = (float)normal[0];
+		m_ny[i] = (float)normal[1];
+		m_nz[i] = (float)normal[2];
+	}
+
+	m_normalIndices = m_positionIndices;
+}
+
+void TriangleMesh::Commit()
+{
+	if (m_normalIndices.size() != m_positionIndices.size())
+		ComputeVertexNormals();
+
+	int numTriangles = GetTriangleCount();
+	std::vector<AABB> bounds(numTriangles);
+	m_bounds.SetEmpty();
+
+	for (int i = 0; i < numTriangles; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			bounds[i].Expand(GetPosition(m_positionIndices[i * 3 + j]));
+		}
+		m_bounds.Expand(bounds[i]);
+	}
+
+	m_bvh.Build(bounds);
+
+	//store the triangles in the order the BVH leaves list them, so a leaf reads
+	//one run of indices, then the BVH items are just the triangle numbers
+	std::vector<int> order = m_bvh.GetItems();
+	std::vector<BVH::Node> nodes = m_bvh.GetNodes();
+	std::vector<unsigned int> positionIndices(m_positionIndices.size());
+	std::vector<unsigned int> normalIndices(m_normalIndices.size());
+
+	for (int i = 0; i < numTriangles; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			positionIndices[i * 3 + j] = m_positionIndices[order[i] * 3 + j];
+			normalIndices[i * 3 + j] = m_normalIndices[order[i] * 3 + j];
+		}
+		order[i] = i;
+	}
+
+	m_positionIndices.swap(positionIndices);
+	m_normalIndices.swap(normalIndices);
+	m_bvh.Assign(nodes, order, numTriangles, m_bvh.GetBuildMethod());
+}
+
+bool TriangleMesh::Translate(const Vector3& offset)
+{
+	for (size_t i = 0; i < m_px.size(); i++)
+	{
+		m_px[i] = (float)(m_px[i] + offset[0]);
+		m_py[i] = (float)(m_py[i] + offset[1]);
+		m_pz[i] = (float)(m_pz[i] + offset[2]);
+	}
+
+	//not committed yet, Commit will build the BVH over the new positions
+	if (m_bvh.IsEmpty())
+		return true;
+
+	//Commit stored the triangles in the BVH's item order, so item i is triangle i
+	int numTriangles = GetTriangleCount();
+	std::vector<AABB> bounds(numTriangles);
+	m_bounds.SetEmpty();
+
+	for (int i = 0; i < numTriangles; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			bounds[i].Expand(GetPosition(m_positionIndices[i * 3 + j]));
+		}
+		m_bounds.Expand(bounds[i]);
+	}
+
+	m_bvh.Refit(bounds);
+	return true;
+}
+
+bool TriangleMesh::GetBounds(AABB& bounds)
+{
+	bounds = m_bounds;
+	return !m_bounds.IsEmpty();
+}
+
+bool TriangleMesh::IntersectTriangle(int tri, const Vector3& start, const Vector3& dir, double& t, double& u, double& v) const
+{
+	const unsigned int* index = &m_positionIndices[tri * 3];
+	Vector3 v0 = GetPosition(index[0]);
+	Vector3 edge1 = GetPosition(index[1]) - v0;
+	Vector3 edge2 = GetPosition(index[2]) - v0;
+
+	Vector3 p = dir.CrossProduct(edge2);
+	double det = edge1.DotProduct(p);
+
+	//the ray runs along the triangle's plane
+	if (fabs(det) < 1.0e-12)
+		return false;
+
+	double invDet = 1.0 / det;
+	Vector3 s = start - v0;
+
+	u = s.DotProduct(p) * invDet;
+	if (u < 0.0 || u > 1.0)
+		return false;
+
+	Vector3 q = s.CrossProduct(edge1);
+
+	v = dir.DotProduct(q) * invDet;
+	if (v < 0.0 || u + v > 1.0)
+		return false;
+
+	t = edge2.DotProduct(q) * invDet;
+	return t > MESH_EPSILON;
+}
+
+bool TriangleMesh::FindHit(Ray& ray, double& t, int& triangle, double& u, double& v) const
+{
+	Vector3 start = ray.GetRayStart();
+	Vector3 dir = ray.GetRay();
+	double tMax = FARFAR_AWAY;
+	int hitTriangle = -1;
+	double hitU = 0.0, hitV = 0.0;
+
+	auto closest = [&](int tri, double& tClosest) -> bool
+	{
+		double triT, triU, triV;
+
+		if (IntersectTriangle(tri, start, dir, triT, triU, triV) && triT < tClosest)
+		{
+			tClosest = triT;
+			hitTriangle = tri;
+			hitU = triU;
+			hitV = triV;
+			return true;
+		}
+		return false;
+	};
+
+	m_bvh.ClosestHit(ray, tMax, closest);
+
+	if (hitTriangle < 0)
+		return false;
+
+	t = tMax;
+	triangle = hitTriangle;
+	u = hitU;
+	v = hitV;
+	return true;
+}
+
+RayHitResult TriangleMesh::GetHit(Ray& ray, double t, int triangle, double u, double v)
+{
+	RayHitResult result = Ray::s_defaultHitResult;
+
+	Vector3 start = ray.GetRayStart();
+	Vector3 dir = ray.GetRay();
+
+	//interpolate the vertex normals with the barycentric weights of the hit
+	const unsigned int* normals = &m_normalIndices[triangle * 3];
+	Vector3 normal = GetVertexNormal(normals[0]) * (1.0 - u - v)
+		+ GetVertexNormal(normals[1]) * u
+		+ GetVertexNormal(normals[2]) * v;
+	normal.Normalise();
+
+	//both sides are hit, so the normal faces the side the ray came from
+	if (normal.DotProduct(dir) > 0.0)
+		normal = normal * -1.0;
+
+	result.t = t;
+	result.point = start + dir * t;
+	result.normal = normal;
+	result.data = (void*)this;
+
+	return result;
+}
+
+RayHitResult TriangleMesh::IntersectByRay(Ray& ray)
+{
+	double t, u, v;
+	int triangle;
+
+	if (!FindHit(ray, t, triangle, u, v))
+		return Ray::s_defaultHitResult;
+
+	return GetHit(ray, t, triangle, u, v);
+}
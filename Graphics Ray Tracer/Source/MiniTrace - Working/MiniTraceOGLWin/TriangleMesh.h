@@ -0,0 +1,121 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "BVH.h"
+#include "Primitive.h"
+#include "Ray.h"
+#include "Vector3.h"
+
+//A triangle mesh stored as one primitive. Vertex positions and normals are kept as shared,
+//indexed buffers with one array per component, and the triangles are found through the
+//mesh's own BVH, so the scene BVH sees the whole mesh as a single item.
+//Normals are interpolated across each triangle. Unlike Triangle, both sides of a face are hit,
+//and the normal of a hit is turned to face the ray.
+class TriangleMesh : public Primitive
+{
+	private:
+		//vertex positions and normals, one array per component
+		std::vector<float>			m_px, m_py, m_pz;
+		std::vector<float>			m_nx, m_ny, m_nz;
+
+		//three entries per triangle, into the positions and the normals
+		std::vector<unsigned int>	m_positionIndices;
+		std::vector<unsigned int>	m_normalIndices;
+
+		BVH							m_bvh;			//over the triangles, which are stored in its item order
+		AABB						m_bounds;
+
+		inline Vector3 GetPosition(unsigned int i) const
+		{
+			return Vector3(m_px[i], m_py[i], m_pz[i]);
+		}
+
+		inline Vector3 GetVertexNormal(unsigned int i) const
+		{
+			return Vector3(m_nx[i], m_ny[i], m_nz[i]);
+		}
+
+		//Möller-Trumbore test of one triangle, u and v are the barycentric weights of vertices 1 and 2
+		bool IntersectTriangle(int tri, const Vector3& start, const Vector3& dir, double& t, double& u, double& v) const;
+		void ComputeVertexNormals();
+
+	public:
+		TriangleMesh();
+		~TriangleMesh();
+
+		//Reads the v, vn and f lines of a Wavefront OBJ file, anything else is ignored.
+		//Faces with more than three vertices are split into fans.
+		//Returns false and sets error if the file cannot be read or is malformed.
+		bool LoadOBJ(const char* filename, std::string& error);
+
+		//Scales and moves the mesh so its longest side is size long and its bounds are centred on centre
+		void Fit(const Vector3& centre, double size);
+
+		//Computes the missing normals and builds the mesh's BVH
+		void Commit();
+
+		//Moves every vertex and refits the mesh's BVH rather than building it again
+		bool Translate(const Vector3& offset);
+
+		inline int GetTriangleCount() const
+		{
+			return (int)m_positionIndices.size() / 3;
+		}
+
+		inline int GetVertexCount() const
+		{
+			return (int)m_px.size();
+		}
+
+		inline const BVH& GetBVH() const
+		{
+			return m_bvh;
+		}
+
+		//The raw buffers, axis 0 to 2 picks the x, y or z array
+		inline const std::vector<float>& GetPositionArray(int axis) const
+		{
+			return axis == 0 ? m_px : axis == 1 ? m_py : m_pz;
+		}
+
+		inline const std::vector<float>& GetNormalArray(int axis) const
+		{
+			return axis == 0 ? m_nx : axis == 1 ? m_ny : m_nz;
+		}
+
+		inline const std::vector<unsigned int>& GetPositionIndices() const
+		{
+			return m_positionIndices;
+		}
+
+		inline const std::vector<unsigned int>& GetNormalIndices() const
+		{
+			return m_normalIndices;
+		}
+
+		//Takes over buffers laid out like the Get...Array ones, the vectors are left empty.
+		//Returns false if an index is out of range. Call Commit afterwards.
+		bool SetBuffers(std::vector<float> positions[3], std::vector<float> normals[3],
+			std::vector<unsigned int>& positionIndices, std::vector<unsigned int>& normalIndices);
+
+		//The closest triangle the ray hits, with the barycentric weights u and v of its vertices
+		//1 and 2, without working out the hit's point and normal
+		bool FindHit(Ray& ray, double& t, int& triangle, double& u, double& v) const;
+
+		//The hit record of a hit found by FindHit
+		RayHitResult GetHit(Ray& ray, double t, int triangle, double u, double v);
+
+		RayHitResult IntersectByRay(Ray& ray);
+		bool GetBounds(AABB& bounds);
+};
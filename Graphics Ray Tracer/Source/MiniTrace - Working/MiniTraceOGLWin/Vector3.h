@@ -8,48 +8,275 @@
 * however the author does not guarantee its performance.
 ---------------------------------------------------------------------*/
 #pragma once
-class Vector3
+
+#include <math.h>
+#include <cmath>
+
+//Vector3 is a plain value: no virtual functions and no user defined copy, so it is
+//trivially copyable and everything is inlined into the callers.
+//Visual Studio 2013 has no constexpr, there the functions are just inline.
+#if !defined(_MSC_VER) || _MSC_VER >= 1900
+#define VECTOR3_CONSTEXPR constexpr
+#define VECTOR3_HAS_CONSTEXPR 1
+#else
+#define VECTOR3_CONSTEXPR inline
+#define VECTOR3_HAS_CONSTEXPR 0
+#endif
+
+//Define MINITRACE_VECTOR3_AVX on an AVX build to pad vectors to four doubles (x, y, z
+//and an unused zero) and add, subtract and scale them with AVX. The results are the same
+//as the plain code. Unaligned loads are used as containers do not align to 32 bytes before C++17.
+#if defined(MINITRACE_VECTOR3_AVX) && defined(__AVX__) && VECTOR3_HAS_CONSTEXPR
+#define VECTOR3_AVX 1
+#include <immintrin.h>
+#else
+#define VECTOR3_AVX 0
+#endif
+
+template <class Real> class Vector3T;
+
+//Elements in a vector: three, or four when Vector3 is padded for AVX
+template <class Real> struct Vector3Storage
+{
+	enum { Size = 3 };
+};
+
+#if VECTOR3_AVX
+template <> struct Vector3Storage<double>
+{
+	enum { Size = 4 };
+};
+#endif
+
+//A 3D vector of float or double elements. Vector3 (double) is used throughout the tracer,
+//Vector3f holds the single precision copies used by the float packet kernels.
+template <class Real>
+class Vector3T
 {
 private:
-	double		m_element[3];
+	Real		m_element[Vector3Storage<Real>::Size];
 
 public:
-	Vector3()
+#if VECTOR3_HAS_CONSTEXPR
+	//a padding element is zero
+	constexpr Vector3T() : m_element{ 0, 0, 0 } {}
+	constexpr Vector3T(Real x, Real y, Real z) : m_element{ x, y, z } {}
+#else
+	Vector3T()
 	{
-		m_element[0] = 0.0f;
-		m_element[1] = 0.0f;
-		m_element[2] = 0.0f;
+		SetVector(0, 0, 0);
 	}
-	
-	Vector3(double x, double y, double z)
+
+	Vector3T(Real x, Real y, Real z)
 	{
-		m_element[0] = x; m_element[1] = y; m_element[2] = z;
+		SetVector(x, y, z);
+	}
+#endif
+
+	//Converts from the other precision
+	template <class Other>
+	explicit Vector3T(const Vector3T<Other>& v) : Vector3T((Real)v[0], (Real)v[1], (Real)v[2])
+	{
+	}
+
+	VECTOR3_CONSTEXPR Real operator [] (const int i) const
+	{
+		return m_element[i];
+	}
+
+	inline Real& operator [] (const int i)
+	{
+		return m_element[i];
+	}
+
+	inline const Real* GetData() const
+	{
+		return m_element;
 	}
-	
-	virtual ~Vector3(){ ; }
-
-	double operator [] (const int i) const;
-	double& operator [] (const int i);
-	Vector3 operator + (const Vector3& rhs) const;
-	Vector3 operator - (const Vector3& rhs) const;
-	Vector3& operator = (const Vector3& rhs);
-	Vector3 operator * (const Vector3& rhs) const;
-	Vector3 operator * (double scale) const;
-
-	double Norm()	const;
-	double Norm_Sqr() const;
-	Vector3 Normalise();
-
-	double DotProduct(const Vector3& rhs) const;
-	Vector3 CrossProduct(const Vector3& rhs) const;
-	Vector3 Reflect(const Vector3& n) const;
-	Vector3 Refract(const Vector3& n, double r_coeff) const;
-	
-	void SetZero();
-	
-	inline void SetVector(double x, double y, double z)
-	{ 
-		m_element[0] = x; m_element[1] = y; m_element[2] = z; 
+
+#if VECTOR3_AVX
+	//Vector3Add and the others below have AVX versions for double
+	inline Vector3T operator + (const Vector3T& rhs) const
+	{
+		return Vector3Add(*this, rhs);
+	}
+
+	inline Vector3T operator - (const Vector3T& rhs) const
+	{
+		return Vector3Sub(*this, rhs);
+	}
+
+	inline Vector3T operator * (const Vector3T& rhs) const
+	{
+		return Vector3Mul(*this, rhs);
+	}
+
+	inline Vector3T operator * (Real scale) const
+	{
+		return Vector3Scale(*this, scale);
+	}
+#else
+	VECTOR3_CONSTEXPR Vector3T operator + (const Vector3T& rhs) const
+	{
+		return Vector3T(
+			m_element[0] + rhs.m_element[0],
+			m_element[1] + rhs.m_element[1],
+			m_element[2] + rhs.m_element[2]);
+	}
+
+	VECTOR3_CONSTEXPR Vector3T operator - (const Vector3T& rhs) const
+	{
+		return Vector3T(
+			m_element[0] - rhs.m_element[0],
+			m_element[1] - rhs.m_element[1],
+			m_element[2] - rhs.m_element[2]);
+	}
+
+	VECTOR3_CONSTEXPR Vector3T operator * (const Vector3T& rhs) const
+	{
+		return Vector3T(
+			m_element[0] * rhs.m_element[0],
+			m_element[1] * rhs.m_element[1],
+			m_element[2] * rhs.m_element[2]);
+	}
+
+	VECTOR3_CONSTEXPR Vector3T operator * (Real scale) const
+	{
+		return Vector3T(
+			m_element[0] * scale,
+			m_element[1] * scale,
+			m_element[2] * scale);
+	}
+#endif
+
+	//the square root is taken in the vector's own precision
+	inline Real Norm() const
+	{
+		return std::sqrt(Norm_Sqr());
+	}
+
+	VECTOR3_CONSTEXPR Real Norm_Sqr() const
+	{
+		return m_element[0] * m_element[0] + m_element[1] * m_element[1] + m_element[2] * m_element[2];
+	}
+
+	//Normalises this vector in place and returns a copy of it.
+	//Vectors shorter than 1e-8 are left alone.
+	inline Vector3T Normalise()
+	{
+		Real length = Norm();
+
+		if (length > 1.0e-8f)
+		{
+			Real invLen = 1 / length;
+
+			m_element[0] *= invLen;
+			m_element[1] *= invLen;
+			m_element[2] *= invLen;
+		}
+
+		return *this;
+	}
+
+	VECTOR3_CONSTEXPR Real DotProduct(const Vector3T& rhs) const
+	{
+		return m_element[0] * rhs.m_element[0] + m_element[1] * rhs.m_element[1] + m_element[2] * rhs.m_element[2];
+	}
+
+	VECTOR3_CONSTEXPR Vector3T CrossProduct(const Vector3T& rhs) const
+	{
+		return Vector3T(
+			(m_element[1] * rhs.m_element[2] - m_element[2] * rhs.m_element[1]),
+			(m_element[2] * rhs.m_element[0] - m_element[0] * rhs.m_element[2]),
+			(m_element[0] * rhs.m_element[1] - m_element[1] * rhs.m_element[0]));
+	}
+
+	//Mirrors this vector about the normal n
+	inline Vector3T Reflect(const Vector3T& n) const
+	{
+		// result = 2(normal dot this) * normal - this
+		Real thisNormDot = n.DotProduct(*this);
+
+		return Vector3T(
+			-(2 * thisNormDot * n[0] - m_element[0]),
+			-(2 * thisNormDot * n[1] - m_element[1]),
+			-(2 * thisNormDot * n[2] - m_element[2]));
+	}
+
+	//Bends this vector through a surface with normal n, r_coeff is the ratio of the refractive
+	//indices (index 1 / index 2). Returns a zero vector on total internal reflection.
+	inline Vector3T Refract(const Vector3T& n, Real r_coeff) const
+	{
+		//Method from this link: http://www.flipcode.com/archives/reflection_transmission.pdf
+		Real incidentAngle = DotProduct(n);
+		Real sinRefractedSqr = r_coeff * r_coeff * (1 - incidentAngle * incidentAngle);
+
+		if (sinRefractedSqr <= 1)
+			return (*this * r_coeff) - (n * (r_coeff * incidentAngle + std::sqrt(1 - sinRefractedSqr)));
+
+		return Vector3T();
+	}
+
+	inline void SetZero()
+	{
+		SetVector(0, 0, 0);
+	}
+
+	inline void SetVector(Real x, Real y, Real z)
+	{
+		m_element[0] = x; m_element[1] = y; m_element[2] = z;
 	}
 };
 
+typedef Vector3T<double>	Vector3;
+typedef Vector3T<float>		Vector3f;
+
+#if VECTOR3_AVX
+template <class Real> inline Vector3T<Real> Vector3Add(const Vector3T<Real>& a, const Vector3T<Real>& b)
+{
+	return Vector3T<Real>(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+}
+
+template <class Real> inline Vector3T<Real> Vector3Sub(const Vector3T<Real>& a, const Vector3T<Real>& b)
+{
+	return Vector3T<Real>(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+template <class Real> inline Vector3T<Real> Vector3Mul(const Vector3T<Real>& a, const Vector3T<Real>& b)
+{
+	return Vector3T<Real>(a[0] * b[0], a[1] * b[1], a[2] * b[2]);
+}
+
+template <class Real> inline Vector3T<Real> Vector3Scale(const Vector3T<Real>& a, Real scale)
+{
+	return Vector3T<Real>(a[0] * scale, a[1] * scale, a[2] * scale);
+}
+
+//The padded double vectors, the unused fourth element stays zero
+inline Vector3 Vector3FromAvx(__m256d v)
+{
+	alignas(32) double e[4];
+	_mm256_store_pd(e, v);
+	return Vector3(e[0], e[1], e[2]);
+}
+
+inline Vector3 Vector3Add(const Vector3& a, const Vector3& b)
+{
+	return Vector3FromAvx(_mm256_add_pd(_mm256_loadu_pd(a.GetData()), _mm256_loadu_pd(b.GetData())));
+}
+
+inline Vector3 Vector3Sub(const Vector3& a, const Vector3& b)
+{
+	return Vector3FromAvx(_mm256_sub_pd(_mm256_loadu_pd(a.GetData()), _mm256_loadu_pd(b.GetData())));
+}
+
+inline Vector3 Vector3Mul(const Vector3& a, const Vector3& b)
+{
+	return Vector3FromAvx(_mm256_mul_pd(_mm256_loadu_pd(a.GetData()), _mm256_loadu_pd(b.GetData())));
+}
+
+inline Vector3 Vector3Scale(const Vector3& a, double scale)
+{
+	return Vector3FromAvx(_mm256_mul_pd(_mm256_loadu_pd(a.GetData()), _mm256_set1_pd(scale)));
+}
+#endif
@@ -0,0 +1,260 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#include <algorithm>
+
+#include "Wavefront.h"
+#include "RayPacket.h"
+#include "RayTracer.h"
+#include "RenderStats.h"
+#include "Scene.h"
+
+Wavefront::Wavefront()
+{
+	m_background.red = m_background.green = m_background.blue = 0.0f;
+	m_levels.resize(1);
+}
+
+void Wavefront::Reset()
+{
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		for (int kind = 0; kind < RAY_KIND_COUNT; kind++)
+		{
+			m_levels[i].rays[kind].clear();
+		}
+		m_levels[i].nodes.clear();
+	}
+	m_shadowRays.clear();
+}
+
+int Wavefront::AddPrimaryRay(const Ray& ray)
+{
+	QueuedRay queued;
+	queued.ray = ray;
+	queued.node = -1;
+
+	m_levels[0].rays[RAY_PRIMARY].push_back(queued);
+	return (int)m_levels[0].rays[RAY_PRIMARY].size() - 1;
+}
+
+void Wavefront::Intersect(Scene* scene, std::vector<QueuedRay>& queue, int packetSize, RayPrecision precision, const SceneCut* cut)
+{
+	m_hits.resize(queue.size());
+
+	if (packetSize == 0)
+	{
+		for (size_t i = 0; i < queue.size(); i++)
+		{
+			m_hits[i] = scene->IntersectByRay(queue[i].ray, cut);
+		}
+		return;
+	}
+
+	RayPacket packet;
+
+	for (size_t first = 0; first < queue.size(); first += packetSize)
+	{
+		int count = (int)std::min(queue.size() - first, (size_t)packetSize);
+
+		packet.Reset(packetSize);
+		for (int lane = 0; lane < count; lane++)
+		{
+			Ray& ray = queue[first + lane].ray;
+			packet.AddRay(ray.GetRayStart(), ray.GetRay());
+		}
+		packet.Finish();
+
+		scene->IntersectPacket(packet, precision, cut);
+
+		for (int lane = 0; lane < count; lane++)
+		{
+			m_hits[first + lane] = scene->IntersectPacketLane(packet, lane, queue[first + lane].ray);
+		}
+	}
+}
+
+Colour Wavefront::GetRayColour(int level, int kind, int index) const
+{
+	if (index == CHILD_BACKGROUND)
+		return m_background;
+
+	int node = m_levels[level].rays[kind][index].node;
+	return node >= 0 ? m_levels[level].nodes[node].colour : m_background;
+}
+
+void Wavefront::Trace(RayTracer* tracer, Scene* scene, const Colour& background, int packetSize, const SceneCut* cut)
+{
+	int traceLevel = tracer->GetTraceLevel();
+	RayTracer::TraceFlag flags = tracer->m_traceflag;
+	LightSelection lights;
+	STATS_THREAD(stats);
+
+	m_background = background;
+
+	if ((int)m_levels.size() < traceLevel + 1)
+		m_levels.resize(traceLevel + 1);
+
+	//Level depth holds the rays TraceScene would be called for with a trace level of traceLevel - depth.
+	//As in ShadeHit, the rays spawned on the last level are not traced but take the background colour.
+	for (int depth = 0; depth < traceLevel; depth++)
+	{
+		Level& level = m_levels[depth];
+		Level& next = m_levels[depth + 1];
+		bool spawn = traceLevel - depth - 1 > 0;
+
+		for (int kind = 0; kind < RAY_KIND_COUNT; kind++)
+		{
+			std::vector<QueuedRay>& queue = level.rays[kind];
+
+			if (queue.empty())
+				continue;
+
+			STATS_ADD(stats, depthHistogram[RenderStats::DepthBucket(depth)], queue.size());
+			//reflected and refracted rays scatter too much to gain from packets
+			Intersect(scene, queue, kind == RAY_PRIMARY ? packetSize : 0, tracer->GetPrecision(), kind == RAY_PRIMARY ? cut : nullptr);
+
+			for (size_t i = 0; i < queue.size(); i++)
+			{
+				RayHitResult& result = m_hits[i];
+
+				if (!result.data)
+				{
+					queue[i].node = -1;
+					continue;
+				}
+
+				Ray& ray = queue[i].ray;
+				Vector3 start = ray.GetRayStart();
+				Primitive* prim = (Primitive*)result.data;
+
+				//as in ShadeHit, only the lights that reach the hit light and shadow it
+				tracer->SelectLights(scene, result.point, lights);
+
+				Node node;
+				node.colour = tracer->CalculateLighting(lights, &start, &result);
+				node.reflection = node.refraction = CHILD_NONE;
+				node.occluded = 0;
+
+				//only spheres and boxes reflect and refract
+				bool secondary = prim->m_primtype == Primitive::PRIMTYPE_Sphere || prim->m_primtype == Primitive::PRIMTYPE_Box;
+
+				if ((flags & RayTracer::TRACE_REFLECTION) && secondary)
+				{
+					node.reflection = CHILD_BACKGROUND;
+
+					if (spawn)
+					{
+						QueuedRay reflected;
+						reflected.ray.SetRay(result.point, ray.GetRay().Reflect(result.normal));
+						reflected.node = -1;
+
+						STATS_ADD(stats, reflectionRays, 1);
+						node.reflection = (int)next.rays[RAY_REFLECTION].size();
+						next.rays[RAY_REFLECTION].push_back(reflected);
+					}
+				}
+
+				if ((flags & RayTracer::TRACE_REFRACTION) && secondary)
+				{
+					node.refraction = CHILD_BACKGROUND;
+
+					if (spawn)
+					{
+						float coeff = 1 / 1.5;
+						Vector3 refractedVector = ray.GetRay().Refract(result.normal, coeff);
+
+						QueuedRay refracted;
+						refracted.ray.SetRay(result.point + (refractedVector * 0.1), refractedVector);
+						refracted.node = -1;
+
+						STATS_ADD(stats, refractionRays, 1);
+						node.refraction = (int)next.rays[RAY_REFRACTION].size();
+						next.rays[RAY_REFRACTION].push_back(refracted);
+					}
+				}
+
+				queue[i].node = (int)level.nodes.size();
+
+				if ((flags & RayTracer::TRACE_SHADOW) && spawn)
+				{
+					for (int l = 0; l < (int)lights.lights.size(); l++)
+					{
+						Vector3 lightPos = lights.lights[l].light->GetLightPosition();
+						Vector3 shadowDir = lightPos - result.point;
+						shadowDir = shadowDir.Normalise();
+
+						ShadowRay shadow;
+						shadow.ray.SetRay(result.point + (shadowDir * 0.1), shadowDir);
+						shadow.maxT = (lightPos - shadow.ray.GetRayStart()).DotProduct(shadowDir);
+						shadow.node = queue[i].node;
+						shadow.light = tracer->IsShadowCache() ? lights.lights[l].index : -1;
+						shadow.depth = depth;
+
+						m_shadowRays.push_back(shadow);
+					}
+				}
+
+				level.nodes.push_back(node);
+			}
+		}
+
+		STATS_ADD(stats, shadowRays, m_shadowRays.size());
+
+		for (size_t i = 0; i < m_shadowRays.size(); i++)
+		{
+			if (scene->Occluded(m_shadowRays[i].ray, m_shadowRays[i].maxT, m_shadowRays[i].light, m_shadowRays[i].depth))
+			{
+				STATS_ADD(stats, occludedShadowRays, 1);
+				level.nodes[m_shadowRays[i].node].occluded++;
+			}
+		}
+		m_shadowRays.clear();
+
+		if (next.rays[RAY_REFLECTION].empty() && next.rays[RAY_REFRACTION].empty())
+			break;
+	}
+
+	//combine the colours bottom up: lighting, times reflection, times refraction, then the shadows
+	for (int depth = traceLevel - 1; depth >= 0; depth--)
+	{
+		Level& level = m_levels[depth];
+
+		for (size_t i = 0; i < level.nodes.size(); i++)
+		{
+			Node& node = level.nodes[i];
+			Colour outcolour = node.colour;
+
+			if (node.reflection != CHILD_NONE)
+			{
+				Colour reflection = GetRayColour(depth + 1, RAY_REFLECTION, node.reflection);
+				outcolour.red *= reflection.red;
+				outcolour.green *= reflection.green;
+				outcolour.blue *= reflection.blue;
+			}
+
+			if (node.refraction != CHILD_NONE)
+			{
+				Colour refraction = GetRayColour(depth + 1, RAY_REFRACTION, node.refraction);
+				outcolour.red *= refraction.red;
+				outcolour.green *= refraction.green;
+				outcolour.blue *= refraction.blue;
+			}
+
+			for (int l = 0; l < node.occluded; l++)
+			{
+				outcolour.red /= 10;
+				outcolour.blue /= 10;
+				outcolour.green /= 10;
+			}
+
+			node.colour = outcolour;
+		}
+	}
+}
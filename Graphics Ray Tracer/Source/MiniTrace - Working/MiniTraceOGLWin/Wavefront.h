@@ -0,0 +1,104 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+#pragma once
+
+#include <vector>
+
+#include "Material.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+class RayTracer;
+class Scene;
+struct SceneCut;
+
+//Traces a batch of primary rays one bounce level at a time instead of recursing ray by ray.
+//Each level keeps its primary, reflection and refraction rays in separate queues which are
+//intersected and shaded in bulk; the shadow rays of a level get a queue of their own.
+//Once the last level is done the colours are combined from the deepest level up, with the same
+//operations in the same order as RayTracer::TraceScene, so the image does not change.
+class Wavefront
+{
+	public:
+		enum RayKind
+		{
+			RAY_PRIMARY = 0,
+			RAY_REFLECTION,
+			RAY_REFRACTION,
+			RAY_KIND_COUNT
+		};
+
+	private:
+		enum
+		{
+			CHILD_NONE = -1,			//the hit spawns no ray of this kind
+			CHILD_BACKGROUND = -2,		//the ray would be past the last level, it counts as the background
+		};
+
+		//a ray waiting to be traced
+		struct QueuedRay
+		{
+			Ray		ray;
+			int		node;			//the hit it leads to on its level, -1 for a miss
+		};
+
+		struct ShadowRay
+		{
+			Ray		ray;
+			double	maxT;			//distance to the light
+			int		node;			//the hit the shadow falls on
+			int		depth;
+			int		light;			//index of the light for Scene::Occluded, -1 without the shadow cache
+		};
+
+		//A shaded hit. The colour starts as the lighting and is final once
+		//the rays spawned from the hit are done.
+		struct Node
+		{
+			Colour	colour;
+			int		reflection;		//index in the reflection queue of the next level, or a CHILD_ value
+			int		refraction;		//index in the refraction queue of the next level, or a CHILD_ value
+			int		occluded;		//lights blocked from the hit
+		};
+
+		struct Level
+		{
+			std::vector<QueuedRay>	rays[RAY_KIND_COUNT];
+			std::vector<Node>		nodes;
+		};
+
+		std::vector<Level>			m_levels;		//level 0 holds the primary rays
+		std::vector<ShadowRay>		m_shadowRays;	//shadow rays of the level being shaded
+		std::vector<RayHitResult>	m_hits;			//hits of the queue being shaded
+		Colour						m_background;
+
+		void	Intersect(Scene* scene, std::vector<QueuedRay>& queue, int packetSize, RayPrecision precision, const SceneCut* cut);
+		Colour	GetRayColour(int level, int kind, int index) const;
+
+	public:
+		Wavefront();
+
+		//Empties the queues, keeping their memory for the next batch
+		void	Reset();
+
+		//Queues a primary ray, returns its index for GetPrimaryColour
+		int		AddPrimaryRay(const Ray& ray);
+
+		//Traces every queued primary ray with the tracer's trace level and flags.
+		//A packet size of 4, 8 or 16 intersects the primary rays in SIMD packets, see RayTracer::SetPacketSize
+		//and RayTracer::SetPrecision. The primary rays test only what cut holds, if given; it must
+		//then be from a frustum round all of them (see Scene::Cull and Scene::IntersectPacket).
+		void	Trace(RayTracer* tracer, Scene* scene, const Colour& background, int packetSize, const SceneCut* cut = nullptr);
+
+		inline Colour GetPrimaryColour(int index) const
+		{
+			return GetRayColour(0, RAY_PRIMARY, index);
+		}
+};
@@ -0,0 +1,206 @@
+/*---------------------------------------------------------------------
+*
+* Copyright © 2015  Minsi Chen
+* E-mail: m.chen@derby.ac.uk
+*
+* The source is written for the Graphics I and II modules. You are free
+* to use and extend the functionality. The code provided here is functional
+* however the author does not guarantee its performance.
+---------------------------------------------------------------------*/
+// GLUT front end for Unix-like platforms, the counterpart of OGLWindow on Windows.
+
+#include <stdio.h>
+
+#ifdef __APPLE__
+#include <GLUT/glut.h>
+#else
+#include <GL/glut.h>
+#endif
+
+#include "CameraNavigator.h"
+#include "ImageWriter.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "SceneLoader.h"
+
+static RayTracer*	s_rayTracer = nullptr;
+static Scene*		s_scene = nullptr;
+static CameraNavigator	s_navigator;
+
+static void PrintUsage()
+{
+	printf("Use F1 - F7 keys to switch ray trace complexity\n");
+	printf("F1: Ambient only\n");
+	printf("F2: Full lighting no shadow, reflection and transmission\n");
+	printf("F3: Full lighting with shadow\n");
+	printf("F4: Full lighting  reflection\n");
+	printf("F5: Full lighting  refraction\n");
+	printf("F6: Ray trace everything (default)\n");
+	printf("F7: Switch between perspective projection and orthographic projection\n");
+	printf("F8: Save the image to MiniTrace.png\n");
+	printf("F9: Switch progressive rendering on and off\n");
+	printf("F10: Switch adaptive anti-aliasing, up to 16 samples per pixel, on and off\n");
+	printf("Left drag: Orbit the camera round the middle of the image\n");
+	printf("Right drag or shift and left drag: Pan the camera\n");
+}
+
+static void Display()
+{
+	s_rayTracer->DoRayTrace(s_scene);
+
+	//in progressive mode keep drawing until the last pass is done
+	if (!s_rayTracer->IsRenderComplete())
+		glutPostRedisplay();
+
+	const FrameBuffer& image = s_rayTracer->GetFrameBuffer();
+
+	if (image.GetData())
+	{
+		glRasterPos2i(0, 0);
+		glDrawPixels(image.GetWidth(), image.GetHeight(), GL_RGB, GL_FLOAT, image.GetData());
+	}
+
+	glFlush();
+}
+
+static void Reshape(int width, int height)
+{
+	glViewport(0, 0, width, height);
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0.0, width, 0.0, height, -1.0, 1.0);
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+}
+
+static void SpecialKey(int key, int x, int y)
+{
+	switch (key)
+	{
+	case GLUT_KEY_F1:
+		s_rayTracer->m_traceflag = RayTracer::TRACE_AMBIENT;
+		break;
+	case GLUT_KEY_F2:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC);
+		break;
+	case GLUT_KEY_F3:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC
+			| RayTracer::TRACE_SHADOW);
+		break;
+	case GLUT_KEY_F4:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC
+			| RayTracer::TRACE_REFLECTION | RayTracer::TRACE_SHADOW);
+		break;
+	case GLUT_KEY_F5:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC
+			| RayTracer::TRACE_REFRACTION);
+		break;
+	case GLUT_KEY_F6:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(RayTracer::TRACE_AMBIENT | RayTracer::TRACE_DIFFUSE_AND_SPEC
+			| RayTracer::TRACE_REFRACTION | RayTracer::TRACE_REFLECTION | RayTracer::TRACE_SHADOW);
+		break;
+	case GLUT_KEY_F7:
+		s_rayTracer->m_traceflag = (RayTracer::TraceFlag)(s_rayTracer->m_traceflag ^ RayTracer::TRACE_ORTHO);
+		break;
+	case GLUT_KEY_F8:
+		{
+			PNGWriter writer;
+			writer.Write("MiniTrace.png", s_rayTracer->GetFrameBuffer());
+		}
+		return;
+	case GLUT_KEY_F9:
+		s_rayTracer->SetProgressive(!s_rayTracer->IsProgressive());
+		break;
+	case GLUT_KEY_F10:
+		s_rayTracer->SetAntiAliasing(s_rayTracer->GetAntiAliasing() > 1 ? 1 : 16);
+		break;
+	default:
+		return;
+	}
+
+	s_rayTracer->ResetRenderCount();
+	glutPostRedisplay();
+}
+
+static void Mouse(int button, int state, int x, int y)
+{
+	if (button != GLUT_LEFT_BUTTON && button != GLUT_RIGHT_BUTTON && button != GLUT_MIDDLE_BUTTON)
+		return;
+
+	if (state == GLUT_DOWN)
+	{
+		bool pan = button != GLUT_LEFT_BUTTON || (glutGetModifiers() & GLUT_ACTIVE_SHIFT);
+		s_navigator.Begin(s_scene, *s_rayTracer, x, y, pan ? CameraNavigator::NAVIGATE_PAN : CameraNavigator::NAVIGATE_ORBIT);
+	}
+	else if (s_navigator.IsDragging())
+	{
+		s_navigator.End();
+
+		//the reprojected images are approximate, trace the view properly now it has stopped
+		s_rayTracer->ResetRenderCount();
+		glutPostRedisplay();
+	}
+}
+
+static void Motion(int x, int y)
+{
+	//the next Display traces only what the old image cannot show
+	if (s_navigator.Drag(s_scene, x, y))
+	{
+		s_rayTracer->Reproject(s_scene);
+		glutPostRedisplay();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int width = 800;
+	int height = 600;
+
+	glutInit(&argc, argv);
+	glutInitDisplayMode(GLUT_RGBA | GLUT_SINGLE);
+	glutInitWindowSize(width, height);
+	glutCreateWindow("MiniTrace");
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+
+	PrintUsage();
+
+	s_rayTracer = new RayTracer(width, height);
+	s_rayTracer->SetProgressive(true);
+	//keep what each pixel sees so a camera drag can reuse the image
+	s_rayTracer->SetReprojection(true);
+	s_scene = new Scene();
+
+	//minitracer [scene file], the built in scene is used without one
+	if (argc > 1)
+	{
+		SceneLoader loader;
+
+		if (!loader.Load(argv[1], *s_scene))
+		{
+			fprintf(stderr, "%s\n", loader.GetError().c_str());
+			delete s_rayTracer;
+			delete s_scene;
+			return 1;
+		}
+	}
+
+	s_scene->SetSceneWidth((float)width / (float)height);
+
+	glutDisplayFunc(Display);
+	glutReshapeFunc(Reshape);
+	glutSpecialFunc(SpecialKey);
+	glutMouseFunc(Mouse);
+	glutMotionFunc(Motion);
+	glutMainLoop();
+
+	delete s_rayTracer;
+	delete s_scene;
+
+	return 0;
+}